@@ -432,10 +432,9 @@ DataAccessor::allDataForStep(size_t stepNo,
     else if (acd == globrad) {
       auto v2 = dataForTimestepM(sunhours, stepNo);
       if (v2.isValue())
-        m[acd] = Tools::sunshine2globalRadiation(dateForStep(stepNo).julianDay(),
-                                                 v2.value(),
-                                                 latitude,
-                                                 true);
+        m[acd] = Tools::sunshine2globalRadiationTable(latitude)->globalRadiation(dateForStep(stepNo).julianDay(),
+                                                                                v2.value(),
+                                                                                true);
     }
   }
 
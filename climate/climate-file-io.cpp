@@ -279,6 +279,9 @@ Climate::readClimateDataFromCSVInputStream(std::istream& is,
   //we store all data in a map to also manage csv files with wrong order
   map<Date, map<ACD, double>> data;
 
+  //missing globrad is derived from the sunshine hours at the given latitude
+  Tools::SunshineToGlobalRadiationTable sunshineTable(options.latitude);
+
   string s;
   int lineNo = 1;
   while (getline(is, s)) {
@@ -373,7 +376,7 @@ Climate::readClimateDataFromCSVInputStream(std::istream& is,
     }
 
     if (!usedVs[globrad] && usedVs[sunhours]) {
-      vs[globrad] = Tools::sunshine2globalRadiation(date.julianDay(), vs[sunhours], options.latitude, true);
+      vs[globrad] = sunshineTable.globalRadiation(date.julianDay(), vs[sunhours], true);
       usedVs[globrad] = true;
     } else if (!usedVs[globrad]) {
       stringstream oss;
@@ -975,44 +975,22 @@ namespace
 		if(month < 0 || month > 12)
 			return 0.0;
 
-    static mutex lockable;
-		static map<SL, map<int, double> > m;
-		static bool initialized = false;
-		if(!initialized)
+		//constant dense table [sl][month + 1], so no (racy) lazy initialization is needed
+		//month 0 and unknown station locations yield 0.0
+		static const double table[5][14] =
 		{
-      lock_guard<mutex> lock(lockable);
-
-			if(!initialized)
-			{
-				SL f = ClimateStation::f;
-				m[f][1]=31.6; m[f][2]=33.5; m[f][3]=26.9; m[f][4]=18.3;
-				m[f][5]=12.5; m[f][6]=10.4; m[f][7]=10.8; m[f][8]=10.5;
-				m[f][9]=12.6; m[f][10]=15.5; m[f][11]=21.8; m[f][12]=26.5;
-				m[f][-1]=18.2;
-
-				SL lg = ClimateStation::lg;
-				m[lg][1]=23.3; m[lg][2]=24.5; m[lg][3]=20.3; m[lg][4]=15.1;
-				m[lg][5]=11.1; m[lg][6]=9.8; m[lg][7]=10.0; m[lg][8]=9.5;
-				m[lg][9]=11.5; m[lg][10]=12.7; m[lg][11]=16.8; m[lg][12]=19.8;
-				m[lg][-1]=14.6;
-
-				SL mg = ClimateStation::mg;
-				m[mg][1]=17.3; m[mg][2]=17.9; m[mg][3]=15.5; m[mg][4]=12.7;
-				m[mg][5]=10.1; m[mg][6]=8.8; m[mg][7]=9.1; m[mg][8]=8.5;
-				m[mg][9]=10.2; m[mg][10]=11.0; m[mg][11]=13.3; m[mg][12]=15.0;
-				m[mg][-1]=12.0;
-
-				SL sg = ClimateStation::sg;
-				m[sg][1]=11.5; m[sg][2]=11.8; m[sg][3]=10.7; m[sg][4]=10.0;
-				m[sg][5]=8.6; m[sg][6]=7.7; m[sg][7]=8.0; m[sg][8]=7.5;
-				m[sg][9]=8.7; m[sg][10]=8.8; m[sg][11]=9.5; m[sg][12]=10.3;
-				m[sg][-1]=9.3;
-
-				initialized = true;
-			}
-		}
-
-		return m[sl][month];
+			{0},
+			//ClimateStation::f
+			{18.2, 0, 31.6, 33.5, 26.9, 18.3, 12.5, 10.4, 10.8, 10.5, 12.6, 15.5, 21.8, 26.5},
+			//ClimateStation::lg
+			{14.6, 0, 23.3, 24.5, 20.3, 15.1, 11.1, 9.8, 10.0, 9.5, 11.5, 12.7, 16.8, 19.8},
+			//ClimateStation::mg
+			{12.0, 0, 17.3, 17.9, 15.5, 12.7, 10.1, 8.8, 9.1, 8.5, 10.2, 11.0, 13.3, 15.0},
+			//ClimateStation::sg
+			{9.3, 0, 11.5, 11.8, 10.7, 10.0, 8.6, 7.7, 8.0, 7.5, 8.7, 8.8, 9.5, 10.3}
+		};
+
+		return ClimateStation::f <= sl && sl <= ClimateStation::sg ? table[sl][month + 1] : 0.0;
 	}
 
 	//kind of precipitation
@@ -1050,33 +1028,22 @@ namespace
 	//! b koefficient
   double bKoeff(SL sl, PArtPlus pap)
   {
-    static mutex lockable;
-		static map<SL, map<PArtPlus, double> > m;
-		static bool initialized = false;
-		if(!initialized)
+		//constant dense table [sl][pap]
+		static const double table[5][4] =
 		{
-      lock_guard<mutex> lock(lockable);
-
-			if(!initialized)
-			{
-				SL f = ClimateStation::f;
-				m[f][rs]=0.345; m[f][rw]=0.34; m[f][mn]=0.535; m[f][s]=0.72;
-
-				SL lg = ClimateStation::lg;
-				m[lg][rs]=0.31; m[lg][rw]=0.28; m[lg][mn]=0.39; m[lg][s]=0.51;
-
-				SL mg = ClimateStation::mg;
-				m[mg][rs]=0.28; m[mg][rw]=0.24; m[mg][mn]=0.305; m[mg][s]=0.33;
-
-				SL sg = ClimateStation::sg;
-				m[sg][rs]=0.245; m[sg][rw]=0.19; m[sg][mn]=0.185; m[sg][s]=0.21;
-
-				initialized = true;
-			}
-		}
-
-		return m[sl][pap];
-
+			{0},
+			//ClimateStation::f: rs, rw, mn, s
+			{0.345, 0.34, 0.535, 0.72},
+			//ClimateStation::lg
+			{0.31, 0.28, 0.39, 0.51},
+			//ClimateStation::mg
+			{0.28, 0.24, 0.305, 0.33},
+			//ClimateStation::sg
+			{0.245, 0.19, 0.185, 0.21}
+		};
+
+		return ClimateStation::f <= sl && sl <= ClimateStation::sg && rs <= pap && pap <= s
+				? table[sl][pap] : 0.0;
 	}
 
 	//! epsilon koefficient
@@ -1143,50 +1110,41 @@ namespace
 
   struct CalcWettRegGlobrad : public Fun
   {
-		int _posSun, _posYd; double _lat;
+		int _posSun, _posYd; Tools::SunshineToGlobalRadiationTable _table;
 		CalcWettRegGlobrad(int posSun, int posYd, double lat)
-		: _posSun(posSun), _posYd(posYd), _lat(lat) {}
+		: _posSun(posSun), _posYd(posYd), _table(lat) {}
 		virtual ~CalcWettRegGlobrad(){}
 
 		double operator()(MYSQL_ROW row) const
 		{
-			return Tools::sunshine2globalRadiation(atoi(row[_posYd]),
-																						 atof(row[_posSun]),
-																						 _lat);
+			return _table.globalRadiation(atoi(row[_posYd]), atof(row[_posSun]));
 		}
 
 		double operator()(const Db::DBRow& row) const //[MJ/m²/d]
     {
-			return Tools::sunshine2globalRadiation(satoi(row.at(_posYd)),
-																						 satof(row.at(_posSun)),
-			                                       _lat);
+			return _table.globalRadiation(satoi(row.at(_posYd)), satof(row.at(_posSun)));
 		}
 	};
 
 	struct CalcRemoGlobrad : public Fun
 	{
 		int _posCloudAmount, _posDoy;
-		double _lat, _hnn;
+		Tools::CloudAmountToGlobalRadiationTable _table;
 		CalcRemoGlobrad(int posCloudAmount, int posDoy, double lat, double heightNN)
 			: _posCloudAmount(posCloudAmount),
 				_posDoy(posDoy),
-				_lat(lat),
-				_hnn(heightNN)
+				_table(lat, heightNN)
 		{}
 		virtual ~CalcRemoGlobrad(){}
 
 		double operator()(MYSQL_ROW row) const
 		{
-			return Tools::cloudAmount2globalRadiation(atoi(row[_posDoy]),
-																								atof(row[_posCloudAmount]),
-																								_lat, _hnn);
+			return _table.globalRadiation(atoi(row[_posDoy]), atof(row[_posCloudAmount]));
 		}
 
 		double operator()(const Db::DBRow& row) const //[MJ/m²/d]
 		{
-			return Tools::cloudAmount2globalRadiation(satoi(row.at(_posDoy)),
-																								satof(row.at(_posCloudAmount)),
-																								_lat, _hnn);
+			return _table.globalRadiation(satoi(row.at(_posDoy)), satof(row.at(_posCloudAmount)));
 		}
 	};
 
@@ -0,0 +1,191 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include "hourly-disaggregation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#ifndef M_PI
+constexpr double M_PI = 3.14159265358979323846;
+#endif
+
+#include "tools/algorithms.h"
+
+using namespace std;
+using namespace Tools;
+using namespace Climate;
+
+HourlyDisaggregation::HourlyDisaggregation(double latitude)
+  : _latitude(latitude) {
+  double lat_rad = latitude * M_PI / 180.0;
+
+  _days.reserve(367);
+  _solarElevations.reserve(367 * 24);
+  for (int doy = 0; doy <= 366; doy++) {
+    double dDecl = solarDeclination(doy);
+    Day d;
+    d.dA = sin(dDecl) * sin(lat_rad);
+    d.dB = cos(dDecl) * cos(lat_rad);
+    double dAoB = d.dA / d.dB;
+    d.radiationDenominator = d.dA * acos(-dAoB) + d.dB * sqrt(1 - dAoB * dAoB);
+
+    //astronomic day length, in polar day/night the sun rises at 0/12
+    double dayLength = 12.0 * (M_PI + 2.0 * asin(bound(-1.0, dAoB, 1.0))) / M_PI;
+    d.sunriseHour = bound(0, int(std::round(12.0 - dayLength / 2.0)), 12);
+    _days.push_back(d);
+
+    for (int h = 0; h < 24; h++) _solarElevations.push_back(Tools::solarElevation(h, latitude, doy));
+  }
+
+  //the same terms as in Tools::hourlyT, the sign of the cos term is included
+  _temperatureShapes.resize(13 * 24);
+  for (int sunrise_h = 0; sunrise_h <= 12; sunrise_h++) {
+    for (int h = 0; h < 24; h++) {
+      double H_1 = h < sunrise_h ? h + 10.0 : h - 14.0;
+      _temperatureShapes[sunrise_h * 24 + h] =
+        h < sunrise_h || h > 14.0
+        ? cos(M_PI * H_1 / (10.0 + sunrise_h))
+        : -cos(M_PI * (h - sunrise_h) / (14.0 - sunrise_h));
+    }
+  }
+
+  for (int h = 0; h < 24; h++) _hourCos[h] = cos(M_PI * h / 12.0);
+}
+
+shared_ptr<const HourlyDisaggregation> HourlyDisaggregation::forLatitude(double latitude) {
+  static mutex lockable;
+  static map<double, shared_ptr<const HourlyDisaggregation>> cache;
+
+  lock_guard<mutex> lock(lockable);
+  auto& hd = cache[latitude];
+  if (!hd) hd = make_shared<HourlyDisaggregation>(latitude);
+  return hd;
+}
+
+void HourlyDisaggregation::disaggregate(int doy, double tmin, double tavg, double tmax, double globrad,
+                                        HourlyDay& day) const {
+  size_t di = dayIndex(doy);
+  const Day& d = _days[di];
+
+  const double* temperatureShape = &_temperatureShapes[d.sunriseHour * 24];
+  double tavg_ = (tmin + tmax) / 2;
+  double amp = (tmax - tmin) / 2;
+  for (int h = 0; h < 24; h++) day.tavg[h] = tavg_ + amp * temperatureShape[h];
+
+  double dPhi = (M_PI * globrad / 86400.0) / d.radiationDenominator;
+  double dCoefA = -d.dB * dPhi;
+  double dCoefB = d.dA * dPhi;
+  for (int h = 0; h < 24; h++) day.globrad[h] = std::max((dCoefA * _hourCos[h] + dCoefB) * 3600, 0.0);
+
+  //the actual vapour pressure depends only on the daily values
+  double dewPointTemperature = -0.0360 * tavg + 0.9679 * tmin + 0.0072 * (tmax - tmin) + 1.0019;
+  double actualVapourPressure = 0.6108 * exp(17.27 * dewPointTemperature / (dewPointTemperature + 237.3));
+  for (int h = 0; h < 24; h++) {
+    double t = day.tavg[h];
+    day.vaporPressureDeficit[h] = 0.6108 * exp(17.27 * t / (t + 237.3)) - actualVapourPressure;
+  }
+
+  copy_n(_solarElevations.begin() + di * 24, 24, day.solarElevation.begin());
+}
+
+namespace {
+Errors checkInputs(const DataAccessor& da) {
+  Errors es;
+  for (auto acd : {tmin, tmax, globrad}) {
+    if (!da.hasAvailableClimateData(acd)) {
+      es.appendError(string("Hourly disaggregation: climate element ") + availableClimateData2Name(acd) + " is missing.");
+    }
+  }
+  return es;
+}
+}
+
+Errors HourlyDisaggregation::disaggregate(const DataAccessor& da, size_t fromStep, size_t noOfSteps,
+                                          HourlyColumns& columns) const {
+  auto es = checkInputs(da);
+  if (es.failure()) return es;
+  if (fromStep + noOfSteps > da.noOfStepsPossible()) {
+    es.appendError("Hourly disaggregation: requested steps exceed the available climate data.");
+    return es;
+  }
+
+  size_t noOfHours = noOfSteps * 24;
+  columns.tavg.resize(noOfHours);
+  columns.globrad.resize(noOfHours);
+  columns.vaporPressureDeficit.resize(noOfHours);
+  columns.solarElevation.resize(noOfHours);
+
+  bool hasTavg = da.hasAvailableClimateData(tavg);
+
+  //one pass per column, the inner loops over the hours of a day only touch tables and the day's values
+  for (size_t i = 0; i < noOfSteps; i++) {
+    size_t step = fromStep + i;
+    const Day& d = _days[dayIndex(da.julianDayForStep(step))];
+    double tmin_ = da.dataForTimestep(tmin, step);
+    double tmax_ = da.dataForTimestep(tmax, step);
+    const double* temperatureShape = &_temperatureShapes[d.sunriseHour * 24];
+    double tavg_ = (tmin_ + tmax_) / 2;
+    double amp = (tmax_ - tmin_) / 2;
+    double* out = &columns.tavg[i * 24];
+    for (int h = 0; h < 24; h++) out[h] = tavg_ + amp * temperatureShape[h];
+  }
+
+  for (size_t i = 0; i < noOfSteps; i++) {
+    size_t step = fromStep + i;
+    size_t di = dayIndex(da.julianDayForStep(step));
+    const Day& d = _days[di];
+    double dPhi = (M_PI * da.dataForTimestep(globrad, step) / 86400.0) / d.radiationDenominator;
+    double dCoefA = -d.dB * dPhi;
+    double dCoefB = d.dA * dPhi;
+    double* out = &columns.globrad[i * 24];
+    for (int h = 0; h < 24; h++) out[h] = std::max((dCoefA * _hourCos[h] + dCoefB) * 3600, 0.0);
+    copy_n(_solarElevations.begin() + di * 24, 24, columns.solarElevation.begin() + i * 24);
+  }
+
+  for (size_t i = 0; i < noOfSteps; i++) {
+    size_t step = fromStep + i;
+    double tmin_ = da.dataForTimestep(tmin, step);
+    double tmax_ = da.dataForTimestep(tmax, step);
+    double tavg_ = hasTavg ? da.dataForTimestep(tavg, step) : (tmin_ + tmax_) / 2.0;
+    double dewPointTemperature = -0.0360 * tavg_ + 0.9679 * tmin_ + 0.0072 * (tmax_ - tmin_) + 1.0019;
+    double actualVapourPressure = 0.6108 * exp(17.27 * dewPointTemperature / (dewPointTemperature + 237.3));
+    const double* ts = &columns.tavg[i * 24];
+    double* out = &columns.vaporPressureDeficit[i * 24];
+    for (int h = 0; h < 24; h++) out[h] = 0.6108 * exp(17.27 * ts[h] / (ts[h] + 237.3)) - actualVapourPressure;
+  }
+
+  return es;
+}
+
+Errors HourlyDisaggregation::forEachDay(const DataAccessor& da,
+                                        const function<void(size_t, const HourlyDay&)>& f) const {
+  auto es = checkInputs(da);
+  if (es.failure()) return es;
+
+  bool hasTavg = da.hasAvailableClimateData(tavg);
+  HourlyDay day;
+  for (size_t step = 0, size = da.noOfStepsPossible(); step < size; step++) {
+    double tmin_ = da.dataForTimestep(tmin, step);
+    double tmax_ = da.dataForTimestep(tmax, step);
+    double tavg_ = hasTavg ? da.dataForTimestep(tavg, step) : (tmin_ + tmax_) / 2.0;
+    disaggregate(int(da.julianDayForStep(step)), tmin_, tavg_, tmax_, da.dataForTimestep(globrad, step), day);
+    f(step, day);
+  }
+
+  return es;
+}
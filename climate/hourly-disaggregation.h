@@ -0,0 +1,101 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "climate-common.h"
+#include "tools/helper.h"
+
+namespace Climate {
+
+//! the hourly values of one day, index = hour [0, 23]
+struct HourlyDay {
+  std::array<double, 24> tavg; //!< [°C]
+  std::array<double, 24> globrad; //!< [J/m²/h] if globrad is given in [MJ/m²/d]
+  std::array<double, 24> vaporPressureDeficit; //!< [kPa]
+  std::array<double, 24> solarElevation; //!< [rad], can be negative
+};
+
+//! hourly columns of a range of days, index = day * 24 + hour
+struct HourlyColumns {
+  std::vector<double> tavg;
+  std::vector<double> globrad;
+  std::vector<double> vaporPressureDeficit;
+  std::vector<double> solarElevation;
+
+  size_t noOfHours() const { return tavg.size(); }
+};
+
+/*!
+ * Disaggregates daily tmin, tavg, tmax and globrad into hourly values.
+ * The results are identical to Tools::hourlyT, hourlyRad, hourlyVaporPressureDeficit and
+ * solarElevation, but everything depending only on the day of year and the latitude
+ * (declination, solar elevation, radiation shape, temperature curves) is tabulated once.
+ * The tables are immutable after construction, so one instance can be shared by all stations
+ * and threads at the same latitude (see forLatitude).
+ * The sunrise hour for Tools::hourlyT is derived from the astronomic day length.
+ */
+class HourlyDisaggregation {
+public:
+  explicit HourlyDisaggregation(double latitude);
+
+  //! the shared tables for the latitude, created on first use
+  static std::shared_ptr<const HourlyDisaggregation> forLatitude(double latitude);
+
+  double latitude() const { return _latitude; }
+
+  int sunriseHour(int dayOfYear) const { return _days[dayIndex(dayOfYear)].sunriseHour; }
+
+  double solarElevation(int dayOfYear, int hour) const { return _solarElevations[dayIndex(dayOfYear) * 24 + hour]; }
+
+  //! one day, tavg is only used for the vapor pressure deficit
+  void disaggregate(int dayOfYear, double tmin, double tavg, double tmax, double globrad, HourlyDay& day) const;
+
+  //! Fill the hourly columns for noOfSteps days of da starting at fromStep, the columns are resized.
+  //! Needs tmin, tmax and globrad, a missing tavg is replaced by (tmin + tmax) / 2.
+  Tools::Errors disaggregate(const DataAccessor& da, size_t fromStep, size_t noOfSteps, HourlyColumns& columns) const;
+
+  Tools::Errors disaggregate(const DataAccessor& da, HourlyColumns& columns) const {
+    return disaggregate(da, 0, da.noOfStepsPossible(), columns);
+  }
+
+  //! Stream the days of da to f instead of materializing all hours, f gets the step number and
+  //! a day buffer which is reused for the next day.
+  Tools::Errors forEachDay(const DataAccessor& da, const std::function<void(size_t, const HourlyDay&)>& f) const;
+
+private:
+  struct Day {
+    int sunriseHour;
+    double dA, dB; //!< sin(decl) * sin(lat), cos(decl) * cos(lat)
+    double radiationDenominator; //!< daily integral of the radiation shape
+  };
+
+  //! day of year 0 - 366, other values are clamped
+  static size_t dayIndex(int dayOfYear) { return size_t(dayOfYear < 0 ? 0 : dayOfYear > 366 ? 366 : dayOfYear); }
+
+  double _latitude;
+  std::vector<Day> _days; //!< index = day of year
+  std::vector<double> _solarElevations; //!< index = day of year * 24 + hour
+  std::vector<double> _temperatureShapes; //!< signed cos term of hourlyT, index = sunrise hour * 24 + hour
+  std::array<double, 24> _hourCos; //!< cos(pi * h / 12) of hourlyRad
+};
+
+} // namespace Climate
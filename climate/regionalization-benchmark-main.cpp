@@ -0,0 +1,295 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+// reproducible workload for Climate::Regionalization
+// - a synthetic DGM of configurable size is written as ESRI ascii grid and loaded
+// - a synthetic climate simulation with in-memory stations and generated
+//   DataAccessor series replaces the MySQL/sqlite climate databases
+// - cache-miss regionalization, cache-hit lookup and realization averaging
+//   are timed separately
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "regionalization.h"
+#include "tools/coord-trans.h"
+#include "tools/date.h"
+
+using namespace std;
+using namespace Climate;
+using namespace Climate::Regionalization;
+using namespace Grids;
+using namespace Tools;
+
+namespace
+{
+  struct Params
+  {
+    int rows{200};
+    int cols{200};
+    double cellSize{1000}; //m
+    int noOfStations{50};
+    int noOfRealizations{3};
+    int fromYear{1991};
+    int toYear{2000};
+    int repetitions{3};
+    string coordinateSystem{"gk5"};
+    string pathToDgm{"synthetic-dgm.asc"};
+  };
+
+  //! small deterministic generator, so every run sees the same workload
+  struct Lcg
+  {
+    explicit Lcg(unsigned int seed) : state(seed * 2654435761u + 1) {}
+    double next()
+    {
+      state = state * 1664525u + 1013904223u;
+      return double(state >> 8) / double(1 << 24);
+    }
+    unsigned int state;
+  };
+
+  //! rolling hills between 0 and ~300m
+  double syntheticHeight(double x, double y)
+  {
+    return 150.0 + 80.0 * sin(x / 17000.0) * cos(y / 23000.0) + 70.0 * sin((x + y) / 41000.0);
+  }
+
+  //! write the synthetic DGM as ESRI ascii grid, a few cells are no data
+  void writeSyntheticDgm(const Params& ps, double xcorner, double ycorner)
+  {
+    ofstream out(ps.pathToDgm.c_str());
+    out << "ncols " << ps.cols << endl
+        << "nrows " << ps.rows << endl
+        << "xllcorner " << fixed << setprecision(1) << xcorner << endl
+        << "yllcorner " << ycorner << endl
+        << "cellsize " << ps.cellSize << endl
+        << "NODATA_value -9999" << endl;
+    for(int i = 0; i < ps.rows; i++)
+    {
+      double y = ycorner + (ps.rows - i - 0.5) * ps.cellSize;
+      for(int j = 0; j < ps.cols; j++)
+      {
+        double x = xcorner + (j + 0.5) * ps.cellSize;
+        bool noData = (i * 7 + j * 13) % 97 == 0;
+        out << (noData ? -9999.0 : syntheticHeight(x, y)) << (j + 1 < ps.cols ? " " : "");
+      }
+      out << endl;
+    }
+  }
+
+  //! realization generating seasonal series instead of querying a database
+  class SyntheticRealization : public ClimateRealization
+  {
+  public:
+    SyntheticRealization(const string& id, ClimateSimulation* sim,
+                         ClimateScenario* scen, unsigned int seed)
+      : ClimateRealization(id, sim, scen, nullptr), _seed(seed) {}
+
+  protected:
+    virtual map<ACD, vector<double>*>
+    executeQuery(const ACDV& acds, const LatLngCoord& gc,
+                 const Date& startDate, const Date& endDate) const
+    {
+      int n = startDate.numberOfDaysTo(endDate) + 1;
+      Lcg rnd(_seed + (unsigned int)(gc.lat * 1000) * 31 + (unsigned int)(gc.lng * 1000));
+      double offset = (gc.lat - 52.0) * -0.7;
+
+      map<ACD, vector<double>*> res;
+      for(ACD acd : acds)
+        res[acd] = new vector<double>(n, 0.0);
+
+      for(int i = 0; i < n; i++)
+      {
+        double season = sin(2.0 * M_PI * ((startDate + i).julianDay() - 105) / 365.0);
+        double tavg_ = 9.0 + offset + 9.5 * season + 3.0 * (rnd.next() - 0.5);
+        for(ACD acd : acds)
+        {
+          double v = 0;
+          switch(acd)
+          {
+          case tavg: v = tavg_; break;
+          case tmin: v = tavg_ - 4.0; break;
+          case tmax: v = tavg_ + 4.0; break;
+          case precip: v = rnd.next() < 0.45 ? 8.0 * rnd.next() : 0.0; break;
+          case globrad: v = 11.0 + 9.0 * season + 2.0 * rnd.next(); break;
+          case relhumid: v = 78.0 - 10.0 * season; break;
+          case wind: v = 2.0 + 3.0 * rnd.next(); break;
+          default: v = rnd.next();
+          }
+          (*res[acd])[i] = v;
+        }
+      }
+
+      return res;
+    }
+
+  private:
+    unsigned int _seed;
+  };
+
+  double msSince(chrono::steady_clock::time_point start)
+  {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  }
+
+  void printUsage(const char* name)
+  {
+    cout << "usage: " << name << " [options]" << endl
+         << " -rows n | -cols n ... size of the synthetic dgm (200 x 200)" << endl
+         << " -cell-size m ... cell size in meters (1000)" << endl
+         << " -stations n ... number of synthetic climate stations (50)" << endl
+         << " -realizations n ... number of synthetic realizations (3)" << endl
+         << " -from year | -to year ... regionalized years (1991 - 2000)" << endl
+         << " -repetitions n ... how often every measurement is repeated (3)" << endl
+         << " -cs short-name ... coordinate system of the dgm (gk5)" << endl
+         << " -dgm path ... where to write the synthetic dgm (synthetic-dgm.asc)" << endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Params ps;
+  for(int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if(arg == "-rows" && hasValue) ps.rows = atoi(argv[++i]);
+    else if(arg == "-cols" && hasValue) ps.cols = atoi(argv[++i]);
+    else if(arg == "-cell-size" && hasValue) ps.cellSize = atof(argv[++i]);
+    else if(arg == "-stations" && hasValue) ps.noOfStations = atoi(argv[++i]);
+    else if(arg == "-realizations" && hasValue) ps.noOfRealizations = atoi(argv[++i]);
+    else if(arg == "-from" && hasValue) ps.fromYear = atoi(argv[++i]);
+    else if(arg == "-to" && hasValue) ps.toYear = atoi(argv[++i]);
+    else if(arg == "-repetitions" && hasValue) ps.repetitions = atoi(argv[++i]);
+    else if(arg == "-cs" && hasValue) ps.coordinateSystem = argv[++i];
+    else if(arg == "-dgm" && hasValue) ps.pathToDgm = argv[++i];
+    else
+    {
+      printUsage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  CoordinateSystem cs = shortStringToCoordinateSystem(ps.coordinateSystem);
+  if(!cs.isValid())
+  {
+    cerr << "unknown coordinate system: " << ps.coordinateSystem << endl;
+    return 1;
+  }
+
+  //somewhere in Brandenburg, if GK5 is used
+  double xcorner = 5400000, ycorner = 5800000;
+  writeSyntheticDgm(ps, xcorner, ycorner);
+  GridP dgm("", GridP::ASCII, ps.pathToDgm, cs);
+  if(!dgm.isValid())
+  {
+    cerr << "couldn't load synthetic dgm from " << ps.pathToDgm << endl;
+    return 1;
+  }
+
+  ClimateSimulation sim("synthetic", "synthetic", nullptr);
+  auto scen = make_shared<ClimateScenario>("synthetic", &sim);
+  sim.addScenario(scen);
+
+  //stations scattered over the dgm and the default border around it
+  Stations stations;
+  Lcg rnd(4711);
+  double border = defaultBorderSize * 1000.0;
+  double width = ps.cols * ps.cellSize + 2 * border;
+  double height = ps.rows * ps.cellSize + 2 * border;
+  for(int i = 0; i < ps.noOfStations; i++)
+  {
+    double x = xcorner - border + rnd.next() * width;
+    double y = ycorner - border + rnd.next() * height;
+    LatLngCoord llc = RC2latLng(RectCoord(cs, x, y));
+    ostringstream name;
+    name << "station-" << i;
+    stations.push_back(make_shared<ClimateStation>(i + 1, llc, syntheticHeight(x, y), name.str(), &sim));
+  }
+  sim.setClimateStations(stations);
+
+  Realizations rs;
+  for(int i = 0; i < ps.noOfRealizations; i++)
+  {
+    ostringstream id;
+    id << (i + 1);
+    rs.push_back(make_shared<SyntheticRealization>(id.str(), &sim, scen.get(), i + 1));
+  }
+  scen->setRealizations(rs);
+
+  Env env(tavg);
+  env.dgm = &dgm;
+  env.fromYear = ps.fromYear;
+  env.toYear = ps.toYear;
+  env.cacheInfo.resultIds.push_back(0);
+  for(auto r : rs)
+    env.realizations.push_back(r.get());
+
+  cout << "dgm: " << ps.rows << " x " << ps.cols << " cells, "
+       << ps.noOfStations << " stations, " << ps.noOfRealizations << " realizations, "
+       << ps.fromYear << "-" << ps.toYear << endl;
+
+  //the climate data are generated on first access, keep that out of the timings
+  auto start = chrono::steady_clock::now();
+  for(auto r : env.realizations)
+    preloadClimateData(r, GridMetaData(&dgm), env.acds, env.fromYear, env.toYear);
+  cout << "preload climate data: " << msSince(start) << " ms" << endl;
+
+  double missMs = 0, hitMs = 0, avgMs = 0, streamedAvgMs = 0;
+  for(int k = 0; k < ps.repetitions; k++)
+  {
+    //a new function id forces regionalize to miss the in-memory cache
+    ostringstream fid;
+    fid << "benchmark-" << k;
+    env.functionId = uniqueFunctionId(fid.str());
+
+    start = chrono::steady_clock::now();
+    regionalize(env);
+    missMs += msSince(start);
+
+    start = chrono::steady_clock::now();
+    regionalize(env);
+    hitMs += msSince(start);
+
+    start = chrono::steady_clock::now();
+    regionalizeAndAvgRealizations(env);
+    avgMs += msSince(start);
+
+    start = chrono::steady_clock::now();
+    regionalizeAndAvgRealizationsStreamed(env, [](ResultId, int, GridPPtr){});
+    streamedAvgMs += msSince(start);
+  }
+
+  int n = max(1, ps.repetitions);
+  cout << "cache-miss regionalization: " << missMs / n << " ms" << endl
+       << "cache-hit lookup: " << hitMs / n << " ms" << endl
+       << "cache-hit lookup + realization averaging: " << avgMs / n << " ms"
+       << " (averaging alone ~" << (avgMs - hitMs) / n << " ms)" << endl
+       << "streamed regionalization + realization averaging: " << streamedAvgMs / n << " ms" << endl;
+
+  remove(ps.pathToDgm.c_str());
+
+  return 0;
+}
@@ -0,0 +1,4 @@
+mkdir -p _cmake_debug
+cd  _cmake_debug
+cmake .. -DCMAKE_TOOLCHAIN_FILE=../../../../../vcpkg/scripts/buildsystems/vcpkg.cmake -DCMAKE_BUILD_TYPE=Debug
+cd ..
\ No newline at end of file
@@ -183,6 +183,227 @@ namespace
     return res;
   }
 
+  //! serializes the reading and writing of the hdf cache files
+  mutex& hdfCacheLockable()
+  {
+    static mutex lockable;
+    return lockable;
+  }
+
+  string pathToHdfFor(const Env& env, GridMetaData gmd,
+                      ClimateSimulation* sim, ClimateScenario* scen,
+                      ClimateRealization* r, const set<ACD>& acdsSet,
+                      ResultId rid)
+  {
+    string pathToHdfCache = env.cacheInfo.pathToHdfCache;
+    ostringstream pathToHdf;
+    pathToHdf << pathToHdfCache;
+    if(*(pathToHdfCache.rbegin()) != '/')
+      pathToHdf << "/";
+    pathToHdf << gmd.toCanonicalString("_") << "/"
+        << sim->name() << "/" << scen->name() << "/"
+        << r->id() << "/" << acdsToString(acdsSet) << "/"
+        << env.cacheInfo.functionIdString << "/" << rid << ".hdf";
+    return pathToHdf.str();
+  }
+
+  //! apply env.f to every requested year of realization r at every station
+  map<int, vector<X> > stationValuesPerYear(const Env& env,
+                                            ClimateRealization* r,
+                                            const vector<const ClimateStation*>& climateStations,
+                                            const set<int>& years,
+                                            CoordinateSystem usedCS)
+  {
+    map<int, vector<X> > year2xs;
+
+    if(env.bf)
+    {
+      BatchInput bi;
+      bi.noOfStations = climateStations.size();
+      bi.fromYear = env.fromYear;
+      bi.noOfYears = env.toYear - env.fromYear + 1 - (env.yearSlice - 1);
+      bi.windowSize = 365 * env.yearSlice;
+      bi.noOfDays = (bi.noOfYears + env.yearSlice - 1) * 365;
+      if(bi.noOfStations == 0 || bi.noOfYears <= 0)
+        return year2xs;
+
+      for(ACD acd : env.acds)
+        bi.columns[acd].assign(size_t(bi.noOfStations) * bi.noOfDays, 0.0);
+
+      for(int s = 0; s < bi.noOfStations; s++)
+      {
+        const ClimateStation* cs = climateStations.at(s);
+        DataAccessor da = r->dataAccessorFor(env.acds, cs->geoCoord(),
+                                             Date(1, 1, env.fromYear),
+                                             Date(31, 12, env.toYear));
+        for(ACD acd : env.acds)
+        {
+          vector<double> vs = da.dataAsVector(acd);
+          copy(vs.begin(), vs.begin() + min(int(vs.size()), bi.noOfDays),
+               bi.columns[acd].begin() + size_t(s) * bi.noOfDays);
+        }
+      }
+
+      BatchResult br(bi.noOfStations, bi.noOfYears, env.noOfBatchResults);
+      env.bf(bi, br);
+
+      for(int s = 0; s < bi.noOfStations; s++)
+      {
+        const ClimateStation* cs = climateStations.at(s);
+        RectCoord rc = cs->rcCoord(usedCS);
+        for(int k = 0; k < bi.noOfYears; k++)
+        {
+          int currentYear = env.fromYear + k;
+          if(years.find(currentYear) != years.end())
+          {
+            double* first = &br.at(s, k, 0);
+            year2xs[currentYear].push_back(X(*cs, rc, vector<double>(first, first + br.noOfResults)));
+          }
+        }
+      }
+
+      return year2xs;
+    }
+
+    for(const ClimateStation* cs : climateStations)
+    {
+      DataAccessor da = r->dataAccessorFor(env.acds, cs->geoCoord(),
+                                           Date(1, 1, env.fromYear),
+                                           Date(31, 12, env.toYear));
+
+      for(int k = 0, to = env.toYear - env.fromYear + 1 - (env.yearSlice - 1);
+      k < to; k++)
+      {
+        //skip years which have already been calculated and are available
+        //in the cache
+        int currentYear = env.fromYear + k;
+        if(years.find(currentYear) != years.end())
+        {
+          DataAccessor yda = da.cloneForRange(k * 365, 365 * env.yearSlice);
+          const FuncResult& vals = env.f(yda);
+
+          vector<double> values;
+          for(FuncResult::value_type p : vals)
+          {
+            values.push_back(p.second);
+          }
+
+          //cache also rc coordinate of station
+          year2xs[currentYear].push_back(X(*cs, cs->rcCoord(usedCS), values));
+        }
+      }
+    }
+
+    return year2xs;
+  }
+
+  //! interpolate the station values of a single year onto env.dgm,
+  //! one grid per result of env.f
+  vector<GridPPtr> interpolateYear(const Env& env, vector<X>& xs)
+  {
+    //if less than three stations, don't do the regression, but
+    //simply average the two stations or take the values of the one stationso/one station/s
+    bool moreThanTwoStations = xs.size() > 2;
+
+    int noOfResults = xs.front().values.size();
+    vector<GridPPtr> gs(noOfResults);
+    for(int i = 0, size = gs.size(); i < size; i++)
+      gs[i] = GridPPtr(env.dgm->clone());
+
+    RegressionResult rr;
+    if(moreThanTwoStations)
+    {
+      rr = regression(xs);
+
+      // inverse distance and regression
+      for(X& x : xs)
+      {
+        x.residua = x.values - ((rr.m * x.station.nn()) + rr.n);
+//				cout << "residua=values-((m*nn)+n)=" << toString(x.values)
+//						 << "-" << "((" << toString(rr.m) << "*" << x.station.nn() << ")+"
+//						 << toString(rr.n) << "=" << toString(x.residua) << endl;
+      }
+    }
+
+    GridPPtr g = gs.front();
+    double cellSize = g->cellSize();
+    double r = g->gridPtr()->xcorner + (cellSize / 2);
+    double h = g->gridPtr()->ycorner + (double(g->rows()) * cellSize)-(cellSize / 2.0);
+    for(int i = 0, rs = g->rows(); i < rs; i++)
+    {
+      for(int j = 0, cs = g->cols(); j < cs; j++)
+      {
+        if(g->isDataField(i, j))
+        {
+          if(moreThanTwoStations)
+          {
+            double sum = 0.0;
+            vector<double> sumz(noOfResults, 0.0);
+
+            for(const X& x : xs)
+            {
+              double dist = x.rc.distanceTo(RectCoord(g->coordinateSystem(),
+                                                      r + (cellSize * j),
+                                                      h - (cellSize * i)));
+              if(dist > 1.0)
+              {
+                sum += 1.0 / (dist * dist);
+                sumz += x.residua / (dist * dist);
+              }
+            }
+            for(int k = 0; k < noOfResults; k++)
+            {
+              double dgm = env.dgm->dataAt(i, j);
+              double m = rr.m[k];
+              double n = rr.n[k];
+              double oldValue = dgm * m + n + sumz[k]/sum;
+              gs[k]->setDataAt(i, j, float(oldValue));
+//							cout << "dataAt(" << i << "," << j << ")="
+//									 << "dgm*m+n+sumz/sum="
+//									 << dgm << "*"
+//									 << m << "+" << n << "+"
+//									 << sumz[k] << "/" << sum << "="
+//									 << oldValue
+//									 << endl;
+            }
+          }
+          else
+          {
+            for(int k = 0; k < noOfResults; k++)
+            {
+              if(xs.size() == 2)
+              {
+                const X& f = xs.at(0);
+                const X& s = xs.at(1);
+                RectCoord cellRC = RectCoord(g->coordinateSystem(),
+                                             r + (cellSize*j),
+                                             h - (cellSize*i));
+                double df = f.rc.distanceTo(cellRC);
+                double ds = s.rc.distanceTo(cellRC);
+                double fv = df/(df+ds)*f.values[k];
+                double sv = ds/(df+ds)*s.values[k];
+                gs[k]->setDataAt(i, j, float(fv + sv));
+//								cout << "dataAt(" << i << "," << j << ")="
+//										 << "(fv + sv="
+//										 << fv << "+" << sv << "="
+//										 << (fv + sv)
+//										 << endl;
+              }
+              else
+              {
+                gs[k]->setDataAt(i, j, float(xs.at(0).values[k]));
+//								cout << "dataAt(" << i << "," << j << ")="
+//										 << "value=" << xs.at(0).values[k] << endl;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    return gs;
+  }
+
 }
 
 int Regionalization::borderSizeIncrementKM(int newGlobalValue)
@@ -219,6 +440,115 @@ FuncResult Regionalization::defaultFunction(AvailableClimateData acd,
 	return m;
 }
 
+double Regionalization::sumKernel(const double* vs, int n)
+{
+  //independent partial sums, so the additions can be vectorized
+  //without reordering a single dependency chain
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    s0 += vs[i];
+    s1 += vs[i + 1];
+    s2 += vs[i + 2];
+    s3 += vs[i + 3];
+  }
+  for(; i < n; i++)
+    s0 += vs[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+double Regionalization::meanKernel(const double* vs, int n)
+{
+  return n > 0 ? sumKernel(vs, n) / n : 0.0;
+}
+
+int Regionalization::countAboveKernel(const double* vs, int n, double threshold)
+{
+  int count = 0;
+  for(int i = 0; i < n; i++)
+    count += vs[i] > threshold ? 1 : 0;
+  return count;
+}
+
+double Regionalization::climaticWaterBalanceKernel(const double* precip,
+                                                   const double* globrad,
+                                                   const double* tavg,
+                                                   int n, double fk)
+{
+  double s0 = 0, s1 = 0;
+  int i = 0;
+  for(; i + 2 <= n; i += 2)
+  {
+    //globrad MJ/m²/d -> J/cm²/d
+    s0 += climaticWaterBalanceTW(precip[i], globrad[i] * 100.0, tavg[i], fk);
+    s1 += climaticWaterBalanceTW(precip[i + 1], globrad[i + 1] * 100.0, tavg[i + 1], fk);
+  }
+  for(; i < n; i++)
+    s0 += climaticWaterBalanceTW(precip[i], globrad[i] * 100.0, tavg[i], fk);
+  return s0 + s1;
+}
+
+namespace
+{
+  //! apply a single column reduction to every station and year,
+  //! the reducer is a template parameter so it can be inlined into the loop
+  template<typename Reduce>
+  BatchFunction batchReduction(ACD acd, Reduce reduce)
+  {
+    return [=](const BatchInput& bi, BatchResult& br)
+    {
+      for(int s = 0; s < bi.noOfStations; s++)
+      {
+        for(int k = 0; k < bi.noOfYears; k++)
+        {
+          const double* vs = bi.window(acd, s, k);
+          br.at(s, k, 0) = vs ? reduce(vs, bi.windowSize) : 0.0;
+        }
+      }
+    };
+  }
+}
+
+BatchFunction Regionalization::batchSumFunction(ACD acd)
+{
+  return batchReduction(acd, [](const double* vs, int n){ return sumKernel(vs, n); });
+}
+
+BatchFunction Regionalization::batchMeanFunction(ACD acd)
+{
+  return batchReduction(acd, [](const double* vs, int n){ return meanKernel(vs, n); });
+}
+
+BatchFunction Regionalization::batchCountAboveFunction(ACD acd, double threshold)
+{
+  return batchReduction(acd, [=](const double* vs, int n){ return double(countAboveKernel(vs, n, threshold)); });
+}
+
+BatchFunction Regionalization::batchClimaticWaterBalanceFunction(double fk)
+{
+  return [=](const BatchInput& bi, BatchResult& br)
+  {
+    for(int s = 0; s < bi.noOfStations; s++)
+    {
+      for(int k = 0; k < bi.noOfYears; k++)
+      {
+        const double* ps = bi.window(precip, s, k);
+        const double* gs = bi.window(globrad, s, k);
+        const double* ts = bi.window(tavg, s, k);
+        br.at(s, k, 0) = ps && gs && ts
+            ? climaticWaterBalanceKernel(ps, gs, ts, bi.windowSize, fk)
+            : 0.0;
+      }
+    }
+  };
+}
+
+BatchFunction Regionalization::batchDefaultFunctionWith(ACD acd)
+{
+  return acd == precip ? batchSumFunction(acd) : batchMeanFunction(acd);
+}
+
 int Regionalization::uniqueFunctionId(const string& fid)
 {
   static mutex lockable;
@@ -292,7 +622,7 @@ Results Regionalization::regionalize(Env env)
 //			<< " from: " << env.fromYear << " to: " << env.toYear << endl;
 
   static mutex memoryCacheLockable;
-  static mutex diskCacheLockable;
+  mutex& diskCacheLockable = hdfCacheLockable();
 	typedef string SimulationId;
 	typedef string ScenarioId;
 	typedef string RealizationName;
@@ -432,9 +762,6 @@ Results Regionalization::regionalize(Env env)
     //if data are not yet in the cache, try to load them from a hdf
     if(env.cacheInfo.cacheData)
     {
-      string pathToHdfCache = env.cacheInfo.pathToHdfCache;
-      string functionIdString = env.cacheInfo.functionIdString;
-
       for(Real2Years::value_type p : realization2years)
       {
         ClimateRealization* r = p.first;
@@ -446,18 +773,11 @@ Results Regionalization::regionalize(Env env)
           bool foundYear = false;
           for(ResultId rid : env.cacheInfo.resultIds)
           {
-            ostringstream pathToHdf;
-            pathToHdf << pathToHdfCache;
-            if(*(pathToHdfCache.rbegin()) != '/')
-              pathToHdf << "/";
-            pathToHdf << gmd.toCanonicalString("_") << "/"
-                << sim->name() << "/" << scen->name() << "/"
-                << r->id() << "/" << acdsToString(acdsSet) << "/"
-                << functionIdString << "/" << rid << ".hdf";
+            string pathToHdf = pathToHdfFor(env, gmd, sim, scen, r, acdsSet, rid);
             ostringstream dsn;
             dsn << year;
-//            cout << "trying to load: year: " << year << " path: " << pathToHdf.str() << endl;
-            GridPPtr g = GridPPtr(new GridP(dsn.str(), GridP::HDF, pathToHdf.str(), usedCS));
+//            cout << "trying to load: year: " << year << " path: " << pathToHdf << endl;
+            GridPPtr g = GridPPtr(new GridP(dsn.str(), GridP::HDF, pathToHdf, usedCS));
             if(g->isValid())
             {
 //              cout << "found grid in hdf" << endl;
@@ -498,155 +818,19 @@ Results Regionalization::regionalize(Env env)
 //		cout << "calculating realization: " << r->name() << endl;
 		set<Year> years = p.second;
 
-		typedef map<Year, vector<X> > XS;
-		XS year2xs;
-
-    for(const ClimateStation* cs : climateStations)
-    {
-			DataAccessor da = r->dataAccessorFor(env.acds, cs->geoCoord(),
-                                           Date(1, 1, env.fromYear),
-                                           Date(31, 12, env.toYear));
-
-      for(int k = 0, to = env.toYear - env.fromYear + 1 - (env.yearSlice - 1);
-      k < to; k++)
-      {
-				//skip years which have already been calculated and are available
-				//in the cache
-				int currentYear = env.fromYear + k;
-        if(years.find(currentYear) != years.end())
-        {
-					DataAccessor yda = da.cloneForRange(k * 365, 365 * env.yearSlice);
-					const FuncResult& vals = env.f(yda);
-
-					vector<double> values;
-          for(FuncResult::value_type p : vals)
-          {
-						values.push_back(p.second);
-					}
-
-					//cache also rc coordinate of station
-          year2xs[currentYear].push_back(X(*cs, cs->rcCoord(usedCS), values));
-//					cout << "current year: " << currentYear << " station: " << cs->name();
-//					for(FuncResult::value_type p, vals)
-//					{
-//						cout << " [id: " << p.first << "|value: " << p.second << "]";
-//					}
-//					cout << endl;
-				}
-			}
-		}
+		map<Year, vector<X> > year2xs =
+				stationValuesPerYear(env, r, climateStations, years, usedCS);
 
 		//get results for current realization
 		//is basically the same as the avg realization results
 		AvgRealizationsResults newRes;
-    for(XS::value_type p : year2xs)
+    for(auto& p : year2xs)
     {
       int year = p.first;
 //			cout << year << "|" << r->name() << " " << endl;
 
-			vector<X>& xs = year2xs[year];
-
-      //if less than three stations, don't do the regression, but
-      //simply average the two stations or take the values of the one stationso/one station/s
-      bool moreThanTwoStations = xs.size() > 2;
-
-      int noOfResults = xs.front().values.size();
-      vector<GridPPtr> gs(noOfResults);
-      for(int i = 0, size = gs.size(); i < size; i++)
-        gs[i] = GridPPtr(env.dgm->clone());
-
-      RegressionResult rr;
-      if(moreThanTwoStations)
-      {
-        rr = regression(xs);
-
-        // inverse distance and regression
-        for(X& x : xs)
-        {
-          x.residua = x.values - ((rr.m * x.station.nn()) + rr.n);
-//					cout << "residua=values-((m*nn)+n)=" << toString(x.values)
-//							 << "-" << "((" << toString(rr.m) << "*" << x.station.nn() << ")+"
-//							 << toString(rr.n) << "=" << toString(x.residua) << endl;
-        }
-      }
-
-			GridPPtr g = gs.front();
-			double cellSize = g->cellSize();
-			double r = g->gridPtr()->xcorner + (cellSize / 2);
-			double h = g->gridPtr()->ycorner + (double(g->rows()) * cellSize)-(cellSize / 2.0);
-      for(int i = 0, rs = g->rows(); i < rs; i++)
-      {
-        for(int j = 0, cs = g->cols(); j < cs; j++)
-        {
-          if(g->isDataField(i, j))
-          {
-            if(moreThanTwoStations)
-            {
-              double sum = 0.0;
-              vector<double> sumz(noOfResults, 0.0);
-
-              for(const X& x : xs)
-              {
-								double dist = x.rc.distanceTo(RectCoord(g->coordinateSystem(),
-																												r + (cellSize * j),
-                                                        h - (cellSize * i)));
-                if(dist > 1.0)
-                {
-                  sum += 1.0 / (dist * dist);
-                  sumz += x.residua / (dist * dist);
-                }
-              }
-              for(int k = 0; k < noOfResults; k++)
-              {
-                double dgm = env.dgm->dataAt(i, j);
-                double m = rr.m[k];
-                double n = rr.n[k];
-                double oldValue = dgm * m + n + sumz[k]/sum;
-								gs[k]->setDataAt(i, j, float(oldValue));
-//								cout << "dataAt(" << i << "," << j << ")="
-//										 << "dgm*m+n+sumz/sum="
-//										 << dgm << "*"
-//										 << m << "+" << n << "+"
-//										 << sumz[k] << "/" << sum << "="
-//										 << oldValue
-//										 << endl;
-              }
-            }
-            else
-            {
-              for(int k = 0; k < noOfResults; k++)
-              {
-                if(xs.size() == 2)
-                {
-                  const X& f = xs.at(0);
-                  const X& s = xs.at(1);
-									RectCoord cellRC = RectCoord(g->coordinateSystem(),
-																							 r + (cellSize*j),
-																							 h - (cellSize*i));
-									double df = f.rc.distanceTo(cellRC);
-									double ds = s.rc.distanceTo(cellRC);
-                  double fv = df/(df+ds)*f.values[k];
-                  double sv = ds/(df+ds)*s.values[k];
-									gs[k]->setDataAt(i, j, float(fv + sv));
-//									cout << "dataAt(" << i << "," << j << ")="
-//											 << "(fv + sv="
-//											 << fv << "+" << sv << "="
-//											 << (fv + sv)
-//											 << endl;
-								}
-                else
-                {
-									gs[k]->setDataAt(i, j, float(xs.at(0).values[k]));
-//									cout << "dataAt(" << i << "," << j << ")="
-//											 << "value=" << xs.at(0).values[k] << endl;
-								}
-
-              }
-            }
-					}
-				}
-			}
-      for(int k = 0; k < noOfResults; k++)
+      vector<GridPPtr> gs = interpolateYear(env, p.second);
+      for(int k = 0, noOfResults = gs.size(); k < noOfResults; k++)
       {
         ResultId rid = env.cacheInfo.resultIds[k];
 				newRes[rid][year] = gs.at(k);
@@ -680,17 +864,7 @@ Results Regionalization::regionalize(Env env)
 
 					if(env.cacheInfo.cacheData)
           {
-            string pathToHdfCache = env.cacheInfo.pathToHdfCache;
-            string functionIdString = env.cacheInfo.functionIdString;
-
-            ostringstream pathToHdf;
-            pathToHdf << pathToHdfCache;
-            if(*(pathToHdfCache.rbegin()) != '/')
-              pathToHdf << "/";
-						pathToHdf << gmd.toCanonicalString("_") << "/"
-								<< sim->name() << "/" << scen->name() << "/"
-								<< r->id() << "/" << acdsToString(acdsSet) << "/"
-								<< functionIdString << "/" << rid << ".hdf";
+            string pathToHdf = pathToHdfFor(env, gmd, sim, scen, r, acdsSet, rid);
 //						pathToHdf << gmd.toCanonicalString("_") << "/"
 //								<< sim->name() << "/" << scen->name() << "/"
 //								<< r->id() << "/" << acdsToString(acdsSet) << "/"
@@ -701,10 +875,10 @@ Results Regionalization::regionalize(Env env)
             //should be ok to store separately because the memory cache
             //is anyway only used during this runtime-session
             lock_guard<mutex> lock(diskCacheLockable);
-//            cout << "writing into hdf: year: " << year << " path: " << pathToHdf.str() << endl;
-            g->writeHdf(pathToHdf.str(), dsn.str(), "", coordinateSystemToShortString(gmd.coordinateSystem), -1);
-//						cout << "writeAscii path: " << pathToHdf.str() << endl;
-//						g->writeAscii(pathToHdf.str());
+//            cout << "writing into hdf: year: " << year << " path: " << pathToHdf << endl;
+            g->writeHdf(pathToHdf, dsn.str(), "", coordinateSystemToShortString(gmd.coordinateSystem), -1);
+//						cout << "writeAscii path: " << pathToHdf << endl;
+//						g->writeAscii(pathToHdf);
           }
 				}
 			}
@@ -748,3 +922,166 @@ AvgRealizationsResults Regionalization::regionalizeAndAvgRealizations(Env env)
 	return res;
 }
 
+
+namespace
+{
+  //! regionalizes single years of the realizations in env on demand
+  struct YearwiseRegionalization
+  {
+    YearwiseRegionalization(const Env& env)
+      : env(env),
+        gmd(env.dgm),
+        acdsSet(env.acds.begin(), env.acds.end()),
+        scen(env.realizations.front()->scenario()),
+        sim(scen->simulation()),
+        usedCS(env.dgm->coordinateSystem()),
+        climateStations(filterClimateStations(sim, gmd, env.borderSize))
+    {}
+
+    //! grids for all result ids of realization r in year,
+    //! either loaded from the hdf cache or newly regionalized
+    map<ResultId, GridPPtr> resultsFor(ClimateRealization* r, int year);
+
+    const Env& env;
+    GridMetaData gmd;
+    set<ACD> acdsSet;
+    ClimateScenario* scen;
+    ClimateSimulation* sim;
+    CoordinateSystem usedCS;
+    vector<const ClimateStation*> climateStations;
+    //! the station values are just (#stations x #results) per year,
+    //! so it's ok to keep them for the whole period
+    map<ClimateRealization*, map<int, vector<X> > > real2year2xs;
+  };
+
+  map<ResultId, GridPPtr>
+  YearwiseRegionalization::resultsFor(ClimateRealization* r, int year)
+  {
+    map<ResultId, GridPPtr> res;
+
+    ostringstream dsn;
+    dsn << year;
+
+    if(env.cacheInfo.cacheData)
+    {
+      lock_guard<mutex> lock(hdfCacheLockable());
+      for(ResultId rid : env.cacheInfo.resultIds)
+      {
+        GridPPtr g = GridPPtr(new GridP(dsn.str(), GridP::HDF,
+                                        pathToHdfFor(env, gmd, sim, scen, r, acdsSet, rid),
+                                        usedCS));
+        if(g->isValid())
+          res[rid] = g;
+      }
+      //assume that the cache contains for every year all the resultids
+      if(!res.empty())
+        return res;
+    }
+
+    if(climateStations.empty())
+      return res;
+
+    auto ci = real2year2xs.find(r);
+    if(ci == real2year2xs.end())
+    {
+      set<int> years = Tools::range<set<int> >(env.fromYear, env.toYear);
+      ci = real2year2xs.insert(make_pair(r, stationValuesPerYear(env, r, climateStations,
+                                                                 years, usedCS))).first;
+    }
+    auto ci2 = ci->second.find(year);
+    if(ci2 == ci->second.end())
+      return res;
+
+    vector<GridPPtr> gs = interpolateYear(env, ci2->second);
+    for(int k = 0, noOfResults = gs.size(); k < noOfResults; k++)
+    {
+      ResultId rid = env.cacheInfo.resultIds[k];
+      GridPPtr g = gs.at(k);
+      res[rid] = g;
+
+      if(env.cacheInfo.cacheData)
+      {
+        lock_guard<mutex> lock(hdfCacheLockable());
+        g->writeHdf(pathToHdfFor(env, gmd, sim, scen, r, acdsSet, rid), dsn.str(), "",
+                    coordinateSystemToShortString(gmd.coordinateSystem), -1);
+      }
+    }
+
+    return res;
+  }
+}
+
+void Regionalization::regionalizeStreamed(Env env,
+                                          StreamedResultCallback callback)
+{
+  if(env.realizations.empty() || !callback)
+    return;
+
+  YearwiseRegionalization yr(env);
+  for(int year = env.fromYear; year <= env.toYear; year++)
+  {
+    for(ClimateRealization* r : env.realizations)
+    {
+      for(const auto& p : yr.resultsFor(r, year))
+        callback(r, p.first, year, p.second);
+    }
+  }
+}
+
+void Regionalization::
+regionalizeAndAvgRealizationsStreamed(Env env,
+                                      StreamedAvgResultCallback callback)
+{
+  if(env.realizations.empty() || !callback)
+    return;
+
+  int rows = env.dgm->rows();
+  int cols = env.dgm->cols();
+
+  struct RunningSum
+  {
+    vector<double> sum;
+    int count{0};
+  };
+
+  YearwiseRegionalization yr(env);
+  for(int year = env.fromYear; year <= env.toYear; year++)
+  {
+    map<ResultId, RunningSum> sums;
+    for(ClimateRealization* r : env.realizations)
+    {
+      for(const auto& p : yr.resultsFor(r, year))
+      {
+        RunningSum& rs = sums[p.first];
+        if(rs.sum.empty())
+          rs.sum.resize(rows * cols, 0.0);
+
+        GridPPtr g = p.second;
+        for(int i = 0; i < rows; i++)
+        {
+          for(int j = 0; j < cols; j++)
+          {
+            if(g->isDataField(i, j))
+              rs.sum[i * cols + j] += g->dataAt(i, j);
+          }
+        }
+        rs.count++;
+      }
+    }
+
+    for(const auto& p : sums)
+    {
+      const RunningSum& rs = p.second;
+      GridPPtr avg = GridPPtr(env.dgm->clone());
+      for(int i = 0; i < rows; i++)
+      {
+        for(int j = 0; j < cols; j++)
+        {
+          if(avg->isDataField(i, j))
+            avg->setDataAt(i, j, float(rs.sum[i * cols + j] / rs.count));
+        }
+      }
+      callback(p.first, year, avg);
+    }
+  }
+}
@@ -57,6 +57,79 @@ namespace Climate
 														std::function<void(int, int)>(),
 														int borderSize = -1);
 
+		/*!
+		 * climate data of all stations for the whole year range,
+		 * one contiguous array per climate element and station
+		 * (the batch counterpart of applying a function to a DataAccessor)
+		 */
+		struct BatchInput
+		{
+			int noOfStations{0};
+			int fromYear{0};
+			//! number of years a result has to be calculated for
+			int noOfYears{0};
+			//! days a single year's calculation sees (365 * Env::yearSlice)
+			int windowSize{365};
+			//! days stored per station and climate element
+			int noOfDays{0};
+			//! [station * noOfDays + day]
+			std::map<ACD, std::vector<double> > columns;
+
+			//! pointer to the first of windowSize values of acd at station for year fromYear + k
+			const double* window(ACD acd, int station, int k) const
+			{
+				auto ci = columns.find(acd);
+				return ci == columns.end()
+					? nullptr
+					: ci->second.data() + (std::size_t(station) * noOfDays) + (k * 365);
+			}
+		};
+
+		//! preallocated [station x year x result] matrix
+		struct BatchResult
+		{
+			BatchResult(int noOfStations, int noOfYears, int noOfResults)
+				: noOfStations(noOfStations), noOfYears(noOfYears), noOfResults(noOfResults),
+					values(std::size_t(noOfStations) * noOfYears * noOfResults, 0.0) {}
+
+			double& at(int station, int k, int resultIndex)
+			{
+				return values[(std::size_t(station) * noOfYears + k) * noOfResults + resultIndex];
+			}
+
+			int noOfStations;
+			int noOfYears;
+			int noOfResults;
+			std::vector<double> values;
+		};
+
+		//! calculates the results of all stations and years in one call
+		typedef std::function<void(const BatchInput&, BatchResult&)> BatchFunction;
+
+		//! reduction kernels over n contiguous values, written to be auto-vectorized
+		double sumKernel(const double* vs, int n);
+
+		double meanKernel(const double* vs, int n);
+
+		int countAboveKernel(const double* vs, int n, double threshold);
+
+		//! sum of daily climaticWaterBalanceTW, globrad in MJ/m²/d
+		double climaticWaterBalanceKernel(const double* precip, const double* globrad,
+																			const double* tavg, int n, double fk = 1);
+
+		//! batch functions writing their single result to result index 0
+		BatchFunction batchSumFunction(ACD acd);
+
+		BatchFunction batchMeanFunction(ACD acd);
+
+		BatchFunction batchCountAboveFunction(ACD acd, double threshold);
+
+		//! needs precip, globrad and tavg
+		BatchFunction batchClimaticWaterBalanceFunction(double fk = 1);
+
+		//! batch version of defaultFunction
+		BatchFunction batchDefaultFunctionWith(ACD acd);
+
     struct CacheInfo
     {
       CacheInfo() : cacheData(false) {}
@@ -70,11 +143,12 @@ namespace Climate
     {
 			Env()
         : dgm(NULL), fromYear(0), toYear(0), yearSlice(1),
-					borderSize(borderSizeIncrementKM()), functionId(0) { }
+					borderSize(borderSizeIncrementKM()), functionId(0), noOfBatchResults(1) { }
 
 			Env(AvailableClimateData acd)
         : dgm(NULL), acds(1, acd), fromYear(0), toYear(0), yearSlice(1),
-				borderSize(borderSizeIncrementKM()), functionId(0), f(defaultFunctionWith(acd)) { }
+				borderSize(borderSizeIncrementKM()), functionId(0), f(defaultFunctionWith(acd)),
+				noOfBatchResults(1) { }
 
 			const Grids::GridP* dgm;
 			std::vector<AvailableClimateData> acds;
@@ -90,6 +164,11 @@ namespace Climate
 
 			//! function being applied to a complete year
 			std::function < FuncResult(DataAccessor) > f;
+
+			//! if set, used instead of f to calculate all stations and years at once
+			BatchFunction bf;
+			//! number of results bf writes per station and year
+			int noOfBatchResults;
 		};
 
     typedef std::map<int, std::vector<Grids::GridPPtr> > Result;
@@ -111,6 +190,30 @@ namespace Climate
     {
 			return regionalizeAndAvgRealizations(env).begin()->second;
 		}
+
+		//! receives a single regionalized grid (realization, result id, year, grid)
+		typedef std::function<void(ClimateRealization*, ResultId, int, Grids::GridPPtr)>
+				StreamedResultCallback;
+
+		/*!
+		 * like regionalize, but calls callback for every (realization, result id, year)
+		 * as soon as the grid is available, year by year, instead of returning all
+		 * of them at once
+		 * - the in-memory cache of regionalize is not used (it would keep all grids
+		 * resident), but the hdf cache is used if env.cacheInfo.cacheData is set
+		 */
+		void regionalizeStreamed(Env env, StreamedResultCallback callback);
+
+		//! receives a single realization averaged grid (result id, year, grid)
+		typedef std::function<void(ResultId, int, Grids::GridPPtr)> StreamedAvgResultCallback;
+
+		/*!
+		 * like regionalizeAndAvgRealizations, but averages the realizations of
+		 * a year with running sums and calls callback as soon as a year is complete,
+		 * so only the grids of a single year have to be kept in memory
+		 */
+		void regionalizeAndAvgRealizationsStreamed(Env env,
+																							 StreamedAvgResultCallback callback);
 	}
 }
 
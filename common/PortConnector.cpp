@@ -22,6 +22,8 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <kj/common.h>
 #include <kj/async.h>
 #include <kj/exception.h>
+#include <kj/function.h>
+#include <kj/timer.h>
 
 #include <capnp/capability.h>
 #include <capnp/message.h>
@@ -51,6 +53,7 @@ struct PortConnector::Impl {
   ConnectionManager &conMan;
   kj::Own<kj::PromiseFulfiller<void>> necessaryPortsConnected;
   toml::table tomlConfig;
+  ConnectPolicy policy;
 
   Impl(PortConnector &self, ConnectionManager& conMan,
     std::map<int, kj::StringPtr> inPorts,
@@ -82,71 +85,165 @@ struct PortConnector::Impl {
   //   }
   // }
 
-  void connectFromPortInfos(kj::StringPtr portInfosReaderSR) {
+  kj::Timer& timer() { return conMan.ioContext().provider->getTimer(); }
+
+  ConnectionManager::RetryPolicy retryPolicy() const {
+    return {policy.retryCount, policy.retryDelay, policy.maxRetryDelay};
+  }
+
+  // the declared ports which are not connected (yet)
+  PortConnector::ConnectResult unconnectedPorts(bool portInfosRead) {
+    PortConnector::ConnectResult res;
+    res.portInfosRead = portInfosRead;
+    for (auto &e : inPortsConnected) {
+      if (!e.value) res.unconnectedInPorts.add(e.key);
+    }
+    for (auto &e : outPortsConnected) {
+      bool connected = e.value;
+      KJ_IF_MAYBE(elems, outArrayPortsConnected.find(e.key)) {
+        connected = elems->size() > 0;
+        for (bool c : *elems) connected = connected && c;
+      }
+      if (!connected) res.unconnectedOutPorts.add(e.key);
+    }
+    return res;
+  }
+
+  kj::Promise<PortConnector::ConnectResult> connectFromPortInfos(kj::StringPtr portInfosReaderSR) {
     typedef mas::schema::fbp::Channel<mas::schema::fbp::PortInfos>::ChanReader PIReader;
-    auto reader = conMan.tryConnectB(portInfosReaderSR).castAs<PIReader>();
-    auto msg = reader.readRequest().send().wait(conMan.ioContext().waitScope);
-    if (msg.isDone()) {
-      return;
-    } else if (msg.hasValue()) {
+    auto portInfosRead = kj::heap<bool>(false);
+    auto allPorts = conMan.connectWithRetry(portInfosReaderSR, retryPolicy())
+    .then([](capnp::Capability::Client &&client) {
+      return client.castAs<PIReader>().readRequest().send();
+    }).then([this, portInfosRead = portInfosRead.get()](auto &&msg) -> kj::Promise<void> {
+      *portInfosRead = true;
+      if (msg.isDone() || !msg.hasValue()) return kj::READY_NOW;
+
+      kj::Vector<kj::Promise<void>> proms;
       if (msg.getValue().hasInPorts()) {
         for (auto nameAndSr : msg.getValue().getInPorts()) {
           if (nameAndSr.hasName() && nameAndSr.hasSr()) {
-            auto key = nameAndSr.getName();
-            KJ_IF_MAYBE(portId, inPortName2Id.find(key)) {
-              connectToSR(*portId, nameAndSr.getSr(), IN);
+            KJ_IF_MAYBE(portId, inPortName2Id.find(nameAndSr.getName())) {
+              proms.add(connectToSR(*portId, nameAndSr.getSr(), IN));
             }
           }
         }
       }
-      if (msg.getValue().hasOutPorts()){
+      if (msg.getValue().hasOutPorts()) {
         for (auto nameAndSr : msg.getValue().getOutPorts()) {
+          if (!nameAndSr.hasName()) continue;
           KJ_IF_MAYBE(portId, outPortName2Id.find(nameAndSr.getName())) {
-            if (nameAndSr.hasName()){
-              if (nameAndSr.hasSrs()) {
-                for (auto sr : nameAndSr.getSrs()) {
-                  connectToSR(*portId, sr, ARRAY_OUT);
-                }
-              } else if (nameAndSr.hasSr()) {
-                connectToSR(*portId, nameAndSr.getSr(), OUT);
+            if (nameAndSr.hasSrs()) {
+              // the slots keep the order of the sturdy refs, whichever connects first
+              auto srs = nameAndSr.getSrs();
+              kj::Vector<Channel::ChanWriter::Client> writers;
+              kj::Vector<bool> connected;
+              for (size_t i = 0; i < srs.size(); i++) {
+                writers.add(nullptr);
+                connected.add(false);
               }
+              outArrayPortCaps.upsert(*portId, kj::mv(writers));
+              outArrayPortsConnected.upsert(*portId, kj::mv(connected));
+              for (size_t i = 0; i < srs.size(); i++) proms.add(connectToSR(*portId, srs[i], ARRAY_OUT, i));
+            } else if (nameAndSr.hasSr()) {
+              proms.add(connectToSR(*portId, nameAndSr.getSr(), OUT));
             }
           }
         }
       }
-    }
+      // the sturdy refs are part of the message
+      return kj::joinPromises(proms.releaseAsArray()).attach(kj::mv(msg));
+    });
+
+    auto readPortInfos = portInfosRead.get();
+    return timer().timeoutAfter(policy.deadline, kj::mv(allPorts)).catch_([](kj::Exception &&e) {
+      KJ_LOG(ERROR, "couldn't connect all ports", e);
+    }).then([this, readPortInfos]() {
+      auto res = unconnectedPorts(*readPortInfos);
+      if (!res.allConnected()) {
+        KJ_LOG(ERROR, "unconnected ports", res.portInfosRead, kj::strArray(res.unconnectedInPorts, ","),
+               kj::strArray(res.unconnectedOutPorts, ","));
+      }
+      return res;
+    }).attach(kj::mv(portInfosRead));
   }
 
   enum PortType { IN, OUT, ARRAY_OUT };
-  void connectToSR(int portId, schema::persistence::SturdyRef::Reader sr, PortType portType) {
-    switch (portType) {
-    case IN: {
-      auto reader = conMan.tryConnectB(sr).castAs<Channel::ChanReader>();
-      inPortCaps.upsert(portId, kj::mv(reader));
-      inPortsConnected.upsert(portId, true);
-      break;
-    }
-    case OUT:{
-      auto writer = conMan.tryConnectB(sr).castAs<Channel::ChanWriter>();
-      outPortCaps.upsert(portId, kj::mv(writer));
-      outPortsConnected.upsert(portId, true);
-      break;
-    }
-    case ARRAY_OUT:{
-      auto writer = conMan.tryConnectB(sr).castAs<Channel::ChanWriter>();
-      KJ_IF_MAYBE(cap_vec, outArrayPortCaps.find(portId)) {
-        cap_vec->add(kj::mv(writer));
-      } else {
-        kj::Vector<Channel::ChanWriter::Client> vec;
-        vec.add(kj::mv(writer));
-        outArrayPortCaps.insert(portId, kj::mv(vec));
-        kj::Vector<bool> vec2;
-        vec2.add(true);
-        outArrayPortsConnected.upsert(portId, kj::mv(vec2));
+  // a port which can't be connected stays unconnected, the other ports are not affected
+  kj::Promise<void> connectToSR(int portId, schema::persistence::SturdyRef::Reader sr, PortType portType,
+                                size_t arrayIndex = 0) {
+    return conMan.connectWithRetry(sr, retryPolicy())
+    .then([this, portId, portType, arrayIndex](capnp::Capability::Client &&cap) {
+      switch (portType) {
+      case IN: {
+        inPortCaps.upsert(portId, cap.castAs<Channel::ChanReader>());
+        inPortsConnected.upsert(portId, true);
+        break;
+      }
+      case OUT: {
+        outPortCaps.upsert(portId, cap.castAs<Channel::ChanWriter>());
+        outPortsConnected.upsert(portId, true);
+        break;
+      }
+      case ARRAY_OUT: {
+        KJ_IF_MAYBE(writers, outArrayPortCaps.find(portId)) {
+          (*writers)[arrayIndex] = cap.castAs<Channel::ChanWriter>();
+        }
+        KJ_IF_MAYBE(connected, outArrayPortsConnected.find(portId)) {
+          (*connected)[arrayIndex] = true;
+        }
+        break;
+      }
+      }
+    }, [portId](kj::Exception &&e) {
+      KJ_LOG(ERROR, "couldn't connect port", portId, e);
+    });
+  }
+
+  // a closed port is marked as unconnected, the flag is only touched if the close succeeded
+  kj::Promise<void> closeOutPort(kj::String name, Channel::ChanWriter::Client &writer, bool &connected) {
+    KJ_LOG(INFO, kj::str("closing ", name, " OUT port"));
+    return writer.closeRequest().send().ignoreResult().then([&connected]() {
+      connected = false;
+    }, [name = kj::mv(name)](kj::Exception &&e) {
+      KJ_LOG(ERROR, "couldn't close OUT port", name, e);
+    });
+  }
+
+  kj::Promise<kj::Array<int>> closeOutPorts() {
+    kj::Vector<kj::Promise<void>> proms;
+    for (auto &e : outPortCaps) {
+      KJ_IF_MAYBE(connected, outPortsConnected.find(e.key)) {
+        if (!*connected) continue;
+        auto name = outPortId2Name.find(e.key);
+        proms.add(closeOutPort(name == nullptr ? kj::str(e.key) : kj::str(*name), e.value, *connected));
       }
-      break;
     }
+    for (auto &e : outArrayPortCaps) {
+      auto name = outPortId2Name.find(e.key);
+      KJ_IF_MAYBE(connected, outArrayPortsConnected.find(e.key)) {
+        for (size_t i = 0; i < e.value.size() && i < connected->size(); i++) {
+          if ((*connected)[i]) {
+            proms.add(closeOutPort(name == nullptr ? kj::str(e.key) : kj::str(*name), e.value[i], (*connected)[i]));
+          }
+        }
+      }
     }
+    return timer().timeoutAfter(policy.deadline, kj::joinPromises(proms.releaseAsArray()))
+    .catch_([](kj::Exception &&e) {
+      KJ_LOG(ERROR, "couldn't close all OUT ports", e);
+    }).then([this]() {
+      kj::Vector<int> notClosed;
+      for (auto &e : outPortsConnected) {
+        bool open = e.value;
+        KJ_IF_MAYBE(elems, outArrayPortsConnected.find(e.key)) {
+          open = false;
+          for (bool c : *elems) open = open || c;
+        }
+        if (open) notClosed.add(e.key);
+      }
+      return notClosed.releaseAsArray();
+    });
   }
 };
 
@@ -154,8 +251,16 @@ PortConnector::PortConnector(ConnectionManager &conMan, std::map<int, kj::String
   std::map<int, kj::StringPtr> outPorts)
   : impl(kj::heap<Impl>(*this, conMan, inPorts, outPorts)) {}
 
-void PortConnector::connectFromPortInfos(kj::StringPtr portInfosReaderSR) {
-  impl->connectFromPortInfos(portInfosReaderSR);
+void PortConnector::setConnectPolicy(ConnectPolicy policy) {
+  impl->policy = policy;
+}
+
+kj::Promise<PortConnector::ConnectResult> PortConnector::connectFromPortInfosAsync(kj::StringPtr portInfosReaderSR) {
+  return impl->connectFromPortInfos(portInfosReaderSR);
+}
+
+PortConnector::ConnectResult PortConnector::connectFromPortInfos(kj::StringPtr portInfosReaderSR) {
+  return impl->connectFromPortInfos(portInfosReaderSR).wait(impl->conMan.ioContext().waitScope);
 }
 
 PortConnector::Channel::ChanReader::Client PortConnector::in(int inPortId) {
@@ -171,6 +276,77 @@ void PortConnector::setInDisconnected(int inPortId) {
   impl->inPortsConnected.upsert(inPortId, false);
 }
 
+namespace {
+// the outcome of one of the pipelined readIfMsg calls of a remote readMany
+struct ReadIfMsgOutcome {
+  kj::Maybe<kj::Own<AnyPointerMsg::Reader>> msg;
+  bool done{false};
+  kj::Maybe<kj::Exception> error;
+};
+
+// take up to maxNoOfMsgs buffered messages with pipelined readIfMsg calls, which are delivered in order
+// on the same capability, a message which arrives while the calls are processed doesn't get lost,
+// because all values are kept in call order, even after a noMsg
+kj::Promise<Reader::Msgs> readBuffered(AnyPointerChannel::ChanReader::Client reader, size_t maxNoOfMsgs,
+                                       Reader::Msgs res) {
+  typedef capnp::Response<AnyPointerChannel::ChanReader::ReadIfMsgResults> ReadIfMsgResponse;
+  auto proms = kj::heapArrayBuilder<kj::Promise<ReadIfMsgOutcome>>(maxNoOfMsgs);
+  for (size_t i = 0; i < maxNoOfMsgs; i++) {
+    proms.add(reader.readIfMsgRequest().send().then([](ReadIfMsgResponse&& resp) {
+      ReadIfMsgOutcome o;
+      if (resp.isValue()) {
+        capnp::MallocMessageBuilder mb;
+        auto msg = mb.initRoot<AnyPointerMsg>();
+        msg.setValue(resp.getValue());
+        o.msg = capnp::clone(msg.asReader());
+      } else if (resp.isDone()) {
+        o.done = true;
+      }
+      return o;
+    }, [](kj::Exception&& e) {
+      ReadIfMsgOutcome o;
+      o.error = kj::mv(e);
+      return o;
+    }));
+  }
+  return kj::joinPromises(proms.finish()).then([res = kj::mv(res)](kj::Array<ReadIfMsgOutcome>&& outcomes) mutable {
+    for (auto& o : outcomes) {
+      // the reader is closed after done, so the remaining calls fail as expected, an earlier error
+      // is reported by the next read, the messages taken so far are consumed and have to be returned
+      KJ_IF_MAYBE(e, o.error) {
+        KJ_LOG(WARNING, "PortConnector::readMany: readIfMsg failed", *e);
+        break;
+      }
+      KJ_IF_MAYBE(msg, o.msg) res.msgs.add(kj::mv(*msg));
+      if (o.done) {
+        res.done = true;
+        break;
+      }
+    }
+    return kj::mv(res);
+  });
+}
+}
+
+kj::Promise<Reader::Msgs> PortConnector::readMany(int inPortId, size_t maxNoOfMsgs) {
+  auto reader = in(inPortId).castAs<AnyPointerChannel::ChanReader>();
+  return mas::infrastructure::common::Channel::localReader(reader).then(
+    [reader, maxNoOfMsgs](kj::Maybe<Reader&> local) mutable -> kj::Promise<Reader::Msgs> {
+      KJ_IF_MAYBE(r, local) return r->readMany(maxNoOfMsgs).attach(kj::mv(reader));
+      // the schema has no batch read, so block for the first message like read,
+      // then fill the batch with what is buffered by pipelined readIfMsg calls (two round trips)
+      return reader.readRequest().send().then(
+        [reader, maxNoOfMsgs](capnp::Response<AnyPointerMsg> &&resp) mutable -> kj::Promise<Reader::Msgs> {
+          Reader::Msgs res;
+          AnyPointerMsg::Reader msg = resp;
+          if (msg.isDone()) res.done = true;
+          else if (msg.isValue()) res.msgs.add(capnp::clone(msg));
+          if (res.done || maxNoOfMsgs <= 1) return kj::mv(res);
+          return readBuffered(kj::mv(reader), maxNoOfMsgs - 1, kj::mv(res));
+        });
+    });
+}
+
 PortConnector::Channel::ChanWriter::Client PortConnector::out(int outPortId) {
   Channel::ChanWriter::Client def(nullptr);
   return impl->outPortCaps.find(outPortId).orDefault(def);
@@ -199,23 +375,27 @@ bool PortConnector::isArrOutConnected(int outPortId, int portIndex) const {
   return false;
 }
 
-void PortConnector::closeOutPorts() {
-  for (auto [portId, writer] : impl->outPortCaps) {
-    if (isOutConnected(portId)) {
-      auto name = impl->outPortId2Name.find(portId);
-      KJ_LOG(INFO, kj::str("closing ", name.orDefault(kj::str(portId)), " OUT port"));
-      writer.closeRequest().send().wait(impl->conMan.ioContext().waitScope);
-    }
-  }
-  for (auto& [portId, vecOfWriters] : impl->outArrayPortCaps) {
-    int i = 0;
-    auto name = impl->outPortId2Name.find(portId);
-    for (auto &writer : vecOfWriters) {
-      if (isArrOutConnected(portId, i)) {
-        KJ_LOG(INFO, kj::str("closing ", name.orDefault(kj::str(portId)), " OUT port"));
-        writer.closeRequest().send().wait(impl->conMan.ioContext().waitScope);
+kj::Promise<void> PortConnector::writeMany(int outPortId, kj::ArrayPtr<const AnyPointerMsg::Reader> msgs) {
+  auto writer = out(outPortId).castAs<AnyPointerChannel::ChanWriter>();
+  return mas::infrastructure::common::Channel::localWriter(writer).then(
+    [writer, msgs](kj::Maybe<Writer&> local) mutable -> kj::Promise<void> {
+      KJ_IF_MAYBE(w, local) return w->writeMany(msgs).attach(kj::mv(writer));
+      // calls on the same capability are delivered in order
+      kj::Vector<kj::Promise<void>> proms;
+      for (auto msg : msgs) {
+        auto req = writer.writeRequest();
+        if (msg.isDone()) req.setDone();
+        else req.setValue(msg.getValue());
+        proms.add(req.send().ignoreResult());
       }
-      i++;
-    }
-  }
-}
\ No newline at end of file
+      return kj::joinPromises(proms.releaseAsArray());
+    });
+}
+
+kj::Promise<kj::Array<int>> PortConnector::closeOutPortsAsync() {
+  return impl->closeOutPorts();
+}
+
+kj::Array<int> PortConnector::closeOutPorts() {
+  return impl->closeOutPorts().wait(impl->conMan.ioContext().waitScope);
+}
@@ -27,6 +27,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <kj/memory.h>
 #include <kj/thread.h>
 #include <kj/async.h>
+#include <kj/time.h>
 
 #include <capnp/any.h>
 #include <capnp/rpc-twoparty.h>
@@ -35,6 +36,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include "common.capnp.h"
 #include "fbp.capnp.h"
 #include "rpc-connection-manager.h"
+#include "channel.h"
 
 namespace mas::infrastructure::common {
 
@@ -44,19 +46,55 @@ public:
 
   ~PortConnector() = default;
 
-  void connectFromPortInfos(kj::StringPtr portInfosReaderSR);
+  struct ConnectPolicy {
+    int retryCount{10}; // per port
+    kj::Duration retryDelay{1 * kj::SECONDS}; // doubled (and jittered) after every retry up to maxRetryDelay
+    kj::Duration maxRetryDelay{10 * kj::SECONDS};
+    // for reading the port infos and connecting all ports together (or closing all ports),
+    // longer than the retries of a single port (at most 1 + 2 + 4 + 8 + 6 * 10 = 75s)
+    kj::Duration deadline{120 * kj::SECONDS};
+  };
+  void setConnectPolicy(ConnectPolicy policy);
+
+  struct ConnectResult {
+    bool portInfosRead{false};
+    kj::Vector<int> unconnectedInPorts;
+    // OUT ports with at least one unconnected element if it is an array port
+    kj::Vector<int> unconnectedOutPorts;
+
+    bool allConnected() const {
+      return portInfosRead && unconnectedInPorts.empty() && unconnectedOutPorts.empty();
+    }
+  };
+
+  // connects all ports concurrently, ports not connected until the deadline stay unconnected
+  // and are part of the result
+  kj::Promise<ConnectResult> connectFromPortInfosAsync(kj::StringPtr portInfosReaderSR);
+  ConnectResult connectFromPortInfos(kj::StringPtr portInfosReaderSR);
 
   typedef mas::schema::fbp::IP IP;
   typedef mas::schema::fbp::Channel<IP> Channel;
   Channel::ChanReader::Client in(int inPortId);
   bool isInConnected(int inPortId) const;
   void setInDisconnected(int inPortId);
+  // read up to maxNoOfMsgs messages with one call if the IN port's channel runs on this thread
+  // (e.g. connected via a local capability). Batching over RPC is not part of the channel schema,
+  // so for a remote channel one message is read like read and the rest of the batch is filled with
+  // pipelined readIfMsg calls, i.e. one call per message, but only two round trips
+  kj::Promise<Reader::Msgs> readMany(int inPortId, size_t maxNoOfMsgs);
 
   Channel::ChanWriter::Client out(int outPortId);
   Channel::ChanWriter::Client arrOut(int outPortId, int portIndex);
   bool isOutConnected(int outPortId) const;
   bool isArrOutConnected(int outPortId, int portIndex) const;
-  void closeOutPorts();
+  // write the messages in order, with one call if the OUT port's channel runs on this thread,
+  // otherwise as pipelined write requests (one call per message, there is no batch write in the schema),
+  // the messages have to stay valid until the promise resolves
+  kj::Promise<void> writeMany(int outPortId, kj::ArrayPtr<const AnyPointerMsg::Reader> msgs);
+  // closes all connected OUT ports concurrently, returns the ids of the OUT ports
+  // which couldn't be closed until the deadline
+  kj::Promise<kj::Array<int>> closeOutPortsAsync();
+  kj::Array<int> closeOutPorts();
 
   struct Impl;
 private:
@@ -0,0 +1,148 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+// messages per second through an in-process channel
+// - read/write: one (local) RPC call per message, batches of pipelined write and read calls
+// - readMany/writeMany: the Reader/Writer behind the local clients, one call per batch
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/vector.h>
+
+#include <capnp/message.h>
+
+#include "channel.h"
+
+using namespace std;
+using namespace mas::infrastructure::common;
+
+namespace {
+struct Params {
+  size_t msgs{100000};
+  size_t batchSize{100};
+  uint64_t bufferSize{1000};
+  int payloadBytes{64};
+  int repetitions{3};
+};
+
+double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void printResult(kj::StringPtr mode, const Params& ps, double ms) {
+  cout << mode.cStr() << ": " << ps.msgs / (ms / 1000.0) << " msgs/s (" << ms << " ms for " << ps.msgs << " msgs)"
+       << endl;
+}
+
+// read until n messages have been received, readMany may return fewer than asked for
+kj::Promise<void> readAtLeast(Reader& reader, size_t n, size_t batchSize) {
+  if (n == 0) return kj::READY_NOW;
+  return reader.readMany(std::min(batchSize, n)).then([&reader, n, batchSize](Reader::Msgs&& res) {
+    KJ_REQUIRE(!res.done, "channel closed");
+    return readAtLeast(reader, n - std::min(n, res.msgs.size()), batchSize);
+  });
+}
+
+void measureReadWrite(AnyPointerChannel::ChanReader::Client reader, AnyPointerChannel::ChanWriter::Client writer,
+                      AnyPointerMsg::Reader msg, const Params& ps, kj::WaitScope& waitScope) {
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < ps.msgs; i += ps.batchSize) {
+    auto n = std::min(ps.batchSize, ps.msgs - i);
+    kj::Vector<kj::Promise<void>> proms;
+    for (size_t k = 0; k < n; k++) {
+      auto req = writer.writeRequest();
+      req.setValue(msg.getValue());
+      proms.add(req.send().ignoreResult());
+      proms.add(reader.readRequest().send().ignoreResult());
+    }
+    kj::joinPromises(proms.releaseAsArray()).wait(waitScope);
+  }
+  printResult("read/write", ps, msSince(start));
+}
+
+void measureReadManyWriteMany(Reader& reader, Writer& writer, AnyPointerMsg::Reader msg, const Params& ps,
+                              kj::WaitScope& waitScope) {
+  auto batch = kj::heapArray<AnyPointerMsg::Reader>(ps.batchSize);
+  for (auto& m : batch) m = msg;
+
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < ps.msgs; i += ps.batchSize) {
+    auto n = std::min(ps.batchSize, ps.msgs - i);
+    auto proms = kj::heapArrayBuilder<kj::Promise<void>>(2);
+    proms.add(writer.writeMany(batch.slice(0, n)));
+    proms.add(readAtLeast(reader, n, ps.batchSize));
+    kj::joinPromises(proms.finish()).wait(waitScope);
+  }
+  printResult("readMany/writeMany", ps, msSince(start));
+}
+
+void printUsage(const char* name) {
+  cout << "usage: " << name << " [options]" << endl
+       << " -msgs n ... messages per measurement (100000)" << endl
+       << " -batch n ... messages per batch (100)" << endl
+       << " -buffer n ... buffer size of the channel (1000)" << endl
+       << " -payload n ... bytes of text per message (64)" << endl
+       << " -repetitions n ... how often every measurement is repeated (3)" << endl;
+}
+}
+
+int main(int argc, char** argv) {
+  Params ps;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-msgs" && hasValue) ps.msgs = std::stoul(argv[++i]);
+    else if (arg == "-batch" && hasValue) ps.batchSize = std::max(1UL, std::stoul(argv[++i]));
+    else if (arg == "-buffer" && hasValue) ps.bufferSize = std::max(1UL, std::stoul(argv[++i]));
+    else if (arg == "-payload" && hasValue) ps.payloadBytes = atoi(argv[++i]);
+    else if (arg == "-repetitions" && hasValue) ps.repetitions = atoi(argv[++i]);
+    else {
+      printUsage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  auto io = kj::setupAsyncIo();
+  auto& waitScope = io.waitScope;
+
+  auto ownedChannel = kj::heap<Channel>("benchmark", "", ps.bufferSize, io.provider->getTimer());
+  auto channel = ownedChannel.get();
+  AnyPointerChannel::Client channelClient = kj::mv(ownedChannel);
+  channel->setClient(channelClient);
+
+  auto readerClient = channelClient.readerRequest().send().wait(waitScope).getR();
+  auto writerClient = channelClient.writerRequest().send().wait(waitScope).getW();
+  auto reader = Channel::localReader(readerClient).wait(waitScope);
+  auto writer = Channel::localWriter(writerClient).wait(waitScope);
+  KJ_REQUIRE(reader != nullptr && writer != nullptr, "the reader and writer of the channel have to be local");
+
+  capnp::MallocMessageBuilder mb;
+  auto msg = mb.initRoot<AnyPointerMsg>();
+  msg.getValue().setAs<capnp::Text>(string(ps.payloadBytes, 'x').c_str());
+
+  for (int r = 0; r < ps.repetitions; r++) {
+    measureReadWrite(readerClient, writerClient, msg.asReader(), ps, waitScope);
+    KJ_IF_MAYBE(rd, reader) {
+      KJ_IF_MAYBE(wr, writer) measureReadManyWriteMany(*rd, *wr, msg.asReader(), ps, waitScope);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include "channel-buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <kj/debug.h>
+
+#include <capnp/message.h>
+
+using namespace std;
+using namespace mas::infrastructure::common;
+
+ChannelBuffer::ChannelBuffer(uint64_t bufferSize) {
+  setBufferSize(bufferSize);
+}
+
+void ChannelBuffer::setBufferSize(uint64_t bufferSize) {
+  _bufferSize = std::max(static_cast<uint64_t>(1), bufferSize);
+  reserveEntries(_bufferSize);
+  reserveArena(_bufferSize * _arenaWordsPerMsg);
+}
+
+void ChannelBuffer::setArenaWordsPerMsg(uint64_t wordsPerMsg) {
+  // messages already in the arena stay there until they are read
+  _arenaWordsPerMsg = wordsPerMsg;
+  reserveArena(_bufferSize * _arenaWordsPerMsg);
+}
+
+void ChannelBuffer::setSpillLog(kj::Own<ChannelSpillLog> spillLog, uint64_t maxNoOfMsgsInMemory) {
+  _spillLog = kj::mv(spillLog);
+  _maxNoOfMsgsInMemory = maxNoOfMsgsInMemory;
+}
+
+void ChannelBuffer::reserveEntries(size_t noOfEntries) {
+  if (noOfEntries <= _entries.size()) return;
+
+  auto entries = kj::heapArray<Entry>(noOfEntries);
+  for (size_t i = 0; i < _noOfEntries; ++i) entries[i] = kj::mv(entry(i));
+  _entries = kj::mv(entries);
+  _first = 0;
+}
+
+void ChannelBuffer::reserveArena(size_t noOfWords) {
+  if (noOfWords <= _arena.size()) return;
+
+  // copy the arena messages in order to the start of the new arena
+  auto arena = kj::heapArray<capnp::word>(noOfWords);
+  size_t tail = 0;
+  for (size_t i = 0; i < _noOfEntries; ++i) {
+    auto& e = entry(i);
+    if (e.noOfWords == 0) continue;
+    memcpy(arena.begin() + tail, _arena.begin() + e.offset, e.noOfWords * sizeof(capnp::word));
+    e.offset = tail;
+    tail += e.noOfWords;
+  }
+  _arena = kj::mv(arena);
+  _arenaHead = 0;
+  _arenaTail = tail;
+  _arenaWrapped = false;
+}
+
+size_t ChannelBuffer::allocateArenaWords(size_t noOfWords) {
+  if (!_arenaWrapped) {
+    if (_arenaTail + noOfWords <= _arena.size()) {
+      auto offset = _arenaTail;
+      _arenaTail += noOfWords;
+      return offset;
+    }
+    // not enough space at the end, but at the start of the arena
+    if (noOfWords <= _arenaHead) {
+      _arenaWrapped = true;
+      _arenaTail = noOfWords;
+      return 0;
+    }
+  } else if (_arenaTail + noOfWords <= _arenaHead) {
+    auto offset = _arenaTail;
+    _arenaTail += noOfWords;
+    return offset;
+  }
+
+  // the messages are larger than expected, grow and compact the arena
+  reserveArena(std::max(2 * _arena.size(), _noOfUsedArenaWords + noOfWords));
+  auto offset = _arenaTail;
+  _arenaTail += noOfWords;
+  return offset;
+}
+
+void ChannelBuffer::push(AnyPointerMsg::Reader msg) {
+  auto size = msg.totalSize();
+
+  // keep the order, once spilling started everything goes to the log until it has been read
+  if (_spillLog != nullptr && size.capCount == 0
+      && (!_spillLog->empty() || _noOfEntries >= _maxNoOfMsgsInMemory)) {
+    _spillLog->append(msg);
+    return;
+  }
+
+  if (_noOfEntries == _entries.size()) reserveEntries(2 * _entries.size());
+  auto& e = entry(_noOfEntries);
+
+  if (_arenaWordsPerMsg > 0 && size.capCount == 0) {
+    // one word for the root pointer, like capnp::clone
+    auto noOfWords = size.wordCount + 1;
+    e.offset = allocateArenaWords(noOfWords);
+    e.noOfWords = noOfWords;
+    auto words = _arena.slice(e.offset, e.offset + noOfWords);
+    memset(words.begin(), 0, noOfWords * sizeof(capnp::word));
+    capnp::copyToUnchecked(msg, words);
+    _noOfArenaEntries++;
+    _noOfUsedArenaWords += noOfWords;
+  } else {
+    e.offset = 0;
+    e.noOfWords = 0;
+    e.cloned = capnp::clone(msg);
+  }
+  _noOfEntries++;
+}
+
+AnyPointerMsg::Reader ChannelBuffer::oldest() {
+  if (_noOfEntries == 0 && _spillLog != nullptr) return _spillLog->oldest();
+  KJ_REQUIRE(_noOfEntries > 0, "ChannelBuffer::oldest: buffer is empty");
+  const auto& e = entry(0);
+  if (e.noOfWords > 0) return capnp::readMessageUnchecked<AnyPointerMsg>(_arena.begin() + e.offset);
+  return *e.cloned;
+}
+
+void ChannelBuffer::pop() {
+  if (_noOfEntries == 0 && _spillLog != nullptr) return _spillLog->pop();
+  KJ_REQUIRE(_noOfEntries > 0, "ChannelBuffer::pop: buffer is empty");
+  auto& e = entry(0);
+  if (e.noOfWords > 0) {
+    // the oldest message starts before the head, so the tail didn't wrap anymore
+    if (e.offset < _arenaHead) _arenaWrapped = false;
+    _arenaHead = e.offset + e.noOfWords;
+    _noOfUsedArenaWords -= e.noOfWords;
+    if (--_noOfArenaEntries == 0) {
+      _arenaHead = _arenaTail = 0;
+      _arenaWrapped = false;
+    }
+    e.noOfWords = 0;
+  } else {
+    e.cloned = nullptr;
+  }
+  _first = (_first + 1) % _entries.size();
+  _noOfEntries--;
+}
+
+kj::Own<AnyPointerMsg::Reader> ChannelBuffer::take() {
+  if (_noOfEntries == 0) {
+    auto msg = capnp::clone(oldest());
+    pop();
+    return msg;
+  }
+  auto& e = entry(0);
+  auto msg = e.noOfWords > 0 ? capnp::clone(oldest()) : kj::mv(e.cloned);
+  pop();
+  return msg;
+}
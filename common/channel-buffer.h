@@ -0,0 +1,99 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#pragma once
+
+#include <kj/array.h>
+#include <kj/memory.h>
+
+#include <capnp/any.h>
+
+#include "channel-spill-log.h"
+#include "fbp.capnp.h"
+
+namespace mas::infrastructure::common {
+
+typedef mas::schema::fbp::Channel<capnp::AnyPointer> AnyPointerChannel;
+typedef typename AnyPointerChannel::Msg AnyPointerMsg;
+
+// FIFO of the messages buffered by a channel.
+// By default every message is a separate capnp::clone. In arena mode messages without capabilities
+// are copied into one contiguous ring of words, pre-sized to bufferSize * arenaWordsPerMsg and only
+// grown if the messages are larger on average. Messages with capabilities are always cloned,
+// because their capability table can't live in the arena.
+// With a spill log, messages beyond maxNoOfMsgsInMemory are appended to the log and read from it
+// once the messages in memory have been read. Messages with capabilities are never spilled,
+// so they may overtake spilled messages.
+class ChannelBuffer {
+public:
+  explicit ChannelBuffer(uint64_t bufferSize = 1);
+
+  size_t size() const { return _noOfEntries + (_spillLog != nullptr ? _spillLog->size() : 0); }
+  bool empty() const { return size() == 0; }
+
+  void setBufferSize(uint64_t bufferSize);
+
+  // 0 = clone every message (default)
+  void setArenaWordsPerMsg(uint64_t wordsPerMsg);
+  uint64_t arenaWordsPerMsg() const { return _arenaWordsPerMsg; }
+
+  size_t arenaSizeInWords() const { return _arena.size(); }
+
+  // the log might already contain messages of a previous run, they are read first
+  void setSpillLog(kj::Own<ChannelSpillLog> spillLog, uint64_t maxNoOfMsgsInMemory);
+  size_t noOfSpilledMsgs() const { return _spillLog != nullptr ? _spillLog->size() : 0; }
+
+  void push(AnyPointerMsg::Reader msg);
+
+  // the oldest message, only valid until the next push or pop
+  AnyPointerMsg::Reader oldest();
+
+  void pop();
+
+  // remove the oldest message and return it as an own message (arena messages are copied out)
+  kj::Own<AnyPointerMsg::Reader> take();
+
+private:
+  struct Entry {
+    size_t offset{0};
+    size_t noOfWords{0}; // > 0 = stored in the arena
+    kj::Own<AnyPointerMsg::Reader> cloned;
+  };
+
+  Entry& entry(size_t i) { return _entries[(_first + i) % _entries.size()]; }
+  const Entry& entry(size_t i) const { return _entries[(_first + i) % _entries.size()]; }
+
+  void reserveEntries(size_t noOfEntries);
+  void reserveArena(size_t noOfWords);
+  size_t allocateArenaWords(size_t noOfWords);
+
+  kj::Array<Entry> _entries; // ring, _first is the oldest entry
+  size_t _first{0};
+  size_t _noOfEntries{0};
+  uint64_t _bufferSize{1};
+
+  kj::Array<capnp::word> _arena; // ring of the serialized messages, wraps to 0 if the end is reached
+  uint64_t _arenaWordsPerMsg{0};
+  size_t _arenaHead{0}; // start of the oldest arena message
+  size_t _arenaTail{0}; // end of the newest arena message
+  bool _arenaWrapped{false}; // _arenaTail is before _arenaHead
+  size_t _noOfArenaEntries{0};
+  size_t _noOfUsedArenaWords{0};
+
+  kj::Own<ChannelSpillLog> _spillLog;
+  uint64_t _maxNoOfMsgsInMemory{0};
+};
+
+} // namespace mas::infrastructure::common
@@ -14,11 +14,15 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 */
 
 #include <iostream>
+#include <mutex>
 
 #include <kj/common.h>
 #include <kj/debug.h>
+#include <kj/encoding.h>
 #include <kj/main.h>
+#include <kj/mutex.h>
 #include <kj/string.h>
+#include <kj/thread.h>
 #include <kj/tuple.h>
 #include <kj/vector.h>
 
@@ -48,6 +52,46 @@ namespace infrastructure {
         return true;
       }
 
+      kj::MainBuilder::Validity setArenaWordsPerMsg(kj::StringPtr words) {
+        arenaWordsPerMsg = std::stoul(words.cStr());
+        return true;
+      }
+
+      kj::MainBuilder::Validity setSpillDir(kj::StringPtr dir) {
+        spillDir = kj::str(dir);
+        return true;
+      }
+
+      kj::MainBuilder::Validity setMaxMsgsInMemory(kj::StringPtr no) {
+        maxMsgsInMemory = std::stoul(no.cStr());
+        return true;
+      }
+
+      kj::MainBuilder::Validity setReplaySpilled() {
+        replaySpilled = true;
+        return true;
+      }
+
+      kj::MainBuilder::Validity setStatsMinInterval(kj::StringPtr ms) {
+        statsMinIntervalInMs = static_cast<uint32_t>(std::stoul(ms.cStr()));
+        return true;
+      }
+
+      kj::MainBuilder::Validity setStatsChangeThreshold(kj::StringPtr no) {
+        statsChangeThreshold = std::stoul(no.cStr());
+        return true;
+      }
+
+      kj::MainBuilder::Validity setStatsLogInterval(kj::StringPtr seconds) {
+        statsLogIntervalInS = static_cast<uint32_t>(std::stoul(seconds.cStr()));
+        return true;
+      }
+
+      kj::MainBuilder::Validity setNoOfThreads(kj::StringPtr no) {
+        noOfThreads = static_cast<uint32_t>(std::max(1UL, std::stoul(no.cStr())));
+        return true;
+      }
+
       kj::MainBuilder::Validity setExitTimeout(kj::StringPtr timeoutInSeconds) {
         exitTimeout = std::max(1, std::stoi(timeoutInSeconds.cStr()));
         return true;
@@ -92,6 +136,24 @@ namespace infrastructure {
       }
 
       kj::MainBuilder::Validity startChannel() {
+        // only the restorer of shard 0 keeps its vat id and port in the restorer container,
+        // the sturdy refs of the other shards wouldn't survive a restart
+        if (noOfThreads > 1 && restorerContainerSR.size() > 0) {
+          return kj::str("--threads > 1 can't be used with --restorer_container_sr (persistent sturdy refs).");
+        }
+        if (spillDir.size() > 0 && bufferSize <= maxMsgsInMemory) {
+          return kj::str("--spill_dir needs --buffer_size (", bufferSize, ") > --max_msgs_in_memory (",
+                         maxMsgsInMemory, "), otherwise no message is ever spilled.");
+        }
+        // the spill logs are keyed by the first reader sturdy ref token, generated tokens change on every start
+        if (spillDir.size() > 0 && replaySpilled) {
+          for (auto c = 0; c < noOfChannels; c++) {
+            if (c >= readerSrts.size() || readerSrts[c].empty()) {
+              return kj::str("--replay_spilled needs --reader_srts for every channel, they identify the spill logs.");
+            }
+          }
+        }
+
         for (auto c = 0; c < noOfChannels; c++) {
           auto& rsrts = c < readerSrts.size() ? readerSrts[c] : readerSrts.add(kj::Vector<kj::String>());
           for (auto i = 0; i < noOfReadersPerChannel; i++) {
@@ -109,111 +171,30 @@ namespace infrastructure {
 
         startRestorerSetup(nullptr);
 
-        KJ_LOG(INFO, "starting channel(s)");
-
-        for (auto i = 0; i < noOfChannels; i++) {
-          auto ownedChannel = kj::heap<Channel>(name, description, bufferSize,
-                                                ioContext.provider->getTimer());
-          auto channel = ownedChannel.get();
-          AnyPointerChannel::Client channelClient = kj::mv(ownedChannel);
-          KJ_LOG(INFO, "created channel");
-
-          channel->setRestorer(restorer);
-
-          using SI = mas::schema::fbp::Channel<capnp::AnyPointer>::StartupInfo;
-          using P = mas::schema::common::Pair<capnp::Text, SI>;
-          using SIC = mas::schema::fbp::Channel<P>;
-
-          kj::Maybe<SI::Builder> startupInfo;
-          kj::Maybe<capnp::Request<SIC::Msg, SIC::ChanWriter::WriteResults>> infoReq;
-          KJ_IF_MAYBE(anyOut, startupInfoWriterClient) {
-            auto out = anyOut->castAs<SIC::ChanWriter>();
-            infoReq = out.writeRequest();
-            KJ_IF_MAYBE(req, infoReq) {
-              auto p = req->initValue();
-              p.setFst(startupInfoWriterSRId);
-              auto info = p.initSnd();
-              info.setBufferSize(bufferSize);
-              info.setChannel(channelClient);
-
-              restorer->save(channelClient, info.initChannelSR(), nullptr, nullptr, nullptr, false)
-                      .wait(ioContext.waitScope);
-              auto channelSRUrl = restorer->sturdyRefStr(info.getChannelSR().getLocalRef().getText());
-              if (outputSturdyRefs && channelSRUrl.size() >
-                  0)
-                std::cout << "channelSR=" << channelSRUrl.cStr() << std::endl;
-
-              info.initReaders(readerSrts.size());
-              info.initReaderSRs(readerSrts.size());
-              info.initWriters(writerSrts.size());
-              info.initWriterSRs(writerSrts.size());
-              startupInfo = info;
-            }
-          } else {
-            auto channelSR = restorer->saveStr(channelClient, nullptr, nullptr, false).wait(ioContext.waitScope).
-                                       sturdyRef;
-            if (outputSturdyRefs && channelSR.size() > 0) std::cout << "channelSR=" << channelSR.cStr() << std::endl;
-          }
-
-          auto& rsrts = readerSrts[i];
-          for (auto k = 0; k < noOfReadersPerChannel; k++) {
-            const auto& srt = rsrts[k];
-            auto reader = channelClient.readerRequest().send().wait(ioContext.waitScope).getR();
-            KJ_IF_MAYBE(info, startupInfo) {
-              restorer->save(reader, info->getReaderSRs()[k], nullptr, nullptr, nullptr, false).
-                        wait(ioContext.waitScope);
-              auto readerSRUrl = restorer->sturdyRefStr(info->getReaderSRs()[k].getLocalRef().getText());
-              if (outputSturdyRefs && readerSRUrl.size() >
-                  0)
-                std::cout << "\treaderSR=" << readerSRUrl.cStr() << std::endl;
-              info->getReaders().set(k, kj::mv(reader));
-            } else {
-              auto readerSR =
-                restorer->saveStr(reader, srt, nullptr, false, nullptr, false).wait(ioContext.waitScope).sturdyRef;
-              if (outputSturdyRefs && readerSR.size() > 0) std::cout << "\treaderSR=" << readerSR.cStr() << std::endl;
-            }
-          }
-          auto& wsrts = writerSrts[i];
-          for (auto k = 0; k < noOfWritersPerChannel; k++) {
-            const auto& srt = wsrts[k];
-            auto writer = channelClient.writerRequest().send().wait(ioContext.waitScope).getW();
-            KJ_IF_MAYBE(info, startupInfo) {
-              restorer->save(writer, info->getWriterSRs()[k], nullptr, nullptr, nullptr, false).
-                        wait(ioContext.waitScope);
-              auto writerSRUrl = restorer->sturdyRefStr(info->getWriterSRs()[k].getLocalRef().getText());
-              if (outputSturdyRefs && writerSRUrl.size() >
-                  0)
-                std::cout << "\twriterSR=" << writerSRUrl.cStr() << std::endl;
-              info->getWriters().set(k, kj::mv(writer));
-            } else {
-              auto writerSR =
-                restorer->saveStr(writer, srt, nullptr, false, nullptr, false).wait(ioContext.waitScope).sturdyRef;
-              if (outputSturdyRefs && writerSR.size() > 0) std::cout << "\twriterSR=" << writerSR.cStr() << std::endl;
-            }
-          }
+        // the other shards get their own restorer, bound to their own port, the sturdy refs are
+        // created the same way, just pointing to the shard hosting the channel
+        // (the threads are declared last, so they are joined before the data they use is destroyed)
+        auto shardHost = kj::str(restorer->getHost());
+        kj::Vector<kj::Own<kj::MutexGuarded<ShardControl>>> shardControls;
+        kj::Vector<kj::Own<kj::Thread>> shardThreads;
+        // the shards run until their channels are closed, so they have to be stopped before being joined
+        KJ_ON_SCOPE_FAILURE(stopShards(shardControls));
+        for (uint32_t shard = 1; shard < noOfThreads; shard++) {
+          auto& control = *shardControls.add(kj::heap<kj::MutexGuarded<ShardControl>>());
+          shardThreads.add(kj::heap<kj::Thread>([this, shard, &shardHost, &control]() {
+            runShard(shard, shardHost, control);
+          }));
+        }
 
-          KJ_IF_MAYBE(req, infoReq) {
-            req->send().wait(ioContext.waitScope);
-          }
+        KJ_LOG(INFO, "starting channel(s)");
 
-          auto cd = kj::heap<ChannelData>(kj::mv(channelClient), channel);
-          allChannelData.add(kj::mv(cd));
-          channels.add(*allChannelData.back());
+        for (uint64_t i = 0; i < noOfChannels; i += noOfThreads) {
+          setupChannel(i, *restorer, ioContext.provider->getTimer(), ioContext.waitScope, startupInfoWriterClient,
+                       channels, allChannelData);
         }
 
         // Run forever, accepting connections and handling requests.
-        auto statsProms = kj::heapArrayBuilder<kj::Promise<void>>(channels.size());
-        auto closeProms = kj::heapArrayBuilder<kj::Promise<void>>(channels.size());
-        for (auto& cd : channels) {
-          statsProms.add(cd.channel->sendStats());
-          closeProms.add(cd.channel->closeChannel().then([this, &cd]() {
-            KJ_LOG(INFO, "removing channel");
-            channels.remove(cd);
-          }));
-        }
-        kj::joinPromises(statsProms.finish()).
-          exclusiveJoin(kj::joinPromises(closeProms.finish())).
-          wait(ioContext.waitScope);
+        runChannels(channels, ioContext.provider->getTimer(), ioContext.waitScope, kj::NEVER_DONE);
 
         // kj::Timer& timer = ioContext.provider->getTimer();
         // while (true) {
@@ -224,6 +205,9 @@ namespace infrastructure {
         //     if (cd.channel->closeChannel()) channels.remove(cd);
         //   }
         // }
+
+        // wait for the other shards to close their channels
+        shardThreads.clear();
         KJ_LOG(INFO, "stopped channels vat");
         return true;
       }
@@ -232,8 +216,36 @@ namespace infrastructure {
         return addRestorableServiceOptions()
                .addOptionWithArg({'#', "no_of_channels"}, KJ_BIND_METHOD(*this, setNoOfChannels), "<no_of_channels=1>",
                                  "Set the number of channels to start.")
+               .addOptionWithArg({"threads"}, KJ_BIND_METHOD(*this, setNoOfThreads), "<no_of_threads=1>",
+                                 "Shard the channels over this many threads, each with an own event loop and "
+                                 "restorer bound to an own port (consecutive ports if --port is set). "
+                                 "Can't be used with --restorer_container_sr.")
                .addOptionWithArg({'b', "buffer_size"}, KJ_BIND_METHOD(*this, setBufferSize), "<buffer_size=1>",
                                  "Set buffer size of channel.")
+               .addOptionWithArg({"arena_words_per_msg"}, KJ_BIND_METHOD(*this, setArenaWordsPerMsg),
+                                 "<words (default: 0 = off)>",
+                                 "Store buffered messages in an arena of buffer_size * words (8 byte) words "
+                                 "instead of a heap copy per message.")
+               .addOptionWithArg({"spill_dir"}, KJ_BIND_METHOD(*this, setSpillDir), "<directory>",
+                                 "Spill buffered messages beyond max_msgs_in_memory to logs in this directory "
+                                 "(buffer_size is then the memory plus disk capacity and has to be larger than "
+                                 "max_msgs_in_memory). Every channel's log is named after its first reader sturdy "
+                                 "ref token.")
+               .addOptionWithArg({"max_msgs_in_memory"}, KJ_BIND_METHOD(*this, setMaxMsgsInMemory),
+                                 "<max_msgs_in_memory (default: 1000)>",
+                                 "Max number of buffered messages per channel kept in memory when spilling.")
+               .addOptionWithArg({"stats_min_interval_ms"}, KJ_BIND_METHOD(*this, setStatsMinInterval),
+                                 "<milliseconds (default: 100)>",
+                                 "Send stats to immediate stats callbacks at most every this many milliseconds.")
+               .addOptionWithArg({"stats_change_threshold"}, KJ_BIND_METHOD(*this, setStatsChangeThreshold),
+                                 "<no_of_changes (default: 0 = off)>",
+                                 "Send stats to immediate stats callbacks as soon as this many reads and writes happened.")
+               .addOptionWithArg({"stats_log_interval"}, KJ_BIND_METHOD(*this, setStatsLogInterval),
+                                 "<seconds (default: 0 = off)>",
+                                 "Log the throughput, queue and wait times of every channel every this many seconds.")
+               .addOption({"replay_spilled"}, KJ_BIND_METHOD(*this, setReplaySpilled),
+                          "Deliver the unread spilled messages of a previous run first, instead of discarding them. "
+                          "Needs --reader_srts to find the logs of the channels again.")
                .addOptionWithArg({'c', "create"}, KJ_BIND_METHOD(*this, setNoOfReaderWriterPairs),
                                  "<number_of_reader_writer_pairs (default: 1)>",
                                  "Create number of reader/writer pairs per channel.")
@@ -256,22 +268,240 @@ namespace infrastructure {
       }
 
     private:
-      uint64_t bufferSize{1};
-      uint64_t exitTimeout{3};
-      uint64_t noOfChannels{1};
-      uint8_t noOfReadersPerChannel{1};
-      uint8_t noOfWritersPerChannel{1};
-
       struct ChannelData {
+        uint64_t index;
         AnyPointerChannel::Client client{nullptr};
         Channel* channel;
         kj::ListLink<ChannelData> link;
 
-        ChannelData(AnyPointerChannel::Client client, Channel* channel) : client(kj::mv(client))
-                                                                        , channel(channel) {}
+        ChannelData(uint64_t index, AnyPointerChannel::Client client, Channel* channel) : index(index)
+                                                                                        , client(kj::mv(client))
+                                                                                        , channel(channel) {}
+      };
+      typedef kj::List<ChannelData, &ChannelData::link> ChannelList;
+
+      // lets the main thread stop a shard, whether it is still setting up, running or already done
+      struct ShardControl {
+        bool stopRequested{false};
+        // set while the shard's event loop runs
+        kj::Maybe<kj::Own<const kj::Executor>> executor;
+        // only used on the shard's thread
+        kj::PromiseFulfiller<void>* stop{nullptr};
       };
 
-      kj::List<ChannelData, &ChannelData::link> channels;
+      void stopShards(kj::Vector<kj::Own<kj::MutexGuarded<ShardControl>>>& shardControls) {
+        for (auto& control : shardControls) {
+          kj::Maybe<kj::Own<const kj::Executor>> executor;
+          {
+            auto lock = control->lockExclusive();
+            lock->stopRequested = true;
+            KJ_IF_MAYBE(e, lock->executor) executor = (*e)->addRef();
+          }
+          KJ_IF_MAYBE(e, executor) {
+            // the shard's event loop might have just finished
+            KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+              (*e)->executeSync([&]() {
+                auto lock = control->lockExclusive();
+                if (lock->stop) lock->stop->fulfill();
+              });
+            })) {
+              KJ_LOG(INFO, "shard already stopped", *exception);
+            }
+          }
+        }
+      }
+
+      void outputSturdyRef(kj::StringPtr prefix, kj::StringPtr sr) {
+        if (!outputSturdyRefs || sr.size() == 0) return;
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << prefix.cStr() << sr.cStr() << std::endl;
+      }
+
+      // create channel i and its readers and writers on the calling thread's event loop
+      void setupChannel(uint64_t i, Restorer& restorer, kj::Timer& timer, kj::WaitScope& waitScope,
+                        kj::Maybe<mas::schema::fbp::Channel<P>::ChanWriter::Client>& infoWriterClient,
+                        ChannelList& channels, kj::Vector<kj::Own<ChannelData>>& allChannelData) {
+        auto ownedChannel = kj::heap<Channel>(name, description, bufferSize, timer);
+        auto channel = ownedChannel.get();
+        AnyPointerChannel::Client channelClient = kj::mv(ownedChannel);
+        KJ_LOG(INFO, "created channel", i);
+
+        channel->setRestorer(&restorer);
+        channel->setArenaWordsPerMsg(arenaWordsPerMsg);
+        channel->setStatsRateLimit(statsMinIntervalInMs, statsChangeThreshold);
+        // every channel gets its own log, named after the token of its first reader, which (if given)
+        // identifies the channel over restarts, independent of the number and order of the channels
+        if (spillDir.size() > 0) {
+          channel->spillToDisk(kj::str(spillDir, "/", kj::encodeUriComponent(readerSrts[i][0])), maxMsgsInMemory,
+                               replaySpilled);
+        }
+
+        using SI = mas::schema::fbp::Channel<capnp::AnyPointer>::StartupInfo;
+        using P = mas::schema::common::Pair<capnp::Text, SI>;
+        using SIC = mas::schema::fbp::Channel<P>;
+
+        kj::Maybe<SI::Builder> startupInfo;
+        kj::Maybe<capnp::Request<SIC::Msg, SIC::ChanWriter::WriteResults>> infoReq;
+        KJ_IF_MAYBE(anyOut, infoWriterClient) {
+          auto out = anyOut->castAs<SIC::ChanWriter>();
+          infoReq = out.writeRequest();
+          KJ_IF_MAYBE(req, infoReq) {
+            auto p = req->initValue();
+            p.setFst(startupInfoWriterSRId);
+            auto info = p.initSnd();
+            info.setBufferSize(bufferSize);
+            info.setChannel(channelClient);
+
+            restorer.save(channelClient, info.initChannelSR(), nullptr, nullptr, nullptr, false).wait(waitScope);
+            auto channelSRUrl = restorer.sturdyRefStr(info.getChannelSR().getLocalRef().getText());
+            outputSturdyRef("channelSR=", channelSRUrl);
+
+            info.initReaders(readerSrts.size());
+            info.initReaderSRs(readerSrts.size());
+            info.initWriters(writerSrts.size());
+            info.initWriterSRs(writerSrts.size());
+            startupInfo = info;
+          }
+        } else {
+          auto channelSR = restorer.saveStr(channelClient, nullptr, nullptr, false).wait(waitScope).sturdyRef;
+          outputSturdyRef("channelSR=", channelSR);
+        }
+
+        auto& rsrts = readerSrts[i];
+        for (auto k = 0; k < noOfReadersPerChannel; k++) {
+          const auto& srt = rsrts[k];
+          auto reader = channelClient.readerRequest().send().wait(waitScope).getR();
+          KJ_IF_MAYBE(info, startupInfo) {
+            restorer.save(reader, info->getReaderSRs()[k], nullptr, nullptr, nullptr, false).wait(waitScope);
+            auto readerSRUrl = restorer.sturdyRefStr(info->getReaderSRs()[k].getLocalRef().getText());
+            outputSturdyRef("\treaderSR=", readerSRUrl);
+            info->getReaders().set(k, kj::mv(reader));
+          } else {
+            auto readerSR =
+              restorer.saveStr(reader, srt, nullptr, false, nullptr, false).wait(waitScope).sturdyRef;
+            outputSturdyRef("\treaderSR=", readerSR);
+          }
+        }
+        auto& wsrts = writerSrts[i];
+        for (auto k = 0; k < noOfWritersPerChannel; k++) {
+          const auto& srt = wsrts[k];
+          auto writer = channelClient.writerRequest().send().wait(waitScope).getW();
+          KJ_IF_MAYBE(info, startupInfo) {
+            restorer.save(writer, info->getWriterSRs()[k], nullptr, nullptr, nullptr, false).wait(waitScope);
+            auto writerSRUrl = restorer.sturdyRefStr(info->getWriterSRs()[k].getLocalRef().getText());
+            outputSturdyRef("\twriterSR=", writerSRUrl);
+            info->getWriters().set(k, kj::mv(writer));
+          } else {
+            auto writerSR =
+              restorer.saveStr(writer, srt, nullptr, false, nullptr, false).wait(waitScope).sturdyRef;
+            outputSturdyRef("\twriterSR=", writerSR);
+          }
+        }
+
+        KJ_IF_MAYBE(req, infoReq) {
+          req->send().wait(waitScope);
+        }
+
+        allChannelData.add(kj::heap<ChannelData>(i, kj::mv(channelClient), channel));
+        channels.add(*allChannelData.back());
+      }
+
+      static double meanWaitInUs(const WaitTimeHistogram& h) {
+        return h.count > 0 ? static_cast<double>(h.totalInUs) / h.count : 0.0;
+      }
+
+      // log the stats of the still open channels every statsLogIntervalInS seconds
+      kj::Promise<void> logStats(ChannelList& channels, kj::Timer& timer) {
+        return timer.afterDelay(statsLogIntervalInS * kj::SECONDS).then([this, &channels, &timer]() {
+          for (auto& cd : channels) {
+            auto s = cd.channel->stats();
+            KJ_LOG(INFO, "channel stats", cd.index, s.totalNoOfIpsReceived, s.totalNoOfIpsSent,
+                   s.ipsReceivedPerSecond, s.ipsSentPerSecond, s.noOfIpsInQueue, s.noOfWaitingReaders,
+                   s.noOfWaitingWriters, meanWaitInUs(s.readerWaitTimes), meanWaitInUs(s.writerWaitTimes));
+          }
+          return logStats(channels, timer);
+        });
+      }
+
+      // send the stats of the channels until all of them have been closed or stop is fulfilled
+      void runChannels(ChannelList& channels, kj::Timer& timer, kj::WaitScope& waitScope, kj::Promise<void> stop) {
+        if (statsLogIntervalInS > 0) stop = stop.exclusiveJoin(logStats(channels, timer));
+        auto statsProms = kj::heapArrayBuilder<kj::Promise<void>>(channels.size());
+        auto closeProms = kj::heapArrayBuilder<kj::Promise<void>>(channels.size());
+        for (auto& cd : channels) {
+          statsProms.add(cd.channel->sendStats());
+          closeProms.add(cd.channel->closeChannel().then([&channels, &cd]() {
+            KJ_LOG(INFO, "removing channel");
+            channels.remove(cd);
+          }));
+        }
+        kj::joinPromises(statsProms.finish()).
+          exclusiveJoin(kj::joinPromises(closeProms.finish())).
+          exclusiveJoin(kj::mv(stop)).
+          wait(waitScope);
+      }
+
+      // host the channels i with i % noOfThreads == shard on an own event loop, restorer and port
+      void runShard(uint32_t shard, kj::StringPtr shardHost, kj::MutexGuarded<ShardControl>& control) {
+        auto io = kj::setupAsyncIo();
+        auto stop = kj::newPromiseAndFulfiller<void>();
+        {
+          auto lock = control.lockExclusive();
+          if (lock->stopRequested) return;
+          lock->executor = kj::getCurrentThreadExecutor().addRef();
+          lock->stop = stop.fulfiller.get();
+        }
+        KJ_DEFER({
+          auto lock = control.lockExclusive();
+          lock->executor = nullptr;
+          lock->stop = nullptr;
+        });
+        auto ownedRestorer = kj::heap<Restorer>();
+        auto shardRestorer = ownedRestorer.get();
+        mas::schema::persistence::Restorer::Client shardRestorerClient = kj::mv(ownedRestorer);
+        ConnectionManager shardConMan(io, shardRestorer);
+        shardRestorer->setHost(shardHost);
+        shardConMan.setLocallyUsedHost(shardHost);
+
+        // consecutive ports if a fixed port is set
+        auto boundPort =
+          shardConMan.bind(shardRestorerClient, host, port > 0 ? port + shard : 0).wait(io.waitScope);
+        shardRestorer->setPort(srPort < 0 ? boundPort : srPort == 0 ? 0 : srPort + shard).wait(io.waitScope);
+        KJ_LOG(INFO, "Bound restorer of shard to", shard, host, boundPort);
+        outputSturdyRef(kj::str("restorerSR(", shard, ")="), shardRestorer->sturdyRefStr(""));
+
+        kj::Maybe<mas::schema::fbp::Channel<P>::ChanWriter::Client> infoWriterClient;
+        if (startupInfoWriterSR.size() > 0) {
+          infoWriterClient =
+            shardConMan.tryConnectB(startupInfoWriterSR).castAs<mas::schema::fbp::Channel<P>::ChanWriter>();
+        }
+
+        ChannelList shardChannels;
+        kj::Vector<kj::Own<ChannelData>> shardChannelData;
+        for (uint64_t i = shard; i < noOfChannels; i += noOfThreads) {
+          setupChannel(i, *shardRestorer, io.provider->getTimer(), io.waitScope, infoWriterClient,
+                       shardChannels, shardChannelData);
+        }
+        runChannels(shardChannels, io.provider->getTimer(), io.waitScope, kj::mv(stop.promise));
+        KJ_LOG(INFO, "stopped shard", shard);
+      }
+
+      uint64_t bufferSize{1};
+      uint64_t arenaWordsPerMsg{0};
+      kj::String spillDir;
+      uint64_t maxMsgsInMemory{1000};
+      bool replaySpilled{false};
+      uint32_t statsMinIntervalInMs{100};
+      uint32_t statsLogIntervalInS{0};
+      uint64_t statsChangeThreshold{0};
+      uint64_t exitTimeout{3};
+      uint64_t noOfChannels{1};
+      uint8_t noOfReadersPerChannel{1};
+      uint8_t noOfWritersPerChannel{1};
+      uint32_t noOfThreads{1};
+      std::mutex outputMutex;
+
+      ChannelList channels;
       kj::Vector<kj::Own<ChannelData>> allChannelData;
       kj::Vector<kj::Vector<kj::String>> readerSrts;
       kj::Vector<kj::Vector<kj::String>> writerSrts;
@@ -0,0 +1,281 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include "channel-spill-log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <kj/debug.h>
+#include <kj/exception.h>
+
+#include <capnp/message.h>
+
+using namespace std;
+using namespace mas::infrastructure::common;
+
+namespace {
+const kj::StringPtr readPositionFileName = "read-position";
+const uint64_t minReadChunkInWords = 8192;
+const uint64_t appendBufferInWords = 8192;
+
+kj::Path segmentPath(uint64_t seg) { return kj::Path(kj::str(seg, ".seg")); }
+
+kj::Path evalPath(const kj::Filesystem& fs, kj::StringPtr dir) {
+#ifdef _WIN32
+  return fs.getCurrentPath().evalWin32(dir);
+#else
+  return fs.getCurrentPath().eval(dir);
+#endif
+}
+
+uint64_t wordToUInt64(const capnp::word& w) {
+  uint64_t v;
+  memcpy(&v, &w, sizeof(v));
+  return v;
+}
+}
+
+ChannelSpillLog::ChannelSpillLog(kj::StringPtr dir, bool replayUnread, uint64_t maxSegmentSizeInBytes,
+                                 uint32_t syncReadPositionEvery)
+: _fs(kj::newDiskFilesystem())
+, _path(evalPath(*_fs, dir))
+, _maxSegmentSizeInWords(std::max(static_cast<uint64_t>(1), maxSegmentSizeInBytes / sizeof(capnp::word)))
+, _syncReadPositionEvery(std::max(1u, syncReadPositionEvery)) {
+  _dir = _fs->getRoot().openSubdir(_path, kj::WriteMode::CREATE | kj::WriteMode::MODIFY
+                                          | kj::WriteMode::CREATE_PARENT);
+
+  // the segments of a previous run
+  kj::Vector<uint64_t> segs;
+  for (auto& name : _dir->listNames()) {
+    if (name.endsWith(".seg")) segs.add(strtoull(name.cStr(), nullptr, 10));
+  }
+  std::sort(segs.begin(), segs.end());
+  if (segs.empty()) {
+    _dir->tryRemove(kj::Path(readPositionFileName));
+    return;
+  }
+
+  _readSeg = segs.front();
+  _writeSeg = segs.back();
+  if (replayUnread) {
+    KJ_IF_MAYBE(file, _dir->tryOpenFile(kj::Path(readPositionFileName))) {
+      unsigned long long seg = 0, offset = 0;
+      if (sscanf((*file)->readAllText().cStr(), "%llu %llu", &seg, &offset) == 2 && seg >= _readSeg) {
+        _readSeg = seg;
+        _readOffset = offset;
+      }
+    }
+  }
+  if (!replayUnread || _readSeg > _writeSeg) {
+    for (auto seg : segs) _dir->tryRemove(segmentPath(seg));
+    _readSeg = _writeSeg;
+    reset();
+    return;
+  }
+  for (auto seg : segs) {
+    if (seg < _readSeg) _dir->tryRemove(segmentPath(seg));
+  }
+
+  // count the unread records, a partially written last record is dropped
+  for (auto seg = _readSeg; seg <= _writeSeg; ++seg) {
+    KJ_IF_MAYBE(file, _dir->tryOpenFile(segmentPath(seg))) {
+      auto size = (*file)->stat().size / sizeof(capnp::word);
+      auto offset = seg == _readSeg ? _readOffset : 0;
+      while (offset < size) {
+        capnp::word header;
+        if ((*file)->read(offset * sizeof(capnp::word), kj::arrayPtr(&header, 1).asBytes()) < sizeof(header)) break;
+        auto noOfWords = wordToUInt64(header);
+        if (offset + 1 + noOfWords > size) break;
+        offset += 1 + noOfWords;
+        _noOfRecords++;
+      }
+      if (seg == _writeSeg) _writeOffset = offset;
+    }
+  }
+  if (_noOfRecords == 0) {
+    reset();
+    return;
+  }
+
+  _writeFile = _dir->openFile(segmentPath(_writeSeg), kj::WriteMode::MODIFY);
+  _writeFile->truncate(_writeOffset * sizeof(capnp::word));
+  openReadSegment();
+  skipReadSegments();
+}
+
+ChannelSpillLog::~ChannelSpillLog() noexcept(false) {
+  KJ_IF_MAYBE(e, kj::runCatchingExceptions([this]() {
+    if (_noOfRecords > 0) {
+      sync();
+      return;
+    }
+    // nothing left to replay
+    _readFile = nullptr;
+    _writeFile = nullptr;
+    _dir = nullptr;
+    _fs->getRoot().tryRemove(_path);
+  })) {
+    KJ_LOG(ERROR, "ChannelSpillLog: couldn't sync log on destruction", *e);
+  }
+}
+
+void ChannelSpillLog::append(Msg::Reader msg) {
+  auto size = msg.totalSize();
+  KJ_REQUIRE(size.capCount == 0, "ChannelSpillLog: messages with capabilities can't be spilled");
+
+  // one word for the root pointer, like capnp::clone
+  uint64_t noOfWords = size.wordCount + 1;
+  if (_writeOffset > 0 && _writeOffset + 1 + noOfWords > _maxSegmentSizeInWords) {
+    // start a new segment, the old one is from now on only read
+    flush();
+    if (_readSeg == _writeSeg && _noOfRecords == 0) {
+      // everything has been read, the segment isn't needed anymore
+      _writeFile = nullptr;
+      _dir->tryRemove(segmentPath(_writeSeg));
+      _readSeg = _writeSeg + 1;
+      _readOffset = 0;
+      _readChunkSize = 0;
+    } else if (_readSeg == _writeSeg) {
+      _readFile = kj::mv(_writeFile);
+      _readSegSize = _writeOffset;
+    }
+    _writeFile = nullptr;
+    _writeSeg++;
+    _writeOffset = 0;
+  }
+  if (_writeFile.get() == nullptr) {
+    _writeFile = _dir->openFile(segmentPath(_writeSeg), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  }
+
+  auto start = _appendBuffer.size();
+  _appendBuffer.resize(start + 1 + noOfWords);
+  auto record = _appendBuffer.asPtr().slice(start, start + 1 + noOfWords);
+  memset(record.begin(), 0, record.size() * sizeof(capnp::word));
+  memcpy(record.begin(), &noOfWords, sizeof(noOfWords));
+  capnp::copyToUnchecked(msg, record.slice(1, record.size()));
+  _writeOffset += 1 + noOfWords;
+  _noOfRecords++;
+
+  if (_appendBuffer.size() >= appendBufferInWords) flush();
+}
+
+ChannelSpillLog::Msg::Reader ChannelSpillLog::oldest() {
+  KJ_REQUIRE(_noOfRecords > 0, "ChannelSpillLog::oldest: log is empty");
+  auto noOfWords = recordSizeAt(_readOffset);
+  return capnp::readMessageUnchecked<Msg>(readWords(_readOffset, 1 + noOfWords).begin() + 1);
+}
+
+void ChannelSpillLog::pop() {
+  KJ_REQUIRE(_noOfRecords > 0, "ChannelSpillLog::pop: log is empty");
+  _readOffset += 1 + recordSizeAt(_readOffset);
+  _noOfRecords--;
+
+  auto seg = _readSeg;
+  skipReadSegments();
+  if (_noOfRecords == 0) {
+    // everything has been read, so the appends not yet written don't have to be written at all,
+    // the segment itself is kept and written on
+    _writeOffset -= _appendBuffer.size();
+    _appendBuffer.clear();
+    _readOffset = _writeOffset;
+  }
+  if (seg != _readSeg || ++_readsSinceSync >= _syncReadPositionEvery) syncReadPosition();
+}
+
+void ChannelSpillLog::sync() {
+  flush();
+  syncReadPosition();
+}
+
+void ChannelSpillLog::flush() {
+  if (_appendBuffer.empty()) return;
+  auto start = _writeOffset - _appendBuffer.size();
+  _writeFile->write(start * sizeof(capnp::word), _appendBuffer.asPtr().asBytes());
+  _appendBuffer.clear();
+}
+
+void ChannelSpillLog::syncReadPosition() {
+  flush();
+  _readsSinceSync = 0;
+  if (_readSeg == _syncedReadSeg && _readOffset == _syncedReadOffset) return;
+  auto replacer = _dir->replaceFile(kj::Path(readPositionFileName), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  replacer->get().writeAll(kj::str(_readSeg, " ", _readOffset, "\n"));
+  replacer->commit();
+  _syncedReadSeg = _readSeg;
+  _syncedReadOffset = _readOffset;
+}
+
+uint64_t ChannelSpillLog::recordSizeAt(uint64_t offset) {
+  return wordToUInt64(readWords(offset, 1)[0]);
+}
+
+kj::ArrayPtr<const capnp::word> ChannelSpillLog::readWords(uint64_t offset, uint64_t noOfWords) {
+  // records are appended and flushed as a whole, so a record is either written or still in the append buffer
+  auto unflushedStart = _writeOffset - _appendBuffer.size();
+  if (_readSeg == _writeSeg && offset >= unflushedStart) {
+    auto start = offset - unflushedStart;
+    return _appendBuffer.asPtr().slice(start, start + noOfWords);
+  }
+  ensureInReadChunk(offset, noOfWords);
+  auto start = offset - _readChunkOffset;
+  return _readChunk.slice(start, start + noOfWords);
+}
+
+void ChannelSpillLog::ensureInReadChunk(uint64_t offset, uint64_t noOfWords) {
+  if (offset >= _readChunkOffset && offset + noOfWords <= _readChunkOffset + _readChunkSize) return;
+
+  if (_readChunk.size() < noOfWords) {
+    _readChunk = kj::heapArray<capnp::word>(std::max(noOfWords, minReadChunkInWords));
+  }
+  auto bytes = readFile().read(offset * sizeof(capnp::word), _readChunk.asBytes());
+  _readChunkOffset = offset;
+  _readChunkSize = bytes / sizeof(capnp::word);
+  KJ_REQUIRE(_readChunkSize >= noOfWords, "ChannelSpillLog: segment ends within a record", _readSeg, offset);
+}
+
+void ChannelSpillLog::openReadSegment() {
+  _readChunkSize = 0;
+  if (_readSeg < _writeSeg) {
+    _readFile = _dir->openFile(segmentPath(_readSeg));
+    _readSegSize = _readFile->stat().size / sizeof(capnp::word);
+  } else {
+    _readFile = nullptr;
+  }
+}
+
+void ChannelSpillLog::skipReadSegments() {
+  while (_readSeg < _writeSeg && _readOffset >= _readSegSize) {
+    _readFile = nullptr;
+    _dir->tryRemove(segmentPath(_readSeg));
+    _readSeg++;
+    _readOffset = 0;
+    openReadSegment();
+  }
+}
+
+void ChannelSpillLog::reset() {
+  // nothing to replay, start over with an empty segment
+  _readFile = nullptr;
+  _writeFile = nullptr;
+  _appendBuffer.clear();
+  for (auto seg = _readSeg; seg <= _writeSeg; ++seg) _dir->tryRemove(segmentPath(seg));
+  _readSeg = _writeSeg = _writeSeg + 1;
+  _readOffset = _writeOffset = _readSegSize = 0;
+  _readChunkSize = 0;
+  syncReadPosition();
+}
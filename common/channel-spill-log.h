@@ -0,0 +1,103 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <kj/array.h>
+#include <kj/filesystem.h>
+#include <kj/memory.h>
+#include <kj/string.h>
+#include <kj/vector.h>
+
+#include <capnp/common.h>
+
+#include "fbp.capnp.h"
+
+namespace mas::infrastructure::common {
+
+// Append-only log of the messages a channel buffer spills to disk.
+// The log consists of numbered segment files <dir>/<n>.seg, each a sequence of records
+// [number of words][message words, like capnp::clone]. Only messages without capabilities can be spilled.
+// The disk I/O is synchronous, so it is batched: appends are written in blocks of 64 KiB, messages read
+// before they were written are never written at all and segment files are only created and removed once
+// per maxSegmentSizeInBytes. Draining the log keeps the current segment, it is removed once it is full
+// and has been read completely.
+// The position of the next unread record is stored in <dir>/read-position (if it changed) every
+// syncReadPositionEvery reads, whenever a segment has been read completely and when the log is destroyed.
+// Opening the log with replayUnread = true continues after that position, so unread messages survive a restart.
+// After a crash up to syncReadPositionEvery messages may be read again and appends not yet flushed are lost.
+// An empty log removes dir when it is destroyed.
+class ChannelSpillLog {
+public:
+  typedef typename mas::schema::fbp::Channel<capnp::AnyPointer>::Msg Msg;
+
+  ChannelSpillLog(kj::StringPtr dir, bool replayUnread, uint64_t maxSegmentSizeInBytes = 64 << 20,
+                  uint32_t syncReadPositionEvery = 1000);
+
+  ~ChannelSpillLog() noexcept(false);
+
+  uint64_t size() const { return _noOfRecords; }
+  bool empty() const { return _noOfRecords == 0; }
+
+  void append(Msg::Reader msg);
+
+  // the oldest message, only valid until the next append or pop
+  Msg::Reader oldest();
+
+  void pop();
+
+  // write the buffered appends and the read position
+  void sync();
+
+private:
+  void flush();
+  void syncReadPosition();
+  kj::ArrayPtr<const capnp::word> readWords(uint64_t offset, uint64_t noOfWords);
+  void ensureInReadChunk(uint64_t offset, uint64_t noOfWords);
+  uint64_t recordSizeAt(uint64_t offset);
+  void openReadSegment();
+  void skipReadSegments();
+  void reset();
+
+  const kj::ReadableFile& readFile() const { return _readSeg == _writeSeg ? *_writeFile : *_readFile; }
+
+  kj::Own<kj::Filesystem> _fs;
+  kj::Path _path;
+  kj::Own<const kj::Directory> _dir;
+  uint64_t _maxSegmentSizeInWords;
+  uint32_t _syncReadPositionEvery;
+  uint32_t _readsSinceSync{0};
+  uint64_t _syncedReadSeg{UINT64_MAX}; // the read position last stored
+  uint64_t _syncedReadOffset{UINT64_MAX};
+  uint64_t _noOfRecords{0};
+
+  // all offsets and sizes are in words
+  uint64_t _writeSeg{0};
+  uint64_t _writeOffset{0}; // end of the write segment including the append buffer
+  kj::Own<const kj::File> _writeFile;
+  kj::Vector<capnp::word> _appendBuffer; // not yet written end of the write segment
+
+  uint64_t _readSeg{0};
+  uint64_t _readOffset{0};
+  uint64_t _readSegSize{0}; // only valid if _readSeg < _writeSeg
+  kj::Own<const kj::ReadableFile> _readFile; // only used if _readSeg < _writeSeg
+  kj::Array<capnp::word> _readChunk;
+  uint64_t _readChunkOffset{0};
+  uint64_t _readChunkSize{0};
+};
+
+} // namespace mas::infrastructure::common
@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+// stress the queue of blocked readers of a channel
+// - park thousands of reads on an empty channel, cancel every other one
+// - check the number of waiting readers after parking and cancelling
+// - write one message per remaining read and check they are woken up in FIFO order
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/vector.h>
+
+#include <capnp/message.h>
+
+#include "channel.h"
+
+using namespace std;
+using namespace mas::infrastructure::common;
+
+namespace {
+struct Params {
+  size_t readers{10000};
+  int repetitions{3};
+};
+
+double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+bool check(bool ok, kj::StringPtr what) {
+  if (!ok) cerr << "error: " << what.cStr() << endl;
+  return ok;
+}
+
+bool run(Channel& channel, kj::ArrayPtr<Reader*> readers, kj::WaitScope& waitScope) {
+  const size_t n = readers.size();
+  bool ok = true;
+
+  auto start = chrono::steady_clock::now();
+  kj::Vector<kj::Maybe<kj::Promise<void>>> reads;
+  kj::Vector<kj::String> received;
+  for (size_t i = 0; i < n; i++) received.add(kj::str(""));
+  for (size_t i = 0; i < n; i++) {
+    reads.add(readers[i]->readMany(1).then([&received, i](Reader::Msgs&& res) {
+      if (res.msgs.size() == 1) received[i] = kj::str(res.msgs[0]->getValue().getAs<capnp::Text>());
+    }));
+  }
+  auto parkMs = msSince(start);
+  ok &= check(channel.stats().noOfWaitingReaders == n, "not all reads are waiting");
+
+  // cancelling unlinks the reads from the middle of the queue
+  start = chrono::steady_clock::now();
+  for (size_t i = 1; i < n; i += 2) reads[i] = nullptr;
+  auto cancelMs = msSince(start);
+  const size_t remaining = (n + 1) / 2;
+  ok &= check(channel.stats().noOfWaitingReaders == remaining, "cancelled reads are still waiting");
+
+  // message k has to wake up the k-th remaining read
+  kj::Vector<kj::Own<capnp::MallocMessageBuilder>> builders;
+  kj::Vector<AnyPointerMsg::Reader> toWrite;
+  for (size_t k = 0; k < remaining; k++) {
+    auto b = kj::heap<capnp::MallocMessageBuilder>();
+    auto text = kj::str(k);
+    b->initRoot<AnyPointerMsg>().getValue().setAs<capnp::Text>(text.cStr());
+    toWrite.add(b->getRoot<AnyPointerMsg>().asReader());
+    builders.add(kj::mv(b));
+  }
+
+  start = chrono::steady_clock::now();
+  KJ_IF_MAYBE(writer, Channel::localWriter(channel.getClient().writerRequest().send().wait(waitScope).getW())
+                        .wait(waitScope)) {
+    writer->writeMany(toWrite.asPtr()).wait(waitScope);
+  } else {
+    return check(false, "the writer isn't local");
+  }
+  for (auto& read : reads) {
+    KJ_IF_MAYBE(r, read) kj::mv(*r).wait(waitScope);
+  }
+  auto wakeUpMs = msSince(start);
+
+  for (size_t i = 0; i < n; i += 2) {
+    if (kj::StringPtr(received[i]) != kj::str(i / 2)) {
+      ok &= check(false, kj::str("read ", i, " got message '", received[i], "' instead of '", i / 2, "'"));
+      break;
+    }
+  }
+  ok &= check(channel.stats().noOfWaitingReaders == 0, "reads are still waiting");
+
+  cout << "parked " << n << " reads in " << parkMs << " ms, cancelled " << n - remaining << " in " << cancelMs
+       << " ms, woke up " << remaining << " in " << wakeUpMs << " ms" << endl;
+  return ok;
+}
+
+void printUsage(const char* name) {
+  cout << "usage: " << name << " [options]" << endl
+       << " -readers n ... parked readers (10000)" << endl
+       << " -repetitions n ... how often the test is repeated (3)" << endl;
+}
+}
+
+int main(int argc, char** argv) {
+  Params ps;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-readers" && hasValue) ps.readers = std::stoul(argv[++i]);
+    else if (arg == "-repetitions" && hasValue) ps.repetitions = atoi(argv[++i]);
+    else {
+      printUsage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  auto io = kj::setupAsyncIo();
+  auto& waitScope = io.waitScope;
+
+  // the buffer is never used, every message goes directly to a waiting reader
+  auto ownedChannel = kj::heap<Channel>("stress", "", 1, io.provider->getTimer());
+  auto channel = ownedChannel.get();
+  AnyPointerChannel::Client channelClient = kj::mv(ownedChannel);
+  channel->setClient(channelClient);
+
+  kj::Vector<AnyPointerChannel::ChanReader::Client> readerClients;
+  kj::Vector<Reader*> readers;
+  for (size_t i = 0; i < ps.readers; i++) {
+    auto client = channelClient.readerRequest().send().wait(waitScope).getR();
+    KJ_IF_MAYBE(r, Channel::localReader(client).wait(waitScope)) {
+      readers.add(r);
+    } else {
+      cerr << "error: the reader isn't local" << endl;
+      return 1;
+    }
+    readerClients.add(kj::mv(client));
+  }
+
+  bool ok = true;
+  for (int r = 0; r < ps.repetitions; r++) ok &= run(*channel, readers.asPtr(), waitScope);
+  cout << (ok ? "ok" : "failed") << endl;
+  return ok ? 0 : 1;
+}
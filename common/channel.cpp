@@ -15,7 +15,6 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 
 #include "channel.h"
 
-#include <deque>
 #include <tuple>
 #include <chrono>
 #include <ctime>
@@ -27,6 +26,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <kj/common.h>
 #include <kj/debug.h>
 #include <kj/exception.h>
+#include <kj/list.h>
 
 #include <capnp/capability.h>
 #include <capnp/dynamic.h>
@@ -38,7 +38,71 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 using namespace std;
 using namespace mas::infrastructure::common;
 
-struct Channel::Impl {
+namespace {
+// the readers and writers created on this thread, to find the server behind a local client again
+capnp::CapabilityServerSet<AnyPointerChannel::ChanReader>& localReaders() {
+  static thread_local capnp::CapabilityServerSet<AnyPointerChannel::ChanReader> readers;
+  return readers;
+}
+
+capnp::CapabilityServerSet<AnyPointerChannel::ChanWriter>& localWriters() {
+  static thread_local capnp::CapabilityServerSet<AnyPointerChannel::ChanWriter> writers;
+  return writers;
+}
+}
+
+namespace {
+// Queue of blocked readers or writers, the longest waiting first. The entries are owned by the promises
+// of the blocked calls and linked intrusively, so a canceled call unlinks its entry in O(1).
+template<typename T>
+class BlockedQueue {
+public:
+  struct Entry {
+    Entry(BlockedQueue& queue, kj::Own<kj::PromiseFulfiller<T>> fulfiller)
+    : queue(queue), fulfiller(kj::mv(fulfiller)) {}
+    KJ_DISALLOW_COPY(Entry);
+
+    // only still linked, if the blocked call has been canceled
+    ~Entry() noexcept(false) {
+      if (link.isLinked()) queue.list.remove(*this);
+    }
+
+    BlockedQueue& queue;
+    kj::Own<kj::PromiseFulfiller<T>> fulfiller;
+    kj::ListLink<Entry> link;
+  };
+
+  BlockedQueue() = default;
+  KJ_DISALLOW_COPY(BlockedQueue);
+
+  // promises still waiting must not touch the queue anymore
+  ~BlockedQueue() noexcept(false) {
+    while (!list.empty()) list.remove(list.front());
+  }
+
+  size_t size() const { return list.size(); }
+  bool empty() const { return list.empty(); }
+
+  kj::Promise<T> add() {
+    auto paf = kj::newPromiseAndFulfiller<T>();
+    auto entry = kj::heap<Entry>(*this, kj::mv(paf.fulfiller));
+    list.add(*entry);
+    return paf.promise.attach(kj::mv(entry));
+  }
+
+  // unlink the longest waiting entry and return its fulfiller
+  kj::PromiseFulfiller<T>& takeOldest() {
+    auto& entry = list.front();
+    list.remove(entry);
+    return *entry.fulfiller;
+  }
+
+private:
+  kj::List<Entry, &Entry::link> list;
+};
+}
+
+struct Channel::Impl : public kj::TaskSet::ErrorHandler {
   Channel& self;
   mas::infrastructure::common::Restorer* restorer{nullptr};
   kj::Timer& timer;
@@ -47,10 +111,10 @@ struct Channel::Impl {
   kj::String description;
   kj::HashMap<kj::String, AnyPointerChannel::ChanReader::Client> readers;
   kj::HashMap<kj::String, AnyPointerChannel::ChanWriter::Client> writers;
-  std::deque<kj::Own<kj::PromiseFulfiller<kj::Maybe<AnyPointerMsg::Reader>>>> blockingReadFulfillers;
-  std::deque<kj::Own<kj::PromiseFulfiller<void>>> blockingWriteFulfillers;
+  BlockedQueue<kj::Maybe<AnyPointerMsg::Reader>> blockingReadFulfillers;
+  BlockedQueue<void> blockingWriteFulfillers;
   uint64_t bufferSize{1};
-  std::deque<kj::Own<kj::Decay<AnyPointerMsg::Reader>>> buffer;
+  ChannelBuffer buffer;
   AnyPointerChannel::CloseSemantics autoCloseSemantics{AnyPointerChannel::CloseSemantics::FBP};
   bool sendCloseOnEmptyBuffer{false};
   AnyPointerChannel::Client client{nullptr};
@@ -202,9 +266,61 @@ struct Channel::Impl {
     stats.setNoOfIpsInQueue(buffer.size());
     stats.setTotalNoOfIpsReceived(totalNoOfIpsReceived);
     stats.setUpdateIntervalInMs(updateIntervalInMs);
-    const auto now = std::chrono::system_clock::now();
-    auto time = formatLocalTimeWithMillis(now);
-    stats.setTimestamp(time);
+    stats.setTimestamp(timestamp());
+  }
+
+  // the timestamp has a resolution of seconds, so format it only once per second
+  kj::StringPtr timestamp() {
+    auto tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (tt != timestampTime) {
+      timestampString = kj::str(formatLocalTimeWithMillis(std::chrono::system_clock::from_time_t(tt)));
+      timestampTime = tt;
+    }
+    return timestampString;
+  }
+
+  // Called on every change of the channel state. Instead of sending stats to the immediate stats callbacks
+  // per message, the changes are coalesced and sent at most every minStatsIntervalInMs or as soon as
+  // statsChangeThreshold changes accumulated. Only one send is in flight at a time.
+  void statsChanged() {
+    if (immediateStatsCBs.size() == 0) return;
+    changesSinceImmediateStats++;
+    scheduleImmediateStats();
+  }
+
+  void scheduleImmediateStats() {
+    // will be rescheduled when the current send finished
+    if (immediateStatsInFlight) return;
+
+    bool thresholdReached = statsChangeThreshold > 0 && changesSinceImmediateStats >= statsChangeThreshold;
+    if (immediateStatsScheduled && !thresholdReached) return;
+
+    auto due = thresholdReached ? timer.now() : lastImmediateStats + minStatsIntervalInMs * kj::MILLISECONDS;
+    immediateStatsScheduled = true;
+    scheduledImmediateStats = timer.atTime(due).then([this]() {
+      immediateStatsScheduled = false;
+      immediateStatsInFlight = true;
+      changesSinceImmediateStats = 0;
+      lastImmediateStats = timer.now();
+      tasks.add(sendImmediateStats().then([this]() {
+        immediateStatsInFlight = false;
+        if (changesSinceImmediateStats > 0) scheduleImmediateStats();
+      }));
+    }).eagerlyEvaluate(nullptr);
+  }
+
+  void taskFailed(kj::Exception&& exception) override {
+    immediateStatsInFlight = false;
+    KJ_LOG(ERROR, "Channel::Impl: sending stats failed", exception);
+  }
+
+  void recordWaitTime(WaitTimeHistogram& histogram, kj::TimePoint start) {
+    const auto us = static_cast<uint64_t>(std::max(static_cast<int64_t>(0), (timer.now() - start) / kj::MICROSECONDS));
+    size_t bucket = 0;
+    for (auto v = us; v > 1 && bucket + 1 < histogram.buckets.size(); v >>= 1) ++bucket;
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.totalInUs += us;
   }
 
   void unblockWaitingWriters(uint64_t slots) {
@@ -212,9 +328,7 @@ struct Channel::Impl {
 
     while (slots > 0 && !blockingWriteFulfillers.empty()) {
       KJ_LOG(INFO, "Channel::Impl: unblock waiting writer");
-      auto&& bwf = blockingWriteFulfillers.back();
-      bwf->fulfill();
-      blockingWriteFulfillers.pop_back();
+      blockingWriteFulfillers.takeOldest().fulfill();
       --slots;
     }
   }
@@ -225,6 +339,81 @@ struct Channel::Impl {
     unblockWaitingWriters(freeSlots);
   }
 
+  // hand the message to a waiting reader or store it, false if the buffer is full
+  bool tryWrite(AnyPointerMsg::Reader v) {
+    if (!blockingReadFulfillers.empty()) {
+      blockingReadFulfillers.takeOldest().fulfill(v);
+      totalNoOfIpsReceived++;
+      return true;
+    }
+    if (buffer.size() < bufferSize) {
+      buffer.push(v);
+      totalNoOfIpsReceived++;
+      return true;
+    }
+    return false;
+  }
+
+  // move up to n buffered messages (oldest first) to msgs
+  void takeFromBuffer(size_t n, kj::Vector<kj::Own<kj::Decay<AnyPointerMsg::Reader>>>& msgs) {
+    for (; n > 0 && !buffer.empty(); --n) msgs.add(buffer.take());
+    takenFromBuffer();
+  }
+
+  // after messages have been taken from the buffer, unblock the writers once for all freed slots
+  void takenFromBuffer() {
+    unblockWaitingWritersWithBufferSpace();
+    statsChanged();
+
+    // check if the channel is supposed to be closed and just waiting for an empty buffer
+    if (buffer.empty() && channelShouldBeClosedOnEmptyBuffer) {
+      channelCanBeClosed = true;
+      closeChannelFulfiller->fulfill();
+    }
+  }
+
+  void sendDoneToWaitingReaders() {
+    while (!blockingReadFulfillers.empty()) {
+      KJ_LOG(INFO, "Channel::Impl: close waiting reader");
+      blockingReadFulfillers.takeOldest().fulfill(nullptr);
+    }
+  }
+
+  // canceling the returned promise removes the reader from the queue
+  kj::Promise<kj::Maybe<AnyPointerMsg::Reader>> blockReader() {
+    auto start = timer.now();
+    return blockingReadFulfillers.add().then([this, start](kj::Maybe<AnyPointerMsg::Reader> msg) {
+      recordWaitTime(readerWaitTimes, start);
+      return msg;
+    });
+  }
+
+  // canceling the returned promise removes the writer from the queue
+  kj::Promise<void> blockWriter() {
+    auto start = timer.now();
+    return blockingWriteFulfillers.add().then([this, start]() {
+      recordWaitTime(writerWaitTimes, start);
+    });
+  }
+
+  WaitTimeHistogram readerWaitTimes;
+  WaitTimeHistogram writerWaitTimes;
+  kj::TimePoint lastThroughputTime;
+  uint64_t lastThroughputNoOfIpsReceived{0};
+  uint64_t lastThroughputNoOfIpsSent{0};
+
+  uint32_t minStatsIntervalInMs{100};
+  uint64_t statsChangeThreshold{0};
+  uint64_t changesSinceImmediateStats{0};
+  kj::TimePoint lastImmediateStats{kj::origin<kj::TimePoint>()};
+  bool immediateStatsScheduled{false};
+  bool immediateStatsInFlight{false};
+  std::time_t timestampTime{0};
+  kj::String timestampString;
+  // declared last, so pending stats are canceled before the state they use is destroyed
+  kj::TaskSet tasks;
+  kj::Promise<void> scheduledImmediateStats{nullptr};
+
   Impl(Channel& self, mas::infrastructure::common::Restorer* restorer, kj::StringPtr name,
        kj::StringPtr description,
        uint64_t bufferSize,
@@ -234,7 +423,10 @@ struct Channel::Impl {
   , id(kj::str(sole::uuid4().str()))
   , name(kj::str(name))
   , description(kj::str(description))
-  , bufferSize(std::max(static_cast<uint64_t>(1), bufferSize)) {
+  , bufferSize(std::max(static_cast<uint64_t>(1), bufferSize))
+  , buffer(bufferSize)
+  , lastThroughputTime(timer.now())
+  , tasks(*this) {
     setRestorer(restorer);
   }
 
@@ -253,7 +445,7 @@ struct Channel::Impl {
   AnyPointerChannel::ChanReader::Client createReader() {
     auto r = kj::heap<Reader>(self);
     auto id = r->id();
-    AnyPointerChannel::ChanReader::Client rc = kj::mv(r);
+    auto rc = localReaders().add(kj::mv(r));
     readers.insert(kj::str(id), rc);
     return rc;
   }
@@ -261,7 +453,7 @@ struct Channel::Impl {
   AnyPointerChannel::ChanWriter::Client createWriter() {
     auto w = kj::heap<Writer>(self);
     auto id = w->id();
-    AnyPointerChannel::ChanWriter::Client wc = kj::mv(w);
+    auto wc = localWriters().add(kj::mv(w));
     writers.insert(kj::str(id), wc);
     return wc;
   }
@@ -314,15 +506,13 @@ void Channel::closedWriter(kj::StringPtr writerId) {
 
     // as we just received a done message which should be distributed and would
     // fill the buffer, unblock all readers, so they send the done message
-    while (kj::size(impl->blockingReadFulfillers) > 0) {
-      auto& brf = impl->blockingReadFulfillers.back();
-      brf->fulfill(nullptr); // kj::Maybe<AnyPointerMsg::Reader>());
-      impl->blockingReadFulfillers.pop_back();
+    while (!impl->blockingReadFulfillers.empty()) {
+      impl->blockingReadFulfillers.takeOldest().fulfill(nullptr); // kj::Maybe<AnyPointerMsg::Reader>());
       KJ_LOG(INFO, "Channel::closedWriter: sent done to reader on last finished writer");
       // cout << "Channel::closedWriter: sent done to reader on last finished writer" << endl;
     }
-    KJ_LOG(INFO, kj::size(impl->blockingReadFulfillers));
-    KJ_LOG(INFO, kj::size(impl->blockingWriteFulfillers));
+    KJ_LOG(INFO, impl->blockingReadFulfillers.size());
+    KJ_LOG(INFO, impl->blockingWriteFulfillers.size());
   }
 }
 
@@ -331,12 +521,27 @@ kj::Promise<void> Channel::setBufferSize(SetBufferSizeContext context) {
   const auto oldBufferSize = impl->bufferSize;
   const auto newBufferSize = std::max(static_cast<uint64_t>(1), context.getParams().getSize());
   impl->bufferSize = newBufferSize;
+  impl->buffer.setBufferSize(newBufferSize);
   if (newBufferSize > oldBufferSize) {
     impl->unblockWaitingWriters(newBufferSize - oldBufferSize);
   }
   return kj::READY_NOW;
 }
 
+void Channel::setArenaWordsPerMsg(uint64_t wordsPerMsg) { impl->buffer.setArenaWordsPerMsg(wordsPerMsg); }
+
+void Channel::spillToDisk(kj::StringPtr dir, uint64_t maxNoOfMsgsInMemory, bool replayUnread) {
+  impl->buffer.setSpillLog(kj::heap<ChannelSpillLog>(dir, replayUnread), maxNoOfMsgsInMemory);
+  // replayed messages count as received
+  impl->totalNoOfIpsReceived += impl->buffer.noOfSpilledMsgs();
+  KJ_LOG(INFO, "Channel::spillToDisk: spilling to", dir, "messages from a previous run:",
+         impl->buffer.noOfSpilledMsgs());
+  if (impl->bufferSize <= maxNoOfMsgsInMemory) {
+    KJ_LOG(WARNING, "Channel::spillToDisk: buffer size <= max messages in memory, nothing will be spilled",
+           impl->bufferSize, maxNoOfMsgsInMemory);
+  }
+}
+
 kj::Promise<void> Channel::reader(ReaderContext context) {
   KJ_LOG(INFO, "Channel::reader: message received");
   context.getResults().setR(impl->createReader());
@@ -392,6 +597,51 @@ kj::Promise<void> Channel::registerStatsCallback(RegisterStatsCallbackContext co
 
 kj::Promise<void> Channel::sendStats() { return impl->sendStats(); }
 
+void Channel::setStatsRateLimit(uint32_t minIntervalInMs, uint64_t changeThreshold) {
+  impl->minStatsIntervalInMs = minIntervalInMs;
+  impl->statsChangeThreshold = changeThreshold;
+}
+
+ChannelStats Channel::stats() {
+  ChannelStats s;
+  s.totalNoOfIpsReceived = impl->totalNoOfIpsReceived;
+  // every received message has either been handed to a reader or is still buffered
+  s.noOfIpsInQueue = impl->buffer.size();
+  s.totalNoOfIpsSent = s.totalNoOfIpsReceived > s.noOfIpsInQueue ? s.totalNoOfIpsReceived - s.noOfIpsInQueue : 0;
+  s.noOfWaitingReaders = impl->blockingReadFulfillers.size();
+  s.noOfWaitingWriters = impl->blockingWriteFulfillers.size();
+
+  auto now = impl->timer.now();
+  auto seconds = static_cast<double>((now - impl->lastThroughputTime) / kj::MICROSECONDS) / 1000000.0;
+  if (seconds > 0) {
+    s.ipsReceivedPerSecond = (s.totalNoOfIpsReceived - impl->lastThroughputNoOfIpsReceived) / seconds;
+    s.ipsSentPerSecond = (s.totalNoOfIpsSent - impl->lastThroughputNoOfIpsSent) / seconds;
+  }
+  impl->lastThroughputTime = now;
+  impl->lastThroughputNoOfIpsReceived = s.totalNoOfIpsReceived;
+  impl->lastThroughputNoOfIpsSent = s.totalNoOfIpsSent;
+
+  s.readerWaitTimes = impl->readerWaitTimes;
+  s.writerWaitTimes = impl->writerWaitTimes;
+  return s;
+}
+
+kj::Promise<kj::Maybe<Reader&>> Channel::localReader(AnyPointerChannel::ChanReader::Client client) {
+  auto server = localReaders().getLocalServer(client);
+  return server.then([](kj::Maybe<AnyPointerChannel::ChanReader::Server&> s) -> kj::Maybe<Reader&> {
+    KJ_IF_MAYBE(r, s) return kj::downcast<Reader>(*r);
+    return nullptr;
+  }).attach(kj::mv(client));
+}
+
+kj::Promise<kj::Maybe<Writer&>> Channel::localWriter(AnyPointerChannel::ChanWriter::Client client) {
+  auto server = localWriters().getLocalServer(client);
+  return server.then([](kj::Maybe<AnyPointerChannel::ChanWriter::Server&> s) -> kj::Maybe<Writer&> {
+    KJ_IF_MAYBE(w, s) return kj::downcast<Writer>(*w);
+    return nullptr;
+  }).attach(kj::mv(client));
+}
+
 AnyPointerChannel::Client Channel::getClient() { return impl->client; }
 
 void Channel::setClient(AnyPointerChannel::Client c) { impl->client = c; }
@@ -437,18 +687,11 @@ kj::Promise<void> Reader::read(ReadContext context) {
   // the buffer is not empty, send next value
   if (!b.empty()) {
     KJ_LOG(INFO, "Reader::read: buffer not empty, send next value");
-    auto&& v = b.back();
-    KJ_ASSERT(v.get()->isValue(), "Msg contains a value, because before buffering we checked for done.");
-    context.getResults().setValue(v.get()->getValue());
-    b.pop_back();
-
-    c.impl->unblockWaitingWritersWithBufferSpace();
-
-    // check if the channel is supposed to be closed and just waiting for an empty buffer
-    if (b.empty() && c.impl->channelShouldBeClosedOnEmptyBuffer) {
-      c.impl->channelCanBeClosed = true;
-      c.impl->closeChannelFulfiller->fulfill();
-    }
+    auto v = b.oldest();
+    KJ_ASSERT(v.isValue(), "Msg contains a value, because before buffering we checked for done.");
+    context.getResults().setValue(v.getValue());
+    b.pop();
+    c.impl->takenFromBuffer();
 
     return kj::READY_NOW;
   }
@@ -465,34 +708,13 @@ kj::Promise<void> Reader::read(ReadContext context) {
     c.closedReader(id());
 
     // if there are other readers waiting close them as well
-    while (!c.impl->blockingReadFulfillers.empty()) {
-      KJ_LOG(INFO, "Reader::read: close other waiting readers");
-      auto&& brf = c.impl->blockingReadFulfillers.back();
-      brf->fulfill(nullptr);
-      c.impl->blockingReadFulfillers.pop_back();
-    }
+    c.impl->sendDoneToWaitingReaders();
 
     return kj::READY_NOW;
   }
 
   KJ_LOG(INFO, "Reader::read: block, because no value to read");
-  auto paf = kj::newPromiseAndFulfiller<kj::Maybe<AnyPointerMsg::Reader>>();
-  auto* fulfillerPtr = paf.fulfiller.get();
-  c.impl->blockingReadFulfillers.push_front(kj::mv(paf.fulfiller));
-
-  // This guard runs its lambda when it is destroyed (i.e. when the promise is canceled).
-  auto cancelGuard = kj::defer([this, fulfillerPtr]() {
-    auto& q = _channel.impl->blockingReadFulfillers;
-    for (auto it = q.begin(); it != q.end(); ++it) {
-      if (it->get() == fulfillerPtr) {
-        q.erase(it);
-        KJ_LOG(INFO, "Reader::read: canceled, fulfiller removed from queue");
-        break;
-      }
-    }
-  });
-
-  return kj::mv(paf.promise)
+  return c.impl->blockReader()
          .then([context, this](kj::Maybe<AnyPointerMsg::Reader> msg) mutable {
            KJ_REQUIRE(!_closed, "Reader already closed.", _closed);
 
@@ -506,8 +728,7 @@ kj::Promise<void> Reader::read(ReadContext context) {
                KJ_LOG(INFO, "Reader::read: promise_lambda: sending value to reader");
              }
            }
-         })
-         .attach(kj::mv(cancelGuard));
+         });
 }
 
 kj::Promise<void> Reader::readIfMsg(ReadIfMsgContext context) {
@@ -519,18 +740,11 @@ kj::Promise<void> Reader::readIfMsg(ReadIfMsgContext context) {
   // the buffer is not empty, send next the value
   if (!b.empty()) {
     KJ_LOG(INFO, "Reader::readIfMsg: buffer not empty, send next value");
-    auto&& v = b.back();
-    KJ_ASSERT(v.get()->isValue(), "Msg contains a value, because before buffering we checked for done.");
-    context.getResults().setValue(v.get()->getValue());
-    b.pop_back();
-
-    c.impl->unblockWaitingWritersWithBufferSpace();
-
-    // check if the channel is supposed to be closed and just waiting for an empty buffer
-    if (b.empty() && c.impl->channelShouldBeClosedOnEmptyBuffer) {
-      c.impl->channelCanBeClosed = true;
-      c.impl->closeChannelFulfiller->fulfill();
-    }
+    auto v = b.oldest();
+    KJ_ASSERT(v.isValue(), "Msg contains a value, because before buffering we checked for done.");
+    context.getResults().setValue(v.getValue());
+    b.pop();
+    c.impl->takenFromBuffer();
 
     return kj::READY_NOW;
   }
@@ -547,12 +761,7 @@ kj::Promise<void> Reader::readIfMsg(ReadIfMsgContext context) {
     c.closedReader(id());
 
     // if there are other readers waiting close them as well
-    while (!c.impl->blockingReadFulfillers.empty()) {
-      KJ_LOG(INFO, "Reader::readIfMsg: close other waiting readers");
-      auto&& brf = c.impl->blockingReadFulfillers.back();
-      brf->fulfill(nullptr);
-      c.impl->blockingReadFulfillers.pop_back();
-    }
+    c.impl->sendDoneToWaitingReaders();
     return kj::READY_NOW;
   }
 
@@ -562,6 +771,57 @@ kj::Promise<void> Reader::readIfMsg(ReadIfMsgContext context) {
   return kj::READY_NOW;
 }
 
+kj::Promise<Reader::Msgs> Reader::readMany(size_t maxNoOfMsgs) {
+  KJ_REQUIRE(!_closed, "Reader already closed.", _closed);
+
+  auto& c = _channel;
+  Msgs res;
+  maxNoOfMsgs = std::max(static_cast<size_t>(1), maxNoOfMsgs);
+
+  // take as many buffered messages as possible, the writers are unblocked once for all freed slots
+  if (!c.impl->buffer.empty()) {
+    KJ_LOG(INFO, "Reader::readMany: buffer not empty, take up to", maxNoOfMsgs, c.impl->buffer.size());
+    c.impl->takeFromBuffer(maxNoOfMsgs, res.msgs);
+    return kj::mv(res);
+  }
+
+  // don't read if the channel is supposed to close
+  if (c.impl->channelCanBeClosed) {
+    return kj::mv(res);
+  }
+
+  // buffer is empty, but we are supposed to close down
+  if (c.impl->sendCloseOnEmptyBuffer) {
+    KJ_LOG(INFO, "Reader::readMany: buffer is empty, but close down");
+    res.done = true;
+    c.closedReader(id());
+    c.impl->sendDoneToWaitingReaders();
+    return kj::mv(res);
+  }
+
+  // block like read for the first message, then take what the writers buffered in the meantime
+  KJ_LOG(INFO, "Reader::readMany: block, because no value to read");
+  return c.impl->blockReader()
+         .then([this, maxNoOfMsgs](kj::Maybe<AnyPointerMsg::Reader> msg) {
+           KJ_REQUIRE(!_closed, "Reader already closed.", _closed);
+
+           Msgs res;
+           if (_channel.impl->sendCloseOnEmptyBuffer && msg == nullptr) {
+             KJ_LOG(INFO, "Reader::readMany: promise_lambda: sending done to reader");
+             res.done = true;
+             _channel.closedReader(id());
+           } else {
+             KJ_IF_MAYBE(m, msg) {
+               res.msgs.add(capnp::clone(*m));
+               if (maxNoOfMsgs > 1 && !_channel.impl->buffer.empty()) {
+                 _channel.impl->takeFromBuffer(maxNoOfMsgs - 1, res.msgs);
+               }
+             }
+           }
+           return res;
+         });
+}
+
 kj::Promise<void> Reader::close(CloseContext context) {
   KJ_LOG(INFO, "Reader::close: received close message id: ", id());
   _channel.closedReader(id());
@@ -600,66 +860,40 @@ kj::Promise<void> Writer::write(WriteContext context) {
 
   auto v = context.getParams();
   auto& c = _channel;
-  auto& b = c.impl->buffer;
 
   // don't accept any further writes if the channel is supposed to be closed (now or when the buffer is empty)
   if (c.impl->channelCanBeClosed || c.impl->channelShouldBeClosedOnEmptyBuffer) {
     KJ_LOG(INFO, "Writer::write:", c.impl->channelCanBeClosed, c.impl->channelShouldBeClosedOnEmptyBuffer);
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
   // if we received a done, this writer can be removed
   if (v.isDone()) {
     KJ_LOG(INFO, "Writer::write: received done -> remove writer", id());
     c.closedWriter(id());
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
-  }
-
-  // there's a reader waiting
-  if (!c.impl->blockingReadFulfillers.empty()) {
-    KJ_LOG(INFO, "Writer::write: unblock waiting reader");
-    auto&& brf = c.impl->blockingReadFulfillers.back();
-    brf->fulfill(v);
-    c.impl->totalNoOfIpsReceived++;
-    c.impl->blockingReadFulfillers.pop_back();
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
-  // there space to store the message
-  if (b.size() < c.impl->bufferSize) {
-    KJ_LOG(INFO, "Writer::write: no reader waiting and space in buffer -> storing message");
-    b.push_front(capnp::clone(v));
-    c.impl->totalNoOfIpsReceived++;
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+  // a reader is waiting or there is space to store the message
+  if (c.impl->tryWrite(v)) {
+    KJ_LOG(INFO, "Writer::write: handed message to waiting reader or stored it in buffer");
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
   // block until the buffer has space
   KJ_LOG(INFO, "Writer::write: no reader waiting and no space in buffer -> block, waiting for reader");
-  auto paf = kj::newPromiseAndFulfiller<void>();
-  auto* fulfillerPtr = paf.fulfiller.get();
-  c.impl->blockingWriteFulfillers.push_front(kj::mv(paf.fulfiller));
-
-  // This guard runs its lambda when it is destroyed (i.e. when the promise is canceled).
-  auto cancelGuard = kj::defer([this, fulfillerPtr]() {
-    auto& q = _channel.impl->blockingWriteFulfillers;
-    for (auto it = q.begin(); it != q.end(); ++it) {
-      if (it->get() == fulfillerPtr) {
-        q.erase(it);
-        KJ_LOG(INFO, "Writer::write: canceled, fulfiller removed from queue");
-        break;
-      }
-    }
-  });
-
-  return paf.promise
+  return c.impl->blockWriter()
             .then([context, this]() mutable {
               KJ_REQUIRE(!_closed, "promise_lambda: Writer already closed.", _closed);
               auto v = context.getParams();
-              _channel.impl->buffer.push_front(capnp::clone(v));
+              _channel.impl->buffer.push(v);
               _channel.impl->totalNoOfIpsReceived++;
               KJ_LOG(INFO, "Writer::write: promise_lambda: wrote value to buffer");
-            }).then([this]() { return _channel.impl->sendImmediateStats(); })
-            .attach(kj::mv(cancelGuard));
+              _channel.impl->statsChanged();
+            });
 }
 
 kj::Promise<void> Writer::writeIfSpace(WriteIfSpaceContext context) {
@@ -667,12 +901,12 @@ kj::Promise<void> Writer::writeIfSpace(WriteIfSpaceContext context) {
 
   auto v = context.getParams();
   auto& c = _channel;
-  auto& b = c.impl->buffer;
 
   // don't accept any further writes if the channel is supposed to be closed (now or when the buffer is empty)
   if (c.impl->channelCanBeClosed || c.impl->channelShouldBeClosedOnEmptyBuffer) {
     KJ_LOG(INFO, "Writer::writeIfSpace:", c.impl->channelCanBeClosed, c.impl->channelShouldBeClosedOnEmptyBuffer);
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
   // if we received a done, this writer can be removed
@@ -681,27 +915,16 @@ kj::Promise<void> Writer::writeIfSpace(WriteIfSpaceContext context) {
     // cout << "Writer::write: received done message id: " << id().cStr() << endl;
     c.closedWriter(id());
     context.getResults().setSuccess(true);
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
-  }
-
-  // there's a reader waiting
-  if (!c.impl->blockingReadFulfillers.empty()) {
-    KJ_LOG(INFO, "Writer::writeIfSpace: unblock waiting reader");
-    auto&& brf = c.impl->blockingReadFulfillers.back();
-    brf->fulfill(v);
-    c.impl->totalNoOfIpsReceived++;
-    c.impl->blockingReadFulfillers.pop_back();
-    context.getResults().setSuccess(true);
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
-  // there space to store the message
-  if (b.size() < c.impl->bufferSize) {
-    KJ_LOG(INFO, "Writer::writeIfSpace: no reader waiting and space in buffer -> storing message");
-    b.push_front(capnp::clone(v));
-    c.impl->totalNoOfIpsReceived++;
+  // a reader is waiting or there is space to store the message
+  if (c.impl->tryWrite(v)) {
+    KJ_LOG(INFO, "Writer::writeIfSpace: handed message to waiting reader or stored it in buffer");
     context.getResults().setSuccess(true);
-    return c.impl->sendImmediateStats(); //kj::READY_NOW;
+    c.impl->statsChanged();
+    return kj::READY_NOW;
   }
 
   KJ_LOG(INFO, "Writer::writeIfSpace: no reader waiting and no space in buffer -> return success=false");
@@ -709,6 +932,42 @@ kj::Promise<void> Writer::writeIfSpace(WriteIfSpaceContext context) {
   return kj::READY_NOW;
 }
 
+kj::Promise<void> Writer::writeMany(kj::ArrayPtr<const AnyPointerMsg::Reader> msgs) {
+  KJ_REQUIRE(!_closed, "Writer already closed.", _closed);
+  KJ_LOG(INFO, "Writer::writeMany: received", msgs.size());
+  return writeManyFrom(msgs, 0).then([this]() { _channel.impl->statsChanged(); });
+}
+
+kj::Promise<void> Writer::writeManyFrom(kj::ArrayPtr<const AnyPointerMsg::Reader> msgs, size_t from) {
+  auto& c = _channel;
+  for (size_t i = from; i < msgs.size(); ++i) {
+    // don't accept any further writes if the channel is supposed to be closed (now or when the buffer is empty)
+    if (c.impl->channelCanBeClosed || c.impl->channelShouldBeClosedOnEmptyBuffer) {
+      KJ_LOG(INFO, "Writer::writeMany: dropping", msgs.size() - i, "messages, channel closes");
+      return kj::READY_NOW;
+    }
+
+    // if we received a done, this writer can be removed and the rest of the batch is ignored
+    if (msgs[i].isDone()) {
+      KJ_LOG(INFO, "Writer::writeMany: received done -> remove writer", id());
+      c.closedWriter(id());
+      return kj::READY_NOW;
+    }
+
+    if (!c.impl->tryWrite(msgs[i])) {
+      // block until the buffer has space, the freed slot belongs to message i, then go on with the rest
+      KJ_LOG(INFO, "Writer::writeMany: no reader waiting and no space in buffer -> block at", i);
+      return c.impl->blockWriter().then([this, msgs, i]() {
+        KJ_REQUIRE(!_closed, "promise_lambda: Writer already closed.", _closed);
+        _channel.impl->buffer.push(msgs[i]);
+        _channel.impl->totalNoOfIpsReceived++;
+        return writeManyFrom(msgs, i + 1);
+      });
+    }
+  }
+  return kj::READY_NOW;
+}
+
 kj::Promise<void> Writer::close(CloseContext context) {
   KJ_LOG(INFO, "Writer::close: received close message id: ", id());
   _channel.closedWriter(id());
@@ -15,25 +15,48 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 
 #pragma once
 
+#include <array>
+
 #include <kj/string.h>
 #include <kj/memory.h>
 #include <kj/async.h>
+#include <kj/vector.h>
 
 #include <capnp/any.h>
 #include <capnp/rpc-twoparty.h>
 
+#include "channel-buffer.h"
 #include "common.h"
 #include "restorer.h"
 #include "common.capnp.h"
 #include "fbp.capnp.h"
 
 namespace mas::infrastructure::common {
+
+struct WaitTimeHistogram {
+  // bucket i counts the waits of [2^i, 2^(i+1)) microseconds, bucket 0 also the shorter ones
+  std::array<uint64_t, 32> buckets{};
+  uint64_t count{0};
+  uint64_t totalInUs{0};
+};
+
+struct ChannelStats {
+  uint64_t totalNoOfIpsReceived{0};
+  uint64_t totalNoOfIpsSent{0};
+  uint64_t noOfIpsInQueue{0};
+  uint64_t noOfWaitingReaders{0};
+  uint64_t noOfWaitingWriters{0};
+  // since the previous call of Channel::stats
+  double ipsReceivedPerSecond{0};
+  double ipsSentPerSecond{0};
+  // time blocked readers and writers waited for a message or buffer space
+  WaitTimeHistogram readerWaitTimes;
+  WaitTimeHistogram writerWaitTimes;
+};
+
 class Reader;
 class Writer;
 
-typedef mas::schema::fbp::Channel<capnp::AnyPointer> AnyPointerChannel;
-typedef typename AnyPointerChannel::Msg AnyPointerMsg;
-
 class Channel final : public AnyPointerChannel::Server {
 public:
   Channel(kj::StringPtr name, kj::StringPtr description, uint64_t bufferSize,
@@ -51,6 +74,14 @@ public:
 
   kj::Promise<void> setBufferSize(SetBufferSizeContext context) override;
 
+  // store the buffered messages in a pre-sized arena of bufferSize * wordsPerMsg words, 0 = clone each message
+  void setArenaWordsPerMsg(uint64_t wordsPerMsg);
+
+  // Keep at most maxNoOfMsgsInMemory messages in memory, the rest of the buffer (up to bufferSize)
+  // is spilled to an append-only log in dir. With replayUnread the unread messages of a previous run
+  // in dir are delivered first, otherwise they are discarded.
+  void spillToDisk(kj::StringPtr dir, uint64_t maxNoOfMsgsInMemory, bool replayUnread);
+
   kj::Promise<void> reader(ReaderContext context) override;
 
   kj::Promise<void> writer(WriterContext context) override;
@@ -65,6 +96,17 @@ public:
 
   kj::Promise<void> sendStats();
 
+  // send stats to callbacks registered with an update interval of 0 at most every minIntervalInMs,
+  // or earlier if changeThreshold > 0 and that many reads and writes happened since the last update
+  void setStatsRateLimit(uint32_t minIntervalInMs, uint64_t changeThreshold = 0);
+
+  ChannelStats stats();
+
+  // the Reader/Writer behind a client created by a channel on this thread, null for other (e.g. remote) clients,
+  // so in-process callers can use readMany/writeMany, the client has to be kept while the result is used
+  static kj::Promise<kj::Maybe<Reader&>> localReader(AnyPointerChannel::ChanReader::Client client);
+  static kj::Promise<kj::Maybe<Writer&>> localWriter(AnyPointerChannel::ChanWriter::Client client);
+
   AnyPointerChannel::Client getClient();
   void setClient(AnyPointerChannel::Client c);
 
@@ -97,6 +139,15 @@ public:
 
   kj::Promise<void> readIfMsg(ReadIfMsgContext context) override;
 
+  struct Msgs {
+    kj::Vector<kj::Own<kj::Decay<AnyPointerMsg::Reader>>> msgs;
+    bool done{false}; // the channel closed, no messages will follow
+  };
+  // Take up to maxNoOfMsgs messages with one call, for callers in the same process as the channel.
+  // Not available over RPC, the schema has no batch read (see PortConnector::readMany for remote readers).
+  // Blocks like read until at least one message is available or the channel is done.
+  kj::Promise<Msgs> readMany(size_t maxNoOfMsgs);
+
   kj::Promise<void> close(CloseContext context) override;
 
   kj::StringPtr id() const { return _id; }
@@ -121,11 +172,19 @@ public:
 
   kj::Promise<void> writeIfSpace(WriteIfSpaceContext context) override;
 
+  // Write the messages in order with one call, for callers in the same process as the channel.
+  // Not available over RPC, the schema has no batch write.
+  // Blocks like write whenever the buffer is full, a done message closes the writer and ends the batch.
+  // The messages have to stay valid until the returned promise resolves.
+  kj::Promise<void> writeMany(kj::ArrayPtr<const AnyPointerMsg::Reader> msgs);
+
   kj::Promise<void> close(CloseContext context) override;
 
   kj::StringPtr id() const { return _id; }
 
 private:
+  kj::Promise<void> writeManyFrom(kj::ArrayPtr<const AnyPointerMsg::Reader> msgs, size_t from);
+
   Channel& _channel;
   bool _closed{false};
   kj::String _id;
@@ -0,0 +1,164 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the ZALF model and simulation infrastructure.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+// latency and throughput of ConnectionManager connections via TCP loopback and a unix domain socket
+// - a server thread with its own event loop offers an Identifiable via a restorer on both transports
+// - the client restores it once per transport (so the local call shortcut doesn't apply) and times
+//   sequential info calls (latency) and batches of pipelined info calls (throughput)
+
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/string.h>
+#include <kj/thread.h>
+#include <kj/vector.h>
+
+#include "common.h"
+#include "restorer.h"
+#include "rpc-connection-manager.h"
+
+#include "common.capnp.h"
+
+using namespace std;
+using namespace mas::infrastructure::common;
+
+namespace {
+struct Params {
+  int calls{10000};
+  int inFlight{100};
+  int payloadBytes{64};
+  int repetitions{3};
+  string socketPath{"/tmp/connection-benchmark.sock"};
+};
+
+struct ServerInfo {
+  const kj::Executor* executor{nullptr};
+  kj::PromiseFulfiller<void>* stop{nullptr};
+  string tcpSR;
+  string unixSR;
+};
+
+double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void runServer(const Params& ps, std::promise<ServerInfo>& started) {
+  auto io = kj::setupAsyncIo();
+  auto ownedRestorer = kj::heap<Restorer>();
+  auto restorer = ownedRestorer.get();
+  mas::schema::persistence::Restorer::Client restorerClient = kj::mv(ownedRestorer);
+  ConnectionManager conMan(io, restorer);
+
+  auto port = conMan.bind(restorerClient, "127.0.0.1").wait(io.waitScope);
+  restorer->setHost("127.0.0.1");
+  restorer->setPort(port).wait(io.waitScope);
+  conMan.setLocallyUsedHost("127.0.0.1");
+
+  // the payload is returned as description
+  string payload(ps.payloadBytes, 'x');
+  mas::schema::common::Identifiable::Client service =
+    kj::heap<Identifiable>("benchmark", "benchmark", kj::heapString(payload.data(), payload.size()));
+
+  ServerInfo info;
+  auto tcpSR = restorer->saveStr(service, "service", nullptr, false, nullptr, false).wait(io.waitScope).sturdyRef;
+  info.tcpSR = tcpSR.cStr();
+  conMan.bindUnix(restorerClient, ps.socketPath.c_str()).wait(io.waitScope);
+  restorer->setUnixSocketPath(ps.socketPath.c_str());
+  info.unixSR = restorer->sturdyRefStr("service").cStr();
+
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  info.executor = &kj::getCurrentThreadExecutor();
+  info.stop = paf.fulfiller.get();
+  started.set_value(info);
+  paf.promise.wait(io.waitScope);
+}
+
+void measure(kj::StringPtr transport, mas::schema::common::Identifiable::Client service, const Params& ps,
+             kj::WaitScope& waitScope) {
+  // warm up the connection
+  service.infoRequest().send().wait(waitScope);
+
+  for (int r = 0; r < ps.repetitions; r++) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ps.calls; i++) service.infoRequest().send().wait(waitScope);
+    auto latencyMs = msSince(start);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < ps.calls; i += ps.inFlight) {
+      kj::Vector<kj::Promise<void>> proms;
+      for (int k = i; k < ps.calls && k < i + ps.inFlight; k++) {
+        proms.add(service.infoRequest().send().ignoreResult());
+      }
+      kj::joinPromises(proms.releaseAsArray()).wait(waitScope);
+    }
+    auto throughputMs = msSince(start);
+
+    cout << transport.cStr() << ": latency " << latencyMs * 1000.0 / ps.calls << " us/call, throughput "
+         << ps.calls / (throughputMs / 1000.0) << " calls/s ("
+         << ps.calls / (throughputMs / 1000.0) * ps.payloadBytes / (1024.0 * 1024.0) << " MiB/s payload)" << endl;
+  }
+}
+
+void printUsage(const char* name) {
+  cout << "usage: " << name << " [options]" << endl
+       << " -calls n ... calls per measurement (10000)" << endl
+       << " -in-flight n ... pipelined calls per batch in the throughput measurement (100)" << endl
+       << " -payload n ... bytes returned by every call (64)" << endl
+       << " -repetitions n ... how often every measurement is repeated (3)" << endl
+       << " -socket path ... unix domain socket of the server (/tmp/connection-benchmark.sock)" << endl;
+}
+}
+
+int main(int argc, char** argv) {
+  Params ps;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-calls" && hasValue) ps.calls = atoi(argv[++i]);
+    else if (arg == "-in-flight" && hasValue) ps.inFlight = max(1, atoi(argv[++i]));
+    else if (arg == "-payload" && hasValue) ps.payloadBytes = atoi(argv[++i]);
+    else if (arg == "-repetitions" && hasValue) ps.repetitions = atoi(argv[++i]);
+    else if (arg == "-socket" && hasValue) ps.socketPath = argv[++i];
+    else {
+      printUsage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::promise<ServerInfo> started;
+  auto startedFuture = started.get_future();
+  kj::Thread serverThread([&]() { runServer(ps, started); });
+  auto server = startedFuture.get();
+
+  {
+    auto io = kj::setupAsyncIo();
+    ConnectionManager conMan(io);
+    conMan.setLocallyUsedHost("127.0.0.1");
+
+    auto viaTcp = conMan.tryConnectB(server.tcpSR.c_str()).castAs<mas::schema::common::Identifiable>();
+    measure("tcp loopback", viaTcp, ps, io.waitScope);
+
+    auto viaUnix = conMan.tryConnectB(server.unixSR.c_str()).castAs<mas::schema::common::Identifiable>();
+    measure("unix socket", viaUnix, ps, io.waitScope);
+  }
+
+  server.executor->executeSync([&]() { server.stop->fulfill(); });
+  return 0;
+}
@@ -71,6 +71,11 @@ kj::MainBuilder::Validity RestorableServiceMain::setPort(kj::StringPtr name) {
   return true;
 }
 
+kj::MainBuilder::Validity RestorableServiceMain::setUnixSocket(kj::StringPtr path) {
+  unixSocketPath = kj::str(path);
+  return true;
+}
+
 kj::MainBuilder::Validity RestorableServiceMain::setCheckPort(kj::StringPtr portStr) {
   checkPort = portStr.parseAs<int>();
   return true;
@@ -200,6 +205,14 @@ void RestorableServiceMain::startRestorerSetup(mas::schema::common::Identifiable
                   .wait(ioContext.waitScope);
   KJ_LOG(INFO, "Bound restorer to", host, port);
 
+  // clients on the same host will connect via the unix domain socket
+  if (unixSocketPath.size() > 0) {
+    conMan->bindUnix(serviceAsBootstrap ? serviceClient.castAs<capnp::Capability>() : restorerClient, unixSocketPath)
+        .wait(ioContext.waitScope);
+    restorer->setUnixSocketPath(unixSocketPath);
+    KJ_LOG(INFO, "Bound restorer to unix domain socket", unixSocketPath);
+  }
+
   // print the restorers sturdy ref
   auto restorerSR = restorer->sturdyRefStr("");
   if (outputSturdyRefs && restorerSR.size() > 0) {
@@ -242,6 +255,9 @@ kj::MainBuilder &RestorableServiceMain::addRestorableServiceOptions() {
                         "<true | false (default: true)>", "Initialize service from storage.")
       .addOptionWithArg({'h', "host"}, KJ_BIND_METHOD(*this, setHost), "<host-IP>", "Set host IP.")
       .addOptionWithArg({'p', "port"}, KJ_BIND_METHOD(*this, setPort), "<port>", "Set port.")
+      .addOptionWithArg({"unix_socket"}, KJ_BIND_METHOD(*this, setUnixSocket), "<path>",
+                        "Additionally accept connections on this unix domain socket, which clients on the same host "
+                        "will use instead of TCP.")
       .addOptionWithArg({"restorer_container_sr"}, KJ_BIND_METHOD(*this, setRestorerContainerSR), "<sturdy_ref>",
                         "Sturdy ref to container for this restorer.")
       .addOptionWithArg({"service_container_sr"}, KJ_BIND_METHOD(*this, setServiceContainerSR), "<sturdy_ref>",
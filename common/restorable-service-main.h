@@ -43,6 +43,7 @@ public:
   kj::MainBuilder::Validity setSrHost(kj::StringPtr h);
   kj::MainBuilder::Validity setSrPort(kj::StringPtr name);
   kj::MainBuilder::Validity setPort(kj::StringPtr name);
+  kj::MainBuilder::Validity setUnixSocket(kj::StringPtr path);
   kj::MainBuilder::Validity setCheckPort(kj::StringPtr portStr);
   kj::MainBuilder::Validity setCheckIP(kj::StringPtr ip);
   kj::MainBuilder::Validity setRestorerContainerSR(kj::StringPtr sr);
@@ -77,6 +78,7 @@ protected:
   kj::String srHost;
   int srPort{-1};
   int port{0};
+  kj::String unixSocketPath;
   kj::String checkIP;
   int checkPort{0};
   kj::Maybe<mas::schema::storage::Store::Container::Client> restorerContainerClient;
@@ -56,6 +56,7 @@ struct Restorer::Impl {
 
   kj::String host;
   uint16_t port{ 0 };
+  kj::String unixSocketPath;
   uint64_t vatId[4]{ 0, 0, 0, 0 };
   //kj::Array<unsigned char> signPKArray;
   kj::FixedArray<unsigned char, crypto_sign_PUBLICKEYBYTES> signPKArray;
@@ -386,6 +387,10 @@ kj::StringPtr Restorer::getHost() const { return impl->host; }
 
 void Restorer::setHost(kj::StringPtr h) { impl->host = kj::str(h); }
 
+kj::StringPtr Restorer::getUnixSocketPath() const { return impl->unixSocketPath; }
+
+void Restorer::setUnixSocketPath(kj::StringPtr path) { impl->unixSocketPath = kj::str(path); }
+
 
 mas::schema::storage::Store::Container::Client Restorer::getStore() { return impl->store; }
 
@@ -486,7 +491,9 @@ kj::String Restorer::sturdyRefStr(kj::StringPtr srToken) const {
   //auto srTokenBase64 = kj::encodeBase64Url(srToken.asBytes());
   auto vatIdBase64 = kj::encodeBase64Url(impl->signPKArray);
   return kj::str("capnp://", vatIdBase64, "@", impl->host, impl->port > 0 ? kj::str(":", impl->port) : ""_kj,
-                 srToken == nullptr ? "" : "/", srToken == nullptr ? "" : srToken);
+                 srToken == nullptr ? "" : "/", srToken == nullptr ? "" : srToken,
+                 impl->unixSocketPath.size() > 0
+                 ? kj::str("?unix_socket=", kj::encodeUriComponent(impl->unixSocketPath)) : ""_kj);
 }
 
 void Restorer::sturdyRef(mas::schema::persistence::SturdyRef::Builder& srb, kj::StringPtr srToken) const {
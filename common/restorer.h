@@ -42,6 +42,11 @@ class Restorer final : public mas::schema::persistence::Restorer::Server
 
   kj::StringPtr getHost() const;
   void setHost(kj::StringPtr h);
+
+  kj::StringPtr getUnixSocketPath() const;
+  void setUnixSocketPath(kj::StringPtr path);
+  // sturdy ref urls then carry the path as unix_socket query parameter, which clients on the same host use
+  // instead of host:port
   
   mas::schema::storage::Store::Container::Client getStore();
   void setStorageContainer(mas::schema::storage::Store::Container::Client s);
@@ -30,6 +30,8 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>  // Add this for gethostbyname/getaddrinfo
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #define CLOSE_SOCKET(s) close(s)
 #define SOCKLEN_T socklen_t
@@ -38,14 +40,14 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include "rpc-connection-manager.h"
 
 #include <algorithm>
-#include <chrono>
-#include <thread>
+#include <random>
 
 #include <kj/async-io.h>
 #include <kj/debug.h>
 #include <kj/encoding.h>
 #include <kj/map.h>
 #include <kj/timer.h>
+#include <kj/vector.h>
 #include <kj/compat/url.h>
 #include <capnp/ez-rpc.h>
 #include <capnp/message.h>
@@ -61,6 +63,24 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 
 using namespace mas::infrastructure::common;
 
+#ifndef _WIN32
+namespace {
+// a server is still accepting connections on the socket at path
+bool isLiveUnixSocket(kj::StringPtr path) {
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) return false;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.cStr(), path.size());
+  auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  bool live = ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+  CLOSE_SOCKET(fd);
+  return live;
+}
+}
+#endif
+
 struct ClientContext {
   kj::Own<kj::AsyncIoStream> stream;
   capnp::TwoPartyVatNetwork network;
@@ -97,6 +117,7 @@ struct ServerContext {
 struct ConnectionManager::Impl {
   kj::String locallyUsedHost;
   kj::uint port{0};
+  kj::String unixSocketPath; // removed again on destruction
 
   struct ErrorHandler : public kj::TaskSet::ErrorHandler {
     void taskFailed(kj::Exception &&exception) override {
@@ -106,21 +127,152 @@ struct ConnectionManager::Impl {
 
   ErrorHandler eh;
   kj::TaskSet tasks;
+  // one connection per host:port, shared by all sturdy refs to it
   kj::HashMap<kj::String, kj::Own<ClientContext>> connections;
+  kj::HashMap<kj::String, kj::ForkedPromise<capnp::Capability::Client>> pendingConnections;
+  kj::TaskSet connectionTasks; // destroyed before the connections it watches
   capnp::Capability::Client serverMainInterface{nullptr};
   kj::Timer *timer{nullptr};
   kj::Own<Restorer> restorer;
   kj::NullDisposer disposer;
   kj::AsyncIoContext *ioContext{nullptr};
+  std::mt19937 random{std::random_device()()};
+  // a retry delay of 0 would retry in a busy loop
+  const kj::Duration minRetryDelay{100 * kj::MILLISECONDS};
 
   explicit Impl(kj::AsyncIoContext &ioc, Restorer *restorer)
-      : tasks(eh), ioContext(&ioc) {
+      : tasks(eh), connectionTasks(eh), ioContext(&ioc) {
 
     if (restorer) this->restorer = kj::Own<Restorer>(restorer, disposer);
     else this->restorer = kj::heap<Restorer>();
   }
 
-  ~Impl() = default;
+  ~Impl() {
+#ifndef _WIN32
+    struct stat st;
+    if (unixSocketPath.size() > 0 && lstat(unixSocketPath.cStr(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+      unlink(unixSocketPath.cStr());
+    }
+#endif
+    auto &servers = localServers();
+    for (size_t i = 0; i < servers.size(); i++) {
+      if (servers[i] == this) {
+        servers[i] = servers.back();
+        servers.removeLast();
+        break;
+      }
+    }
+  }
+
+  // the bound servers of the connection managers on this thread, capabilities can't be used on other threads
+  static kj::Vector<Impl*> &localServers() {
+    thread_local kj::Vector<Impl*> servers;
+    return servers;
+  }
+
+  bool isLocalHost(kj::StringPtr host) const {
+    return host == locallyUsedHost || host == "localhost" || host == "127.0.0.1";
+  }
+
+  // the main interface of a server in this process and thread bound to host:port, so sturdy refs to it
+  // can be restored by local calls instead of a connection over the network
+  static kj::Maybe<capnp::Capability::Client> findLocalServer(kj::StringPtr host, kj::uint port) {
+    for (auto server : localServers()) {
+      if (server->port == port && server->isLocalHost(host)) return server->serverMainInterface;
+    }
+    return nullptr;
+  }
+
+  static kj::Maybe<capnp::Capability::Client> findLocalServer(kj::StringPtr hostAndPort) {
+    // a malformed port isn't a local server, the normal connect reports the error
+    KJ_IF_MAYBE(colonPos, hostAndPort.findLast(':')) {
+      KJ_IF_MAYBE(port, hostAndPort.slice(*colonPos + 1).tryParseAs<kj::uint>()) {
+        return findLocalServer(kj::str(hostAndPort.slice(0, *colonPos)), *port);
+      }
+    }
+    return nullptr;
+  }
+
+  kj::Timer &getTimer() {
+    if (!timer) timer = &(ioContext->provider->getTimer());
+    return *timer;
+  }
+
+  // the bootstrap capability of the connection to key, which is set up only if there is no connection
+  // or connection attempt to key yet
+  kj::Promise<capnp::Capability::Client> bootstrap(kj::StringPtr key, kj::StringPtr address, kj::uint portHint) {
+    KJ_IF_MAYBE(cc, connections.find(key)) return (*cc)->bootstrap;
+    KJ_IF_MAYBE(pending, pendingConnections.find(key)) return pending->addBranch();
+
+    auto connected = ioContext->provider->getNetwork().parseAddress(address, portHint).then(
+        [](kj::Own<kj::NetworkAddress> &&addr) {
+          return addr->connect().attach(kj::mv(addr));
+        }).then(
+        [this, key = kj::str(key)](kj::Own<kj::AsyncIoStream> &&stream) {
+          auto cc = kj::heap<ClientContext>(kj::mv(stream), capnp::ReaderOptions());
+          cc->bootstrap = cc->getMain();
+          capnp::Capability::Client bootstrapCap = cc->bootstrap;
+
+          // a broken connection is evicted, so the next connect to key sets up a new one
+          auto ccPtr = cc.get();
+          connectionTasks.add(cc->network.onDisconnect().then(
+              [this, key = kj::str(key), ccPtr]() { evict(key, ccPtr); },
+              [this, key = kj::str(key), ccPtr](kj::Exception &&e) { evict(key, ccPtr); }));
+          connections.upsert(kj::str(key), kj::mv(cc));
+          removePendingLater(key);
+          return bootstrapCap;
+        },
+        [this, key = kj::str(key)](kj::Exception &&e) -> capnp::Capability::Client {
+          removePendingLater(key);
+          kj::throwFatalException(kj::mv(e));
+        });
+
+    auto forked = connected.fork();
+    auto branch = forked.addBranch();
+    pendingConnections.insert(kj::str(key), kj::mv(forked));
+    return branch;
+  }
+
+  // not while the forked promise is still resolving
+  void removePendingLater(kj::StringPtr key) {
+    connectionTasks.add(kj::evalLater([this, key = kj::str(key)]() { pendingConnections.erase(key); }));
+  }
+
+  void evict(kj::StringPtr key, ClientContext *cc) {
+    KJ_IF_MAYBE(current, connections.find(key)) {
+      if (current->get() == cc) {
+        KJ_LOG(INFO, "evicting disconnected connection to", key);
+        connections.erase(key);
+      }
+    }
+  }
+
+  // connect again after an exponentially growing, jittered delay, without blocking the event loop,
+  // after the last retry the promise is rejected with the last error
+  kj::Promise<capnp::Capability::Client> retry(kj::Function<kj::Promise<capnp::Capability::Client>()> connect,
+                                               kj::String sturdyRef, int retriesLeft, kj::Duration delay,
+                                               kj::Duration maxDelay, bool printRetryMsgs) {
+    auto promise = kj::evalNow([&]() { return connect(); });
+    return promise.catch_(
+        [this, connect = kj::mv(connect), sturdyRef = kj::mv(sturdyRef), retriesLeft, delay, maxDelay,
+         printRetryMsgs](kj::Exception &&e) mutable -> kj::Promise<capnp::Capability::Client> {
+          if (retriesLeft <= 0) return kj::mv(e);
+          // wait between half and the full delay, so many clients of a restarted service don't retry in lockstep
+          delay = kj::max(delay, minRetryDelay);
+          auto delayInMs = delay / kj::MILLISECONDS;
+          auto jitteredDelay =
+              std::uniform_int_distribution<int64_t>(delayInMs / 2, delayInMs)(random) * kj::MILLISECONDS;
+          if (printRetryMsgs) {
+            KJ_LOG(INFO, "Trying to connect to", sturdyRef, "again in ms", jitteredDelay / kj::MILLISECONDS, e);
+          }
+          return getTimer().afterDelay(jitteredDelay).then(
+              [this, connect = kj::mv(connect), sturdyRef = kj::mv(sturdyRef), retriesLeft, delay, maxDelay,
+               printRetryMsgs]() mutable {
+                return retry(kj::mv(connect), kj::mv(sturdyRef), retriesLeft - 1, kj::min(delay * 2, maxDelay),
+                             maxDelay, printRetryMsgs);
+              });
+        });
+  }
 
   void acceptLoop(kj::Own<kj::ConnectionReceiver> &&listener, capnp::ReaderOptions readerOpts) {
     auto ptr = listener.get();
@@ -161,82 +313,55 @@ kj::StringPtr ConnectionManager::getLocallyUsedHost() const { return impl->local
 void ConnectionManager::setLocallyUsedHost(kj::StringPtr h) { impl->locallyUsedHost = kj::str(h); }
 
 
+kj::Promise<capnp::Capability::Client> ConnectionManager::connectWithRetry(kj::StringPtr sturdyRefStr,
+                                                                           RetryPolicy policy) {
+  return impl->retry([this, sturdyRefStr = kj::str(sturdyRefStr)]() { return connect(sturdyRefStr); },
+                     kj::str(sturdyRefStr), policy.retryCount, policy.initialDelay, policy.maxDelay,
+                     policy.printRetryMsgs);
+}
+
+kj::Promise<capnp::Capability::Client> ConnectionManager::connectWithRetry(
+    mas::schema::persistence::SturdyRef::Reader sturdyRef, RetryPolicy policy) {
+  return impl->retry([this, sturdyRef]() { return connect(sturdyRef); },
+                     kj::str(sturdyRef), policy.retryCount, policy.initialDelay, policy.maxDelay,
+                     policy.printRetryMsgs);
+}
+
+namespace {
+// tryConnect returns a null capability instead of the last error
+kj::Promise<capnp::Capability::Client> nullAfterLastRetry(kj::Promise<capnp::Capability::Client> promise,
+                                                          kj::String sturdyRef, bool printRetryMsgs) {
+  return promise.catch_([sturdyRef = kj::mv(sturdyRef), printRetryMsgs](kj::Exception &&e) {
+    if (printRetryMsgs) KJ_LOG(INFO, "Couldn't connect to sturdy_ref at", sturdyRef, "!");
+    return capnp::Capability::Client(nullptr);
+  });
+}
+}
+
 kj::Promise<capnp::Capability::Client> ConnectionManager::tryConnect(kj::StringPtr sturdyRefStr,
                                                                      int retryCount, int retrySecs,
                                                                      bool printRetryMsgs) {
-  try {
-    return connect(sturdyRefStr);
-  } catch (const std::exception &e) {
-    if (!impl->timer) impl->timer = &(impl->ioContext->provider->getTimer());
-    return impl->timer->afterDelay(retrySecs * kj::SECONDS).then([&]() {
-      if (retryCount == 0) {
-        if (printRetryMsgs) KJ_LOG(INFO, "Couldn't connect to sturdy_ref at", sturdyRefStr, "!");
-        return kj::Promise<capnp::Capability::Client>(nullptr);
-      }
-      retryCount -= 1;
-      if (printRetryMsgs) KJ_LOG(INFO, "Trying to connect to", sturdyRefStr, "again in", retrySecs, "s!");
-      retrySecs += 1;
-      return tryConnect(sturdyRefStr);
-    });
-  }
+  RetryPolicy policy{retryCount, retrySecs * kj::SECONDS};
+  policy.printRetryMsgs = printRetryMsgs;
+  return nullAfterLastRetry(connectWithRetry(sturdyRefStr, policy), kj::str(sturdyRefStr), printRetryMsgs);
 }
 
 kj::Promise<capnp::Capability::Client> ConnectionManager::tryConnect(mas::schema::persistence::SturdyRef::Reader sturdyRef,
                                                                      int retryCount, int retrySecs,
                                                                      bool printRetryMsgs) {
-  try {
-    return connect(sturdyRef);
-  } catch (const std::exception &e) {
-    if (!impl->timer) impl->timer = &(impl->ioContext->provider->getTimer());
-    return impl->timer->afterDelay(retrySecs * kj::SECONDS).then([&]() {
-      if (retryCount == 0) {
-        if (printRetryMsgs) KJ_LOG(INFO, "Couldn't connect to sturdy_ref at", sturdyRef, "!");
-        return kj::Promise<capnp::Capability::Client>(nullptr);
-      }
-      retryCount -= 1;
-      if (printRetryMsgs) KJ_LOG(INFO, "Trying to connect to", sturdyRef, "again in", retrySecs, "s!");
-      retrySecs += 1;
-      return tryConnect(sturdyRef);
-    });
-  }
+  RetryPolicy policy{retryCount, retrySecs * kj::SECONDS};
+  policy.printRetryMsgs = printRetryMsgs;
+  return nullAfterLastRetry(connectWithRetry(sturdyRef, policy), kj::str(sturdyRef), printRetryMsgs);
 }
 
 capnp::Capability::Client ConnectionManager::tryConnectB(kj::StringPtr sturdyRefStr,
                                                          int retryCount, int retrySecs, bool printRetryMsgs) {
-  while (true) {
-    try {
-      return connect(sturdyRefStr).wait(impl->ioContext->waitScope);
-    } catch (const kj::Exception &e) {
-      if (retryCount == 0) {
-        if (printRetryMsgs) KJ_LOG(INFO, "Couldn't connect to sturdy_ref at", sturdyRefStr, "!");
-        return nullptr;
-      }
-      KJ_LOG(INFO, e);
-      std::this_thread::sleep_for(std::chrono::milliseconds(retrySecs * 1000));
-      retryCount -= 1;
-      if (printRetryMsgs) KJ_LOG(INFO, "Trying to connect to", sturdyRefStr, "again in", retrySecs, "s!");
-      retrySecs += 1;
-    }
-  }
+  return tryConnect(sturdyRefStr, retryCount, retrySecs, printRetryMsgs).wait(impl->ioContext->waitScope);
 }
 
 capnp::Capability::Client ConnectionManager::tryConnectB(mas::schema::persistence::SturdyRef::Reader sturdyRef,
                                                          int retryCount, int retrySecs, bool printRetryMsgs) {
-  while (true) {
-    try {
-      return connect(sturdyRef).wait(impl->ioContext->waitScope);
-    } catch (const kj::Exception &e) {
-      if (retryCount == 0) {
-        if (printRetryMsgs) KJ_LOG(INFO, "Couldn't connect to sturdy_ref at", sturdyRef, "!");
-        return nullptr;
-      }
-      KJ_LOG(INFO, e);
-      std::this_thread::sleep_for(std::chrono::milliseconds(retrySecs * 1000));
-      retryCount -= 1;
-      if (printRetryMsgs) KJ_LOG(INFO, "Trying to connect to", sturdyRef, "again in", retrySecs, "s!");
-      retrySecs += 1;
-    }
-  }
+  return tryConnect(sturdyRef, retryCount, retrySecs, printRetryMsgs).wait(impl->ioContext->waitScope);
 }
 
 kj::Promise<capnp::Capability::Client> ConnectionManager::connect(mas::schema::persistence::SturdyRef::Reader sturdyRef) {
@@ -255,37 +380,19 @@ kj::Promise<capnp::Capability::Client> ConnectionManager::connect(mas::schema::p
 
   auto connectTo =
       [this, restoreSR](mas::schema::persistence::SturdyRef::Reader sr) mutable {
-        KJ_IF_MAYBE (const clientContext, impl->connections.find(sr.getVat().getAddress().getHost())) {
-          if (sr.hasLocalRef()) return restoreSR((*clientContext)->bootstrap, sr.getLocalRef().getText());
-          return kj::Promise<capnp::Capability::Client>((*clientContext)->bootstrap);
-        } else {
-          auto addr = sr.getVat().getAddress();
-          return impl->ioContext->provider->getNetwork().parseAddress(addr.getHost(), addr.getPort()).then(
-              [](kj::Own<kj::NetworkAddress> &&addr) {
-                return addr->connect().attach(kj::mv(addr));
-              }).then(
-              [restoreSR, this, KJ_MVCAP(addr), KJ_MVCAP(sr)](
-                  kj::Own<kj::AsyncIoStream> &&stream) {
-                capnp::ReaderOptions readerOpts;
-                auto cc = kj::heap<ClientContext>(kj::mv(stream), readerOpts);
-                capnp::Capability::Client bootstrapCap = cc->getMain();
-                cc->bootstrap = bootstrapCap;
-                impl->connections.insert(kj::str(addr.getHost()), kj::mv(cc));
-
-                if (sr.hasLocalRef()) {
-                  return restoreSR(bootstrapCap, sr.getLocalRef().getText());
-                }
-                return kj::Promise<capnp::Capability::Client>(bootstrapCap);
-              }
-          );
-        }
+        auto addr = sr.getVat().getAddress();
+        return impl->bootstrap(kj::str(addr.getHost(), ":", addr.getPort()), addr.getHost(), addr.getPort()).then(
+            [restoreSR, sr](capnp::Capability::Client &&bootstrapCap) {
+              if (sr.hasLocalRef()) return restoreSR(bootstrapCap, sr.getLocalRef().getText());
+              return kj::Promise<capnp::Capability::Client>(kj::mv(bootstrapCap));
+            });
       };
 
-  if (const auto addr = sturdyRef.getVat().getAddress();
-    addr.getHost() == kj::str(impl->locallyUsedHost, ":", impl->port)) {
+  const auto addr = sturdyRef.getVat().getAddress();
+  KJ_IF_MAYBE(localServer, Impl::findLocalServer(addr.getHost(), addr.getPort())) {
     KJ_LOG(INFO, "connecting to local server");
-    if (sturdyRef.hasLocalRef()) return restoreSR(impl->serverMainInterface, sturdyRef.getLocalRef().getText());
-    else return {impl->serverMainInterface};
+    if (sturdyRef.hasLocalRef()) return restoreSR(*localServer, sturdyRef.getLocalRef().getText());
+    else return {*localServer};
   }
 
   return connectTo(sturdyRef);
@@ -305,31 +412,14 @@ kj::Promise<capnp::Capability::Client> ConnectionManager::connect(kj::Url url) {
         });
       };
 
+  // the owner guid points into the url's query, so it stays valid when the url is moved
   auto connectTo =
       [this, restoreSR](kj::Url url, kj::StringPtr host, kj::uint port, kj::StringPtr ownerGuid) mutable {
-        KJ_IF_MAYBE (clientContext, impl->connections.find(host)) {
-          if (!url.path.empty()) return restoreSR((*clientContext)->bootstrap, url.path[0], ownerGuid);
-          return kj::Promise<capnp::Capability::Client>((*clientContext)->bootstrap);
-        } else {
-          return impl->ioContext->provider->getNetwork().parseAddress(host, port).then(
-              [restoreSR](kj::Own<kj::NetworkAddress> &&addr) {
-                return addr->connect().attach(kj::mv(addr));
-              }).then(
-              [restoreSR, this, KJ_MVCAP(host), KJ_MVCAP(url), KJ_MVCAP(ownerGuid)](
-                  kj::Own<kj::AsyncIoStream> &&stream) {
-                capnp::ReaderOptions readerOpts;
-                auto cc = kj::heap<ClientContext>(kj::mv(stream), readerOpts);
-                capnp::Capability::Client bootstrapCap = cc->getMain();
-                cc->bootstrap = bootstrapCap;
-                impl->connections.insert(kj::str(host), kj::mv(cc));
-
-                if (!url.path.empty()) {
-                  return restoreSR(bootstrapCap, url.path[0], ownerGuid);
-                }
-                return kj::Promise<capnp::Capability::Client>(bootstrapCap);
-              }
-          );
-        }
+        return impl->bootstrap(host, host, port).then(
+            [restoreSR, KJ_MVCAP(url), ownerGuid](capnp::Capability::Client &&bootstrapCap) {
+              if (!url.path.empty()) return restoreSR(bootstrapCap, url.path[0], ownerGuid);
+              return kj::Promise<capnp::Capability::Client>(kj::mv(bootstrapCap));
+            });
       };
 
   // we assume that a sturdy ref url looks always like
@@ -340,18 +430,20 @@ kj::Promise<capnp::Capability::Client> ConnectionManager::connect(kj::Url url) {
   if (url.scheme != "capnp") return nullptr;
 
   kj::StringPtr ownerGuid;
+  kj::StringPtr unixSocketPath;
   uint64_t bootstrapInterfaceId = 0;
   uint64_t sturdyRefInterfaceId = 0;
   for (const auto &qp: url.query) {
     if (qp.name == "owner_guid") ownerGuid = qp.value;
+    if (qp.name == "unix_socket") unixSocketPath = qp.value;
     if (qp.name == "b_iid") bootstrapInterfaceId = qp.value.parseAs<uint64_t>();
     if (qp.name == "sr_iid") sturdyRefInterfaceId = qp.value.parseAs<uint64_t>();
   }
 
-  if (url.host == kj::str(impl->locallyUsedHost, ":", impl->port)) {
+  KJ_IF_MAYBE(localServer, Impl::findLocalServer(url.host)) {
     KJ_LOG(INFO, "connecting to local server");
-    if (!url.path.empty()) return restoreSR(impl->serverMainInterface, url.path[0], ownerGuid);
-    else return {impl->serverMainInterface};
+    if (!url.path.empty()) return restoreSR(*localServer, url.path[0], ownerGuid);
+    else return {*localServer};
   }
 
   //parse port out of host address because under windows parseAddress below seams to have problems
@@ -359,11 +451,31 @@ kj::Promise<capnp::Capability::Client> ConnectionManager::connect(kj::Url url) {
   //do both, let kj parse the host address for a port, but additionally provide the port hint
   //kj::String address;
   kj::uint port = 0;
+  kj::StringPtr hostName = url.host;
+  kj::String hostNameCopy;
   KJ_IF_MAYBE (colonPos, url.host.findFirst(':')) {
     //address = kj::str(addressPort.slice(0, *colonPos));
     port = url.host.slice(*colonPos + 1).parseAs<kj::uint>();
+    hostNameCopy = kj::str(url.host.slice(0, *colonPos));
+    hostName = hostNameCopy;
   }
 
+#ifndef _WIN32
+  // the service offers a unix domain socket, use it only if the service runs on this host,
+  // if the socket doesn't work (e.g. a stale socket file), connect via host:port
+  if (unixSocketPath.size() > 0 && impl->isLocalHost(hostName) && access(unixSocketPath.cStr(), F_OK) == 0) {
+    auto unixAddress = kj::str("unix:", unixSocketPath);
+    auto tcpUrl = url.clone();
+    auto tcpHost = kj::str(url.host);
+    auto tcpOwnerGuid = kj::str(ownerGuid);
+    return connectTo(kj::mv(url), unixAddress, 0, ownerGuid).attach(kj::mv(unixAddress)).catch_(
+        [connectTo, KJ_MVCAP(tcpUrl), KJ_MVCAP(tcpHost), port, KJ_MVCAP(tcpOwnerGuid)](kj::Exception &&e) mutable {
+          KJ_LOG(WARNING, "couldn't connect via unix domain socket, trying", tcpHost, e);
+          return connectTo(kj::mv(tcpUrl), tcpHost, port, tcpOwnerGuid).attach(kj::mv(tcpOwnerGuid));
+        });
+  }
+#endif
+
   // is a host port resolver
   if (bootstrapInterfaceId == 0xaa8d91fab6d01d9f) {
     auto bsUrl = url.clone();
@@ -387,7 +499,8 @@ kj::Promise<capnp::Capability::Client> ConnectionManager::connect(kj::Url url) {
         });
   }
   //else
-  return connectTo(kj::mv(url), url.host, port, ownerGuid);
+  auto host = kj::str(url.host);
+  return connectTo(kj::mv(url), host, port, ownerGuid);
 }
 
 kj::Promise<capnp::Capability::Client> ConnectionManager::connect(kj::StringPtr sturdyRefStr) {
@@ -411,6 +524,8 @@ kj::Promise<kj::uint> ConnectionManager::bind(capnp::Capability::Client mainInte
       [portFulfiller = kj::mv(portPaf.fulfiller), this](kj::Own<kj::NetworkAddress> &&addr) mutable {
         auto listener = addr->listen();
         impl->port = listener->getPort();
+        auto &servers = Impl::localServers();
+        if (std::find(servers.begin(), servers.end(), impl.get()) == servers.end()) servers.add(impl.get());
         auto port = impl->port;
         portFulfiller->fulfill(kj::mv(port));
         impl->acceptLoop(kj::mv(listener), capnp::ReaderOptions());
@@ -420,6 +535,26 @@ kj::Promise<kj::uint> ConnectionManager::bind(capnp::Capability::Client mainInte
   return kj::mv(portPaf.promise);
 }
 
+kj::Promise<void> ConnectionManager::bindUnix(capnp::Capability::Client mainInterface, kj::StringPtr socketPath) {
+#ifdef _WIN32
+  KJ_FAIL_REQUIRE("unix domain sockets are not supported on Windows", socketPath);
+#else
+  // a socket left over by a previous run would make listen fail, but nothing else may be replaced
+  struct stat st;
+  if (lstat(socketPath.cStr(), &st) == 0) {
+    KJ_REQUIRE(S_ISSOCK(st.st_mode), "unix socket path exists and is not a socket", socketPath);
+    KJ_REQUIRE(!isLiveUnixSocket(socketPath), "unix socket is in use by another server", socketPath);
+    unlink(socketPath.cStr());
+  }
+
+  impl->serverMainInterface = mainInterface;
+  return impl->ioContext->provider->getNetwork().parseAddress(kj::str("unix:", socketPath)).then(
+      [this, socketPath = kj::str(socketPath)](kj::Own<kj::NetworkAddress> &&addr) mutable {
+        impl->acceptLoop(addr->listen(), capnp::ReaderOptions());
+        impl->unixSocketPath = kj::mv(socketPath);
+      });
+#endif
+}
 
 kj::Tuple<bool, kj::String>
 mas::infrastructure::common::getLocalIP(kj::StringPtr connectToHost, kj::uint connectToPort) {
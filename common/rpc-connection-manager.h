@@ -35,6 +35,21 @@ public:
 	kj::StringPtr getLocallyUsedHost() const;
 	void setLocallyUsedHost(kj::StringPtr h);
 
+	struct RetryPolicy {
+		int retryCount{10};
+		// doubled after every retry up to maxDelay, at least 100ms, every wait is jittered into [delay/2, delay]
+		kj::Duration initialDelay{5 * kj::SECONDS};
+		kj::Duration maxDelay{60 * kj::SECONDS};
+		bool printRetryMsgs{true};
+	};
+
+	// retries failed connects without blocking the event loop,
+	// after the last retry the promise is rejected with the last error
+	kj::Promise<capnp::Capability::Client> connectWithRetry(kj::StringPtr sturdyRefStr, RetryPolicy policy);
+	kj::Promise<capnp::Capability::Client> connectWithRetry(mas::schema::persistence::SturdyRef::Reader sturdyRef,
+		RetryPolicy policy);
+
+	// like connectWithRetry, but returns a null capability after the last retry
 	kj::Promise<capnp::Capability::Client> tryConnect(kj::StringPtr sturdyRefStr,
 		int retryCount = 10, int retrySecs = 5, bool printRetryMsgs = true);
 
@@ -53,6 +68,10 @@ public:
 
 	kj::Promise<kj::uint> bind(capnp::Capability::Client mainInterface, kj::StringPtr host, kj::uint port = 0U);
 
+	// additionally accept connections on a unix domain socket, a stale socket of a previous run is replaced,
+	// the socket is removed when the connection manager is destroyed
+	kj::Promise<void> bindUnix(capnp::Capability::Client mainInterface, kj::StringPtr socketPath);
+
   kj::AsyncIoContext& ioContext() const;
 
 private:
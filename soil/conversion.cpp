@@ -19,6 +19,10 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include "conversion.h"
 
 #include  <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "tools/immutable-registry.h"
 
 using namespace Soil;
 using namespace std;
@@ -149,129 +153,155 @@ std::string percentSandAndClayToKA5Texture(uint8_t sand, uint8_t clay) {
   return soil_texture;
 }
 
-string Soil::sandAndClay2KA5texture(double sand, double clay) {
-  return percentSandAndClayToKA5Texture(int(sand * 100.0), int(clay * 100.0));
-}
+namespace {
+struct KA5TextureData {
+  const char* name;
+  double sand; //!< [0-1]
+  double clay; //!< [0-1]
+};
 
-EResult<double> Soil::KA5texture2sand(string soilType) {
-  EResult<double> res;
-  double &x = res.result;
-  soilType = Tools::toUpper(soilType);
+//! id 0 is "no texture", the other ids are the index + 1
+const KA5TextureData ka5TextureData[] = {
+    {"FS", 0.84, 0.02},
+    {"FSMS", 0.86, 0.02},
+    {"FSGS", 0.88, 0.02},
+    {"GS", 0.93, 0.02},
+    {"MSGS", 0.96, 0.02},
+    {"MSFS", 0.93, 0.02},
+    {"MS", 0.96, 0.02},
+    {"SS", 0.93, 0.02},
+    {"SL2", 0.76, 0.06},
+    {"SL3", 0.65, 0.10},
+    {"SL4", 0.60, 0.14},
+    {"SLU", 0.43, 0.12},
+    {"ST2", 0.84, 0.11},
+    {"ST3", 0.71, 0.21},
+    {"SU2", 0.80, 0.02},
+    {"SU3", 0.63, 0.04},
+    {"SU4", 0.56, 0.04},
+    {"LS2", 0.34, 0.21},
+    {"LS3", 0.44, 0.21},
+    {"LS4", 0.56, 0.21},
+    {"LT2", 0.30, 0.30},
+    {"LT3", 0.20, 0.40},
+    {"LTS", 0.42, 0.35},
+    {"LU", 0.19, 0.23},
+    {"UU", 0.10, 0.04},
+    {"ULS", 0.30, 0.12},
+    {"US", 0.31, 0.04},
+    {"UT2", 0.13, 0.10},
+    {"UT3", 0.11, 0.14},
+    {"UT4", 0.09, 0.21},
+    {"UTL", 0.19, 0.23},
+    {"TT", 0.17, 0.82},
+    {"TL", 0.17, 0.55},
+    {"TU2", 0.12, 0.55},
+    {"TU3", 0.10, 0.37},
+    {"TS3", 0.52, 0.40},
+    {"TS2", 0.37, 0.55},
+    {"TS4", 0.62, 0.30},
+    {"TU4", 0.05, 0.30},
+    {"L", 0.35, 0.31},
+    {"S", 0.93, 0.02},
+    {"U", 0.10, 0.04},
+    {"T", 0.17, 0.82},
+    {"HZ1", 0.30, 0.15},
+    {"HZ2", 0.30, 0.15},
+    {"HZ3", 0.30, 0.15},
+    {"HH", 0.15, 0.1},
+    {"HN", 0.15, 0.1},
+};
+
+const size_t noOfKA5Textures = sizeof(ka5TextureData) / sizeof(KA5TextureData) + 1;
+
+struct KA5Textures {
+  KA5Textures() {
+    // interned in table order, so the ids are the index + 1
+    names.intern("");
+    for (const auto& d : ka5TextureData) names.intern(d.name);
 
-  if (soilType == "FS") { x = 0.84; }
-  else if (soilType == "FSMS") { x = 0.86; }
-  else if (soilType == "FSGS") { x = 0.88; }
-  else if (soilType == "GS") { x = 0.93; }
-  else if (soilType == "MSGS") { x = 0.96; }
-  else if (soilType == "MSFS") { x = 0.93; }
-  else if (soilType == "MS") { x = 0.96; }
-  else if (soilType == "SS") { x = 0.93; }
-  else if (soilType == "SL2") { x = 0.76; }
-  else if (soilType == "SL3") { x = 0.65; }
-  else if (soilType == "SL4") { x = 0.60; }
-  else if (soilType == "SLU") { x = 0.43; }
-  else if (soilType == "ST2") { x = 0.84; }
-  else if (soilType == "ST3") { x = 0.71; }
-  else if (soilType == "SU2") { x = 0.80; }
-  else if (soilType == "SU3") { x = 0.63; }
-  else if (soilType == "SU4") { x = 0.56; }
-  else if (soilType == "LS2") { x = 0.34; }
-  else if (soilType == "LS3") { x = 0.44; }
-  else if (soilType == "LS4") { x = 0.56; }
-  else if (soilType == "LT2") { x = 0.30; }
-  else if (soilType == "LT3") { x = 0.20; }
-  else if (soilType == "LTS") { x = 0.42; }
-  else if (soilType == "LU") { x = 0.19; }
-  else if (soilType == "UU") { x = 0.10; }
-  else if (soilType == "ULS") { x = 0.30; }
-  else if (soilType == "US") { x = 0.31; }
-  else if (soilType == "UT2") { x = 0.13; }
-  else if (soilType == "UT3") { x = 0.11; }
-  else if (soilType == "UT4") { x = 0.09; }
-  else if (soilType == "UTL") { x = 0.19; }
-  else if (soilType == "TT") { x = 0.17; }
-  else if (soilType == "TL") { x = 0.17; }
-  else if (soilType == "TU2") { x = 0.12; }
-  else if (soilType == "TU3") { x = 0.10; }
-  else if (soilType == "TS3") { x = 0.52; }
-  else if (soilType == "TS2") { x = 0.37; }
-  else if (soilType == "TS4") { x = 0.62; }
-  else if (soilType == "TU4") { x = 0.05; }
-  else if (soilType == "L") { x = 0.35; }
-  else if (soilType == "S") { x = 0.93; }
-  else if (soilType == "U") { x = 0.10; }
-  else if (soilType == "T") { x = 0.17; }
-  else if (soilType == "HZ1") { x = 0.30; }
-  else if (soilType == "HZ2") { x = 0.30; }
-  else if (soilType == "HZ3") { x = 0.30; }
-  else if (soilType == "HH") { x = 0.15; }
-  else if (soilType == "HN") { x = 0.15; }
-  else {
-    x = 0.66;
-    res.errors.push_back(string("Soil::KA5texture2sand Unknown soil type: " + soilType + "!"));
+    for (int sand = 0; sand <= 100; sand++) {
+      for (int clay = 0; clay <= 100; clay++) {
+        auto texture = percentSandAndClayToKA5Texture(uint8_t(sand), uint8_t(clay));
+        sandAndClay2id[sand][clay] = KA5TextureId(names.id(texture));
+      }
+    }
   }
 
-  return res;
+  Tools::InternedKeys names;
+  //! [sand %][clay %]
+  KA5TextureId sandAndClay2id[101][101];
+};
+
+const KA5Textures& ka5Textures() {
+  static ImmutableRegistry<KA5Textures> registry;
+  return registry.get([]() { return KA5Textures(); });
 }
 
+//! the percentages as used by percentSandAndClayToKA5Texture
+inline KA5TextureId sandAndClay2KA5textureIdFromTable(const KA5Textures& ts, double sand, double clay) {
+  int s = int(sand * 100.0);
+  int c = int(clay * 100.0);
+  if (0 <= s && s <= 100 && 0 <= c && c <= 100) return ts.sandAndClay2id[s][c];
+  // outside of the table keep the (wrapping) behaviour of the branch based classification
+  return ka5TextureId(percentSandAndClayToKA5Texture(uint8_t(s), uint8_t(c)));
+}
+}
 
-EResult<double> Soil::KA5texture2clay(string soilType) {
-  EResult<double> res;
-  double &x = res.result;
-  soilType = Tools::toUpper(soilType);
+KA5TextureId Soil::ka5TextureId(const std::string& texture) {
+  const auto& ts = ka5Textures();
+  int id = ts.names.id(texture);
+  if (id < 0) id = ts.names.id(Tools::toUpper(texture));
+  return id < 0 ? unknownKA5TextureId : KA5TextureId(id);
+}
 
-  if (soilType == "FS") { x = 0.02; }
-  else if (soilType == "FSMS") { x = 0.02; }
-  else if (soilType == "FSGS") { x = 0.02; }
-  else if (soilType == "GS") { x = 0.02; }
-  else if (soilType == "MSGS") { x = 0.02; }
-  else if (soilType == "MSFS") { x = 0.02; }
-  else if (soilType == "MS") { x = 0.02; }
-  else if (soilType == "SS") { x = 0.02; }
-  else if (soilType == "SL2") { x = 0.06; }
-  else if (soilType == "SL3") { x = 0.10; }
-  else if (soilType == "SL4") { x = 0.14; }
-  else if (soilType == "SLU") { x = 0.12; }
-  else if (soilType == "ST2") { x = 0.11; }
-  else if (soilType == "ST3") { x = 0.21; }
-  else if (soilType == "SU2") { x = 0.02; }
-  else if (soilType == "SU3") { x = 0.04; }
-  else if (soilType == "SU4") { x = 0.04; }
-  else if (soilType == "LS2") { x = 0.21; }
-  else if (soilType == "LS3") { x = 0.21; }
-  else if (soilType == "LS4") { x = 0.21; }
-  else if (soilType == "LT2") { x = 0.30; }
-  else if (soilType == "LT3") { x = 0.40; }
-  else if (soilType == "LTS") { x = 0.35; }
-  else if (soilType == "LU") { x = 0.23; }
-  else if (soilType == "UU") { x = 0.04; }
-  else if (soilType == "ULS") { x = 0.12; }
-  else if (soilType == "US") { x = 0.04; }
-  else if (soilType == "UT2") { x = 0.10; }
-  else if (soilType == "UT3") { x = 0.14; }
-  else if (soilType == "UT4") { x = 0.21; }
-  else if (soilType == "UTL") { x = 0.23; }
-  else if (soilType == "TT") { x = 0.82; }
-  else if (soilType == "TL") { x = 0.55; }
-  else if (soilType == "TU2") { x = 0.55; }
-  else if (soilType == "TU3") { x = 0.37; }
-  else if (soilType == "TS3") { x = 0.40; }
-  else if (soilType == "TS2") { x = 0.55; }
-  else if (soilType == "TS4") { x = 0.30; }
-  else if (soilType == "TU4") { x = 0.30; }
-  else if (soilType == "L") { x = 0.31; }
-  else if (soilType == "S") { x = 0.02; }
-  else if (soilType == "U") { x = 0.04; }
-  else if (soilType == "T") { x = 0.82; }
-  else if (soilType == "HZ1") { x = 0.15; }
-  else if (soilType == "HZ2") { x = 0.15; }
-  else if (soilType == "HZ3") { x = 0.15; }
-  else if (soilType == "HH") { x = 0.1; }
-  else if (soilType == "HN") { x = 0.1; }
-  else {
-    x = 0.0;
-    res.errors.push_back(string("Soil::KA5texture2clay: Unknown soil type: " + soilType + "!"));
-  }
+const std::string& Soil::ka5TextureName(KA5TextureId id) {
+  return ka5Textures().names.key(id);
+}
 
-  return res;
+size_t Soil::noOfKA5TextureIds() {
+  return noOfKA5Textures;
+}
+
+KA5TextureId Soil::sandAndClay2KA5textureId(double sand, double clay) {
+  return sandAndClay2KA5textureIdFromTable(ka5Textures(), sand, clay);
+}
+
+void Soil::sandAndClay2KA5textureIds(const double* sand, const double* clay, size_t n, KA5TextureId* ids) {
+  const auto& ts = ka5Textures();
+  for (size_t i = 0; i < n; i++) ids[i] = sandAndClay2KA5textureIdFromTable(ts, sand[i], clay[i]);
+}
+
+std::vector<KA5TextureId> Soil::sandAndClay2KA5textureIds(const std::vector<double>& sand, const std::vector<double>& clay) {
+  std::vector<KA5TextureId> ids(min(sand.size(), clay.size()));
+  sandAndClay2KA5textureIds(sand.data(), clay.data(), ids.size(), ids.data());
+  return ids;
+}
+
+string Soil::sandAndClay2KA5texture(double sand, double clay) {
+  return ka5TextureName(sandAndClay2KA5textureId(sand, clay));
+}
+
+EResult<double> Soil::KA5textureId2sand(KA5TextureId id) {
+  if (0 < id && id < noOfKA5Textures) return ka5TextureData[id - 1].sand;
+  return {0.66, string("Soil::KA5texture2sand Unknown soil type id: " + to_string(int(id)) + "!")};
+}
+
+EResult<double> Soil::KA5textureId2clay(KA5TextureId id) {
+  if (0 < id && id < noOfKA5Textures) return ka5TextureData[id - 1].clay;
+  return {0.0, string("Soil::KA5texture2clay: Unknown soil type id: " + to_string(int(id)) + "!")};
+}
+
+EResult<double> Soil::KA5texture2sand(string soilType) {
+  soilType = Tools::toUpper(soilType);
+  auto id = ka5TextureId(soilType);
+  if (id != unknownKA5TextureId) return ka5TextureData[id - 1].sand;
+  return {0.66, string("Soil::KA5texture2sand Unknown soil type: " + soilType + "!")};
+}
+
+EResult<double> Soil::KA5texture2clay(string soilType) {
+  soilType = Tools::toUpper(soilType);
+  auto id = ka5TextureId(soilType);
+  if (id != unknownKA5TextureId) return ka5TextureData[id - 1].clay;
+  return {0.0, string("Soil::KA5texture2clay: Unknown soil type: " + soilType + "!")};
 }
@@ -18,6 +18,8 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #pragma once
 
 #include <string>
+#include <vector>
+#include <cstdint>
 
 #include "tools/helper.h"
 
@@ -40,6 +42,29 @@ Tools::EResult<double> bulkDensityClass2rawDensity(int bulkDensityClass, double
 
 double sandAndClay2lambda(double sand, double clay);
 
+//! dense id of a KA5 texture class, for tables and rasters of textures, fixed by the compiled in
+//! texture table (KA5SoilCharacteristics is indexed by it as well)
+typedef uint8_t KA5TextureId;
+//! no or unknown texture (the empty name)
+const KA5TextureId unknownKA5TextureId = 0;
+
+//! id of the (case insensitive) texture name, unknownKA5TextureId if unknown
+KA5TextureId ka5TextureId(const std::string& texture);
+
+//! upper case name of the texture id
+const std::string& ka5TextureName(KA5TextureId id);
+
+//! the ids are [0, noOfKA5TextureIds())
+size_t noOfKA5TextureIds();
+
+//! sand and clay [0 - 1], looked up in a precomputed [sand %][clay %] table
+KA5TextureId sandAndClay2KA5textureId(double sand, double clay);
+
+//! classify whole arrays (e.g. rasters) of sand and clay [0 - 1] into ids[0 .. n)
+void sandAndClay2KA5textureIds(const double* sand, const double* clay, size_t n, KA5TextureId* ids);
+
+std::vector<KA5TextureId> sandAndClay2KA5textureIds(const std::vector<double>& sand, const std::vector<double>& clay);
+
 //! sand and clay [0 - 1]
 std::string sandAndClay2KA5texture(double sand, double clay);
 
@@ -47,4 +72,8 @@ Tools::EResult<double> KA5texture2sand(std::string soilType);
 
 Tools::EResult<double> KA5texture2clay(std::string soilType);
 
+Tools::EResult<double> KA5textureId2sand(KA5TextureId id);
+
+Tools::EResult<double> KA5textureId2clay(KA5TextureId id);
+
 } //namespace Soil
@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+// compiles the soil parameter files (SoilCharacteristicData, SoilCharacteristicModifier,
+// CapillaryRiseRates) into a single soil parameter bundle, which worker processes
+// can load via Soil::useSoilParameterBundle
+
+#include <iostream>
+#include <string>
+
+#include "soil-bundle.h"
+#include "tools/helper.h"
+
+using namespace std;
+using namespace Soil;
+using namespace Tools;
+
+int main(int argc, char** argv)
+{
+  string pathToSoilDir = replaceEnvVars("${MONICA_PARAMETERS}/soil/");
+  string pathToBundle = "soil-parameters.bundle";
+
+  for(int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if(arg == "-soil-dir" && i + 1 < argc)
+      pathToSoilDir = argv[++i];
+    else if(arg == "-out" && i + 1 < argc)
+      pathToBundle = argv[++i];
+    else
+    {
+      cout << "usage: " << argv[0] << " [options]" << endl
+           << " -soil-dir path ... folder with the KA5 soil parameter and capillary rise rate files ("
+           << "${MONICA_PARAMETERS}/soil/)" << endl
+           << " -out path ... where to write the bundle (soil-parameters.bundle)" << endl;
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  const auto& ka5 = ka5SoilCharacteristics(pathToSoilDir);
+  const auto& crrs = readCapillaryRiseRates(pathToSoilDir);
+  if(crrs.size() == 0)
+  {
+    cerr << "No capillary rise rates found in " << pathToSoilDir << endl;
+    return 1;
+  }
+
+  auto es = writeSoilParameterBundle(pathToBundle, ka5, crrs);
+  if(printPossibleErrors(es, true))
+  {
+    cout << "wrote " << pathToBundle << " (version " << soilParameterBundleVersion << ", "
+         << noOfKA5TextureIds() - 1 << " KA5 textures, " << crrs.size() << " capillary rise soil types)" << endl;
+    return 0;
+  }
+
+  return 1;
+}
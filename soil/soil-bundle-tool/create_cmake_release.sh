@@ -0,0 +1,4 @@
+mkdir -p _cmake_release
+cd  _cmake_release
+cmake .. -DCMAKE_TOOLCHAIN_FILE=../../../../../vcpkg/scripts/buildsystems/vcpkg.cmake -DCMAKE_BUILD_TYPE=Release
+cd ..
\ No newline at end of file
@@ -0,0 +1,225 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include "soil-bundle.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <kj/filesystem.h>
+#include <kj/string.h>
+
+using namespace std;
+using namespace Tools;
+using namespace Soil;
+
+namespace {
+const char bundleMagic[8] = {'M', 'A', 'S', 'S', 'O', 'I', 'L', 'B'};
+typedef KA5SoilCharacteristics::ClassValues ClassValues;
+const size_t noOfKA5ValuesPerTexture = KA5SoilCharacteristics::noOfClassValuesPerTexture;
+
+uint64_t align8(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+kj::Path evalPath(const kj::Filesystem& fs, const string& path) {
+#ifdef _WIN32
+  return fs.getCurrentPath().evalWin32(path);
+#else
+  return fs.getCurrentPath().eval(path);
+#endif
+}
+
+struct ActiveBundle {
+  shared_ptr<const SoilParameterBundle> bundle;
+  bool tablesCreated{false};
+};
+
+mutex& activeBundleLockable() {
+  static mutex lockable;
+  return lockable;
+}
+
+ActiveBundle& activeBundle() {
+  static ActiveBundle ab;
+  return ab;
+}
+}
+
+Errors Soil::writeSoilParameterBundle(const std::string& pathToBundle,
+                                      const KA5SoilCharacteristics& ka5,
+                                      const CapillaryRiseRates& capillaryRiseRates) {
+  auto loadErrors = ka5.loadErrors();
+  if (loadErrors.failure()) return loadErrors;
+
+  const size_t noOfTextures = noOfKA5TextureIds();
+  const size_t noOfSoilTypes = capillaryRiseRates.size();
+  const size_t rowLength = capillaryRiseRates._rowLength;
+
+  SoilParameterBundleHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, bundleMagic, sizeof(h.magic));
+  h.version = soilParameterBundleVersion;
+  h.noOfTextures = uint32_t(noOfTextures);
+  h.noOfCapillaryRiseSoilTypes = uint32_t(noOfSoilTypes);
+  h.capillaryRiseRowLength = uint32_t(rowLength);
+  h.texturesOffset = align8(sizeof(h));
+  h.ka5Offset = align8(h.texturesOffset + noOfTextures * sizeof(SoilParameterBundleName));
+  h.capillaryRiseSoilTypesOffset =
+    align8(h.ka5Offset + noOfTextures * noOfKA5ValuesPerTexture * sizeof(ClassValues));
+  h.capillaryRiseRatesOffset = align8(h.capillaryRiseSoilTypesOffset + noOfSoilTypes * sizeof(SoilParameterBundleName));
+  h.size = h.capillaryRiseRatesOffset + noOfSoilTypes * rowLength * sizeof(double);
+
+  auto bytes = kj::heapArray<kj::byte>(h.size);
+  memset(bytes.begin(), 0, bytes.size());
+  memcpy(bytes.begin(), &h, sizeof(h));
+
+  auto writeName = [&](uint64_t offset, size_t i, const string& name) {
+    SoilParameterBundleName n;
+    memset(&n, 0, sizeof(n));
+    if (name.size() >= sizeof(n.name)) return false;
+    memcpy(n.name, name.data(), name.size());
+    memcpy(bytes.begin() + offset + i * sizeof(n), &n, sizeof(n));
+    return true;
+  };
+
+  for (size_t t = 0; t < noOfTextures; t++) {
+    const auto& texture = ka5TextureName(KA5TextureId(t));
+    if (!writeName(h.texturesOffset, t, texture)) {
+      return {kj::str("Soil texture name ", texture, " is too long for the bundle.").cStr()};
+    }
+  }
+  memcpy(bytes.begin() + h.ka5Offset, ka5.values(), noOfTextures * noOfKA5ValuesPerTexture * sizeof(ClassValues));
+
+  for (size_t st = 0; st < noOfSoilTypes; st++) {
+    if (!writeName(h.capillaryRiseSoilTypesOffset, st, capillaryRiseRates._soilTypes.key(int(st)))) {
+      return {kj::str("Soil type name ", capillaryRiseRates._soilTypes.key(int(st)), " is too long for the bundle.").cStr()};
+    }
+  }
+  memcpy(bytes.begin() + h.capillaryRiseRatesOffset, capillaryRiseRates.rates(),
+         noOfSoilTypes * rowLength * sizeof(double));
+
+  auto fs = kj::newDiskFilesystem();
+  auto path = evalPath(*fs, pathToBundle);
+  try {
+    // replace atomically, so running workers never map a half written bundle
+    auto replacer = fs->getRoot().replaceFile(path, kj::WriteMode::CREATE | kj::WriteMode::MODIFY
+                                                    | kj::WriteMode::CREATE_PARENT);
+    replacer->get().writeAll(bytes);
+    replacer->commit();
+  } catch (const kj::Exception& e) {
+    return {kj::str("Couldn't write soil parameter bundle ", path.toString(), " ! Exception: ",
+                    e.getDescription()).cStr()};
+  }
+
+  return {};
+}
+
+//------------------------------------------------------------------------------
+
+EResult<shared_ptr<SoilParameterBundle>> SoilParameterBundle::open(const std::string& pathToBundle) {
+  auto fs = kj::newDiskFilesystem();
+  auto path = evalPath(*fs, pathToBundle);
+  try {
+    KJ_IF_MAYBE(file, fs->getRoot().tryOpenFile(path)) {
+      auto size = (*file)->stat().size;
+      if (size < sizeof(SoilParameterBundleHeader)) {
+        return {nullptr, kj::str("Soil parameter bundle ", path.toString(), " is too small.").cStr()};
+      }
+      shared_ptr<SoilParameterBundle> bundle(new SoilParameterBundle((*file)->mmap(0, size)));
+
+      const auto& h = bundle->header();
+      if (memcmp(h.magic, bundleMagic, sizeof(h.magic)) != 0) {
+        return {nullptr, kj::str(path.toString(), " is no soil parameter bundle.").cStr()};
+      }
+      if (h.version != soilParameterBundleVersion) {
+        return {nullptr, kj::str("Soil parameter bundle ", path.toString(), " has version ", h.version,
+                                 " but version ", soilParameterBundleVersion, " is needed.").cStr()};
+      }
+      bool consistent = h.size == size
+        && h.texturesOffset + uint64_t(h.noOfTextures) * sizeof(SoilParameterBundleName) <= h.ka5Offset
+        && h.ka5Offset + uint64_t(h.noOfTextures) * noOfKA5ValuesPerTexture * sizeof(ClassValues)
+           <= h.capillaryRiseSoilTypesOffset
+        && h.capillaryRiseSoilTypesOffset + uint64_t(h.noOfCapillaryRiseSoilTypes) * sizeof(SoilParameterBundleName)
+           <= h.capillaryRiseRatesOffset
+        && h.capillaryRiseRatesOffset
+           + uint64_t(h.noOfCapillaryRiseSoilTypes) * h.capillaryRiseRowLength * sizeof(double) <= h.size;
+      if (!consistent) {
+        return {nullptr, kj::str("Soil parameter bundle ", path.toString(), " is corrupt.").cStr()};
+      }
+
+      // the KA5 values are used by KA5TextureId directly
+      bool sameTextures = h.noOfTextures == noOfKA5TextureIds();
+      const auto* names = bundle->at<SoilParameterBundleName>(h.texturesOffset);
+      for (size_t t = 0; sameTextures && t < h.noOfTextures; t++) {
+        string name(names[t].name, strnlen(names[t].name, sizeof(names[t].name)));
+        sameTextures = ka5TextureName(KA5TextureId(t)) == name;
+      }
+      if (!sameTextures) {
+        return {nullptr, kj::str("Soil parameter bundle ", path.toString(), " has been written with another KA5 "
+                                 "texture table, it has to be written again.").cStr()};
+      }
+
+      return bundle;
+    }
+  } catch (const kj::Exception& e) {
+    return {nullptr, kj::str("Couldn't map soil parameter bundle ", path.toString(), " ! Exception: ",
+                             e.getDescription()).cStr()};
+  }
+
+  return {nullptr, kj::str("Couldn't open soil parameter bundle ", path.toString(), ".").cStr()};
+}
+
+KA5SoilCharacteristics SoilParameterBundle::ka5SoilCharacteristics() const {
+  KA5SoilCharacteristics ka5;
+  ka5._mapped = at<ClassValues>(header().ka5Offset);
+  ka5._mapping = shared_from_this();
+  return ka5;
+}
+
+CapillaryRiseRates SoilParameterBundle::capillaryRiseRates() const {
+  CapillaryRiseRates crrs;
+  const auto& h = header();
+  const auto* names = at<SoilParameterBundleName>(h.capillaryRiseSoilTypesOffset);
+  for (size_t st = 0; st < h.noOfCapillaryRiseSoilTypes; st++) {
+    crrs._soilTypes.intern(string(names[st].name, strnlen(names[st].name, sizeof(names[st].name))));
+  }
+  crrs._rowLength = h.capillaryRiseRowLength;
+  crrs._mapped = at<double>(h.capillaryRiseRatesOffset);
+  crrs._mapping = shared_from_this();
+  return crrs;
+}
+
+//------------------------------------------------------------------------------
+
+Errors Soil::useSoilParameterBundle(const std::string& pathToBundle) {
+  auto res = SoilParameterBundle::open(pathToBundle);
+  if (res.success()) {
+    lock_guard<mutex> lock(activeBundleLockable());
+    // the tables don't change anymore once they have been created, silently ignoring the bundle would be wrong
+    if (activeBundle().tablesCreated) {
+      return {kj::str("Soil parameter bundle ", pathToBundle, " can't be used anymore, the soil parameter "
+                      "tables have already been created.").cStr()};
+    }
+    activeBundle().bundle = res.result;
+  }
+  return res;
+}
+
+shared_ptr<const SoilParameterBundle> Soil::soilParameterBundleForTables() {
+  lock_guard<mutex> lock(activeBundleLockable());
+  activeBundle().tablesCreated = true;
+  return activeBundle().bundle;
+}
@@ -0,0 +1,89 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "kj/array.h"
+
+#include "soil.h"
+
+namespace Soil {
+
+//! increase on every change of the binary layout below
+const uint32_t soilParameterBundleVersion = 2;
+
+//! Layout of a soil parameter bundle (native byte order, all offsets 8 byte aligned):
+//! header | texture names | KA5 values | capillary rise soil types | capillary rise rates
+//! The KA5 values are indexed by KA5TextureId, the names are only there to check that the bundle
+//! has been written with the same KA5 texture table.
+struct SoilParameterBundleHeader {
+  char magic[8]; //!< "MASSOILB"
+  uint32_t version;
+  uint32_t noOfTextures; //!< = noOfKA5TextureIds()
+  uint32_t noOfCapillaryRiseSoilTypes;
+  uint32_t capillaryRiseRowLength; //!< number of distances per soil type
+  uint64_t texturesOffset; //!< noOfTextures names
+  uint64_t ka5Offset; //!< noOfTextures x KA5SoilCharacteristics::noOfClassValuesPerTexture ClassValues
+  uint64_t capillaryRiseSoilTypesOffset; //!< noOfCapillaryRiseSoilTypes names
+  uint64_t capillaryRiseRatesOffset; //!< noOfCapillaryRiseSoilTypes x capillaryRiseRowLength doubles
+  uint64_t size; //!< of the whole bundle
+};
+
+struct SoilParameterBundleName {
+  char name[16]; //!< zero terminated
+};
+
+//! write the KA5 tables and the capillary rise rates in their dense layout into a single file
+Tools::Errors writeSoilParameterBundle(const std::string& pathToBundle,
+                                       const KA5SoilCharacteristics& ka5,
+                                       const CapillaryRiseRates& capillaryRiseRates);
+
+//! a memory mapped soil parameter bundle, the tables read their values directly from the mapping
+//! (only the capillary rise soil type names are interned) and keep it alive
+class SoilParameterBundle : public std::enable_shared_from_this<SoilParameterBundle> {
+public:
+  static Tools::EResult<std::shared_ptr<SoilParameterBundle>> open(const std::string& pathToBundle);
+
+  KA5SoilCharacteristics ka5SoilCharacteristics() const;
+
+  CapillaryRiseRates capillaryRiseRates() const;
+
+private:
+  SoilParameterBundle(kj::Array<const kj::byte> mapping) : _mapping(kj::mv(mapping)) {}
+
+  const SoilParameterBundleHeader& header() const {
+    return *reinterpret_cast<const SoilParameterBundleHeader*>(_mapping.begin());
+  }
+
+  template<typename T>
+  const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(_mapping.begin() + offset); }
+
+  kj::Array<const kj::byte> _mapping;
+};
+
+//! Use the bundle instead of the parameter files for ka5SoilCharacteristics and readCapillaryRiseRates.
+//! Has to be called before their first use, e.g. at the start of a worker process, afterwards it fails.
+Tools::Errors useSoilParameterBundle(const std::string& pathToBundle);
+
+//! the bundle set via useSoilParameterBundle or null, for creating the tables,
+//! from then on useSoilParameterBundle fails
+std::shared_ptr<const SoilParameterBundle> soilParameterBundleForTables();
+
+} // namespace Soil
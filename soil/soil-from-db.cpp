@@ -22,6 +22,10 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <set>
 #include <utility>
 #include <mutex>
+#include <cstdlib>
+#include <algorithm>
+
+#include <kj/string.h>
 
 #include "../tools/algorithms.h"
 #include "../../../../util/db/abstract-db-connections.h"
@@ -36,39 +40,36 @@ using namespace Db;
 using namespace Tools;
 using namespace json11;
 
-json11::Json Soil::jsonSoilParameters(DBPtr con,
-																			int profileId)
+namespace
 {
-	DBRow row;
-
-	enum { 
-		id = 0, 
-		layer_depth, 
+	//! columns of the soil_profile table, in the order of soilProfileColumns
+	enum
+	{
+		id = 0,
+		layer_depth,
 		soil_organic_carbon,
 		soil_organic_matter,
-		bulk_density, 
+		bulk_density,
 		raw_density,
 		sand,
-		clay, 
-		ph, 
-		KA5_texture_class, 
-		permanent_wilting_point, 
-		field_capacity, 
-		saturation, 
-		soil_water_conductivity_coefficient, 
-		sceleton, 
-		soil_ammonium, 
-		soil_nitrate, 
-		c_n, 
+		clay,
+		ph,
+		KA5_texture_class,
+		permanent_wilting_point,
+		field_capacity,
+		saturation,
+		soil_water_conductivity_coefficient,
+		sceleton,
+		soil_ammonium,
+		soil_nitrate,
+		c_n,
 		initial_soil_moisture ,
 		layer_description,
 		is_in_groundwater,
 		is_impenetrable
 	};
 
-	ostringstream oss;
-	oss <<
-		"select "
+	const char* soilProfileColumns =
 		"id, "
 		"layer_depth, "
 		"soil_organic_carbon, "
@@ -90,7 +91,17 @@ json11::Json Soil::jsonSoilParameters(DBPtr con,
 		"initial_soil_moisture, "
 		"layer_description, "
 		"is_in_groundwater, "
-		"is_impenetrable "
+		"is_impenetrable ";
+}
+
+json11::Json Soil::jsonSoilParameters(DBPtr con,
+																			int profileId)
+{
+	DBRow row;
+
+	ostringstream oss;
+	oss <<
+		"select " << soilProfileColumns <<
 		"from soil_profile "
 		"where id = " << profileId << " "
 		"order by id, layer_depth";
@@ -225,3 +236,228 @@ SoilPMsPtr Soil::soilParameters(const string& abstractDbSchema,
 }
 
 //------------------------------------------------------------------------------
+
+namespace
+{
+	//! like stof, but without exceptions and the detour over float, false if the column is empty
+	bool parseDouble(const string& column, double& value)
+	{
+		if(column.empty())
+			return false;
+		char* end = nullptr;
+		value = strtod(column.c_str(), &end);
+		return end != column.c_str();
+	}
+
+	//! map a soil_profile row directly into the (not yet validated) layer, same units as the json path
+	bool setLayer(const DBRow& row, double prevDepth, SoilParameters& sps)
+	{
+		double v = 0;
+		bool hasThickness = parseDouble(row[layer_depth], v);
+		if(hasThickness)
+			sps.thickness = v - prevDepth;
+
+		sps.vs_SoilTexture = row[KA5_texture_class];
+
+		bool hasSand = parseDouble(row[sand], v);
+		if(hasSand)
+			sps.vs_SoilSandContent = v / 100.0;
+
+		bool hasClay = parseDouble(row[clay], v);
+		if(hasClay)
+			sps.vs_SoilClayContent = v / 100.0;
+
+		if(parseDouble(row[ph], v))
+			sps.vs_SoilpH = v;
+
+		if(parseDouble(row[sceleton], v))
+			sps.vs_SoilStoneContent = v / 100.0;
+
+		bool hasOrganic = true;
+		if(parseDouble(row[soil_organic_carbon], v))
+			sps.set_vs_SoilOrganicCarbon(v / 100.0);
+		else if(parseDouble(row[soil_organic_matter], v))
+			sps.set_vs_SoilOrganicMatter(v / 100.0);
+		else
+			hasOrganic = false;
+
+		bool hasDensity = true;
+		if(parseDouble(row[bulk_density], v))
+			sps.set_vs_SoilBulkDensity(v);
+		else if(parseDouble(row[raw_density], v))
+			sps.set_vs_SoilRawDensity(v);
+		else
+			hasDensity = false;
+
+		bool hasFc = parseDouble(row[field_capacity], v);
+		if(hasFc)
+			sps.vs_FieldCapacity = v / 100.0;
+
+		bool hasPwp = parseDouble(row[permanent_wilting_point], v);
+		if(hasPwp)
+			sps.vs_PermanentWiltingPoint = v / 100.0;
+
+		bool hasSat = parseDouble(row[saturation], v);
+		if(hasSat)
+			sps.vs_Saturation = v / 100.0;
+
+		if(parseDouble(row[initial_soil_moisture], v))
+			sps.vs_SoilMoisturePercentFC = v;
+
+		bool hasLambda = parseDouble(row[soil_water_conductivity_coefficient], v);
+		if(hasLambda)
+			sps.vs_Lambda = v;
+
+		if(parseDouble(row[soil_ammonium], v))
+			sps.vs_SoilAmmonium = v;
+
+		if(parseDouble(row[soil_nitrate], v))
+			sps.vs_SoilNitrate = v;
+
+		if(parseDouble(row[c_n], v))
+			sps.vs_Soil_CN_Ratio = v;
+
+		//same completeness check as in jsonSoilParameters
+		return hasThickness
+			&& hasOrganic
+			&& hasDensity
+			&& (!sps.vs_SoilTexture.empty()
+					|| (hasSand && hasClay)
+					|| (hasPwp && hasFc && hasSat && hasLambda));
+	}
+
+	//! max number of ids in one "where id in (...)" query
+	const size_t maxIdsPerQuery = 1000;
+}
+
+EResult<map<int, SoilPMsPtr>>
+Soil::soilParameters(DBPtr con,
+										 const vector<int>& profileIds,
+										 const function<Errors(SoilParameters*)>& setPwpFcSat)
+{
+	EResult<map<int, SoilPMsPtr>> res;
+	auto& profiles = res.result;
+
+	auto loadRows = [&](const string& whereClause)
+	{
+		ostringstream oss;
+		oss <<
+			"select " << soilProfileColumns <<
+			"from soil_profile " <<
+			whereClause <<
+			"order by id, layer_depth";
+		con->select(oss.str());
+
+		DBRow row;
+		int currentId = -1;
+		SoilPMsPtr current;
+		double prevDepth = 0;
+		while(!(row = con->getRow()).empty())
+		{
+			int profileId = satoi(row[id]);
+			if(profileId != currentId || !current)
+			{
+				currentId = profileId;
+				current = make_shared<SoilPMs>();
+				profiles[profileId] = current;
+				prevDepth = 0;
+			}
+
+			SoilParameters sps(setPwpFcSat);
+			bool layerIsOk = setLayer(row, prevDepth, sps);
+			double depth = 0;
+			if(parseDouble(row[layer_depth], depth))
+				prevDepth = depth;
+
+			if(!layerIsOk)
+			{
+				debug() << "Layer at depth: " << row[layer_depth] << " of profile: " << profileId
+								<< " is incomplete. Skipping it!" << endl;
+				continue;
+			}
+
+			auto es = sps.setDerivedValuesAndValidate();
+			if(es.failure())
+				res.appendError(kj::str("Profile ", profileId, ":").cStr());
+			res.append(es);
+			current->push_back(sps);
+		}
+	};
+
+	if(profileIds.empty())
+		loadRows("");
+	else
+	{
+		for(size_t i = 0, size = profileIds.size(); i < size; i += maxIdsPerQuery)
+		{
+			ostringstream where;
+			where << "where id in (";
+			for(size_t k = i, end = min(size, i + maxIdsPerQuery); k < end; k++)
+				where << (k > i ? ", " : "") << profileIds[k];
+			where << ") ";
+			loadRows(where.str());
+		}
+	}
+
+	return res;
+}
+
+//------------------------------------------------------------------------------
+
+Errors SoilProfileCache::preload(const vector<int>& profileIds)
+{
+	vector<int> missing;
+	{
+		lock_guard<mutex> lock(_lockable);
+		for(int id : profileIds)
+			if(_profiles.find(id) == _profiles.end())
+				missing.push_back(id);
+	}
+	if(missing.empty())
+		return {};
+
+	//load outside the lock, a concurrently loaded profile is just replaced by the same data
+	auto res = Soil::soilParameters(DBPtr(newConnection(_abstractDbSchema)), missing, _setPwpFcSat);
+
+	//a profile is only known not to exist if the load didn't fail,
+	//otherwise it isn't cached, so the next lookup tries (and reports) again
+	lock_guard<mutex> lock(_lockable);
+	for(int id : missing)
+	{
+		auto ci = res.result.find(id);
+		if(ci != res.result.end())
+			_profiles[id] = ci->second;
+		else if(!res.failure())
+			_profiles[id] = SoilPMsPtr();
+	}
+
+	return res;
+}
+
+SoilPMsPtr SoilProfileCache::soilParameters(int profileId)
+{
+	{
+		lock_guard<mutex> lock(_lockable);
+		auto ci = _profiles.find(profileId);
+		if(ci != _profiles.end())
+			return ci->second;
+	}
+
+	auto es = preload({profileId});
+	if(es.failure())
+	{
+		cerr << "Error while reading soil parameters for profileId: " << profileId << "! Errors: " << endl;
+		for(auto e : es.errors)
+			cerr << e << endl;
+	}
+
+	lock_guard<mutex> lock(_lockable);
+	auto ci = _profiles.find(profileId);
+	return ci == _profiles.end() ? SoilPMsPtr() : ci->second;
+}
+
+size_t SoilProfileCache::size() const
+{
+	lock_guard<mutex> lock(_lockable);
+	return _profiles.size();
+}
@@ -16,6 +16,9 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #pragma once
 
 #include <string>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "soil.h"
 #include "../../../../util/db/db.h"
@@ -26,4 +29,35 @@ namespace Soil {
     json11::Json jsonSoilParameters(const std::string& abstractDbSchema, int profileId);
     Soil::SoilPMsPtr soilParameters(Db::DBPtr dbConnection, int profileId);
     Soil::SoilPMsPtr soilParameters(const std::string& abstractDbSchema, int profileId);
+
+    //! load many profiles with few queries (all profiles in one scan if profileIds is empty),
+    //! the typed columns are mapped directly into SoilParameters, without the json round trip
+    Tools::EResult<std::map<int, Soil::SoilPMsPtr>>
+    soilParameters(Db::DBPtr dbConnection,
+                   const std::vector<int>& profileIds,
+                   const std::function<Tools::Errors(SoilParameters*)>& setPwpFcSat = noSetPwpFcSat);
+
+    //! soil profiles cached by id, not yet cached profiles are loaded in bulk
+    class SoilProfileCache
+    {
+    public:
+        SoilProfileCache(const std::string& abstractDbSchema,
+                         std::function<Tools::Errors(SoilParameters*)> setPwpFcSat = noSetPwpFcSat)
+            : _abstractDbSchema(abstractDbSchema), _setPwpFcSat(setPwpFcSat) {}
+
+        //! load all not yet cached profiles with bulk queries
+        Tools::Errors preload(const std::vector<int>& profileIds);
+
+        //! the cached profile, loads it if necessary, null if the profile doesn't exist
+        //! or couldn't be loaded (which is not cached, but tried again on the next call)
+        Soil::SoilPMsPtr soilParameters(int profileId);
+
+        size_t size() const;
+
+    private:
+        std::string _abstractDbSchema;
+        std::function<Tools::Errors(SoilParameters*)> _setPwpFcSat;
+        mutable std::mutex _lockable;
+        std::map<int, Soil::SoilPMsPtr> _profiles; //!< null = known not to exist (loaded without errors)
+    };
 }
@@ -17,13 +17,13 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 */
 
 #include "soil.h"
+#include "soil-bundle.h"
 
 #include <map>
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <utility>
-#include <mutex>
 
 #include <capnp/message.h>
 #include <capnp/serialize.h>
@@ -34,6 +34,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include "model/monica/soil_params.capnp.h"
 
 #include "tools/algorithms.h"
+#include "tools/immutable-registry.h"
 #include "conversion.h"
 #include "tools/debug.h"
 #include "constants.h"
@@ -122,6 +123,13 @@ Errors SoilParameters::merge(json11::Json j) {
   set_double_value(_vs_SoilOrganicMatter, j, "SoilOrganicMatter",
                    transformIfPercent(j, "SoilOrganicMatter"));
 
+  es.append(setDerivedValuesAndValidate());
+  return es;
+}
+
+Errors SoilParameters::setDerivedValuesAndValidate() {
+  Errors es;
+
   auto st = vs_SoilTexture;
   // use internally just uppercase chars
   vs_SoilTexture = Tools::toUpper(vs_SoilTexture);
@@ -233,74 +241,79 @@ json11::Json SoilParameters::to_json() const {
 }
 
 void CapillaryRiseRates::addRate(const std::string& soilType, size_t distance, double value) {
-  //    std::cout << "Add cap rate: " << bodart.c_str() << "\tdist: " << distance << "\tvalue: " << value << std::endl;
-  //cap_rates_map.insert(std::pair<std::string,std::map<int,double> >(bodart,std::pair<int,double>(distance,value)));
-  capillaryRiseRates[soilType][distance] = value;
+  size_t h = _soilTypes.intern(soilType);
+  if (distance >= _rowLength) {
+    // widen all rows, only happens while loading
+    size_t rowLength = distance + 1;
+    size_t noOfRows = _rowLength > 0 ? _ownRates.size() / _rowLength : 0;
+    std::vector<double> rates(noOfRows * rowLength, 0.0);
+    for (size_t r = 0; r < noOfRows; r++) {
+      auto row = _ownRates.begin() + r * _rowLength;
+      copy(row, row + _rowLength, rates.begin() + r * rowLength);
+    }
+    _ownRates.swap(rates);
+    _rowLength = rowLength;
+  }
+  if ((h + 1) * _rowLength > _ownRates.size()) _ownRates.resize((h + 1) * _rowLength, 0.0);
+  _ownRates[h * _rowLength + distance] = value;
 }
 
-/**
-   * Returns capillary rise rate for given soil type and distance to ground water.
-   */
-double CapillaryRiseRates::getRate(const std::string& soilType, size_t distance) const {
-  auto it = capillaryRiseRates.find(soilType);
-  if (it == capillaryRiseRates.end()) {
-    it = capillaryRiseRates.find(soilType.substr(0, 3));
-    if (it == capillaryRiseRates.end()) {
-      it = capillaryRiseRates.find(soilType.substr(0, 2));
-      if (it == capillaryRiseRates.end()) return 0.0;
-    }
+CapillaryRiseRates::Handle CapillaryRiseRates::handle(const std::string& soilType) const {
+  Handle h = _soilTypes.id(soilType);
+  if (h < 0) {
+    h = _soilTypes.id(soilType.substr(0, 3));
+    if (h < 0) h = _soilTypes.id(soilType.substr(0, 2));
   }
-  auto it2 = it->second.find(distance);
-  if (it2 == it->second.end()) return 0.0;
-  return it2->second;
+  return h;
 }
 
 const CapillaryRiseRates& Soil::readCapillaryRiseRates() {
-  static mutex lockable;
-  static bool initialized = false;
-  static CapillaryRiseRates cap_rates;
+#ifdef _WIN32
+  return readCapillaryRiseRates(replaceEnvVars("${MONICA_PARAMETERS}\\soil\\"));
+#else
+  return readCapillaryRiseRates(replaceEnvVars("${MONICA_PARAMETERS}/soil/"));
+#endif
+}
 
-  if (!initialized) {
-    lock_guard<mutex> lock(lockable);
+const CapillaryRiseRates& Soil::readCapillaryRiseRates(const std::string& pathToSoilDir) {
+  static ImmutableRegistry<CapillaryRiseRates> registry;
+  return registry.get([&]() {
+    if (auto bundle = soilParameterBundleForTables()) return bundle->capillaryRiseRates();
 
-    if (!initialized) {
-      auto cacheAllData = [](mas::schema::soil::CapillaryRiseRate::Reader data) {
-        for (const auto& scd : data.getList()) {
-          cap_rates.addRate(Tools::toUpper(scd.getSoilType()), scd.getDistance(), scd.getRate());
-        }
-      };
+    CapillaryRiseRates cap_rates;
+    auto cacheAllData = [&](mas::schema::soil::CapillaryRiseRate::Reader data) {
+      for (const auto& scd : data.getList()) {
+        cap_rates.addRate(Tools::toUpper(scd.getSoilType()), scd.getDistance(), scd.getRate());
+      }
+    };
 
-      auto fs = kj::newDiskFilesystem();
+    auto fs = kj::newDiskFilesystem();
 #ifdef _WIN32
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(replaceEnvVars("${MONICA_PARAMETERS}\\soil\\"));
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(pathToSoilDir);
 #else
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(replaceEnvVars("${MONICA_PARAMETERS}/soil/"));
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(pathToSoilDir);
 #endif
-      try {
-        KJ_IF_MAYBE(file, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("CapillaryRiseRates.sercapnp"))) {
-          auto allBytes = (*file)->readAllBytes();
-          kj::ArrayInputStream aios(allBytes);
-          capnp::InputStreamMessageReader message(aios);
-          cacheAllData(message.getRoot<mas::schema::soil::CapillaryRiseRate>());
-        } else
-          KJ_IF_MAYBE(file2, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("CapillaryRiseRates.json"))) {
-            capnp::JsonCodec json;
-            capnp::MallocMessageBuilder msg;
-            auto builder = msg.initRoot<mas::schema::soil::CapillaryRiseRate>();
-            json.decode((*file2)->readAllBytes().asChars(), builder);
-            cacheAllData(builder.asReader());
-          }
-
-        initialized = true;
-      } catch (const kj::Exception& e) {
-        cout << "Error: couldn't read CapillaryRiseRates.sercapnp or CapillaryRiseRates.json from folder "
-          << pathToMonicaParamsSoil.toString().cStr() << " ! Exception: " << e.getDescription().cStr() << endl;
-      }
-      initialized = true;
+    try {
+      KJ_IF_MAYBE(file, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("CapillaryRiseRates.sercapnp"))) {
+        auto allBytes = (*file)->readAllBytes();
+        kj::ArrayInputStream aios(allBytes);
+        capnp::InputStreamMessageReader message(aios);
+        cacheAllData(message.getRoot<mas::schema::soil::CapillaryRiseRate>());
+      } else
+        KJ_IF_MAYBE(file2, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("CapillaryRiseRates.json"))) {
+          capnp::JsonCodec json;
+          capnp::MallocMessageBuilder msg;
+          auto builder = msg.initRoot<mas::schema::soil::CapillaryRiseRate>();
+          json.decode((*file2)->readAllBytes().asChars(), builder);
+          cacheAllData(builder.asReader());
+        }
+    } catch (const kj::Exception& e) {
+      cout << "Error: couldn't read CapillaryRiseRates.sercapnp or CapillaryRiseRates.json from folder "
+        << pathToMonicaParamsSoil.toString().cStr() << " ! Exception: " << e.getDescription().cStr() << endl;
     }
-  }
 
-  return cap_rates;
+    return cap_rates;
+  });
 }
 
 bool SoilParameters::isValid() const {
@@ -480,68 +493,76 @@ struct RPSCDRes {
   bool unset{true};
 };
 
-EResult<RPSCDRes> readPrincipalSoilCharacteristicData(const std::string& pathToSoilDir, const string& soilType,
-                                                      double rawDensity) {
-  static mutex lockable;
+//! soil type -> raw density or organic matter class -> values, plus possible loading errors
+struct LoadedSoilCharacteristics {
   typedef map<int, RPSCDRes> M1;
   typedef map<string, M1> M2;
-  static M2 m;
-  static bool initialized = false;
-  static Errors errors;
-  if (!initialized) {
-    lock_guard<mutex> lock(lockable);
-
-    if (!initialized) {
-      auto cacheAllData = [](mas::schema::soil::SoilCharacteristicData::Reader data) {
-        for (const auto& scd : data.getList()) {
-          const double ac = scd.getAirCapacity();
-          const double fc = scd.getFieldCapacity();
-          const double nfc = scd.getNFieldCapacity();
-
-          RPSCDRes r;
-          r.sat = ac + fc;
-          r.fc = fc;
-          r.pwp = fc - nfc;
-          r.unset = false;
-
-          m[Tools::toUpper(scd.getSoilType())][int(scd.getSoilRawDensity() / 100.0)] = r;
-        }
-      };
+  M2 m;
+  Errors errors;
+};
+
+const LoadedSoilCharacteristics& loadPrincipalSoilCharacteristicData(const std::string& pathToSoilDir) {
+  static ImmutableRegistry<LoadedSoilCharacteristics> registry;
+  return registry.get([&]() {
+    LoadedSoilCharacteristics lsc;
+    auto& m = lsc.m;
+    auto& errors = lsc.errors;
+    auto cacheAllData = [&](mas::schema::soil::SoilCharacteristicData::Reader data) {
+      for (const auto& scd : data.getList()) {
+        const double ac = scd.getAirCapacity();
+        const double fc = scd.getFieldCapacity();
+        const double nfc = scd.getNFieldCapacity();
+
+        RPSCDRes r;
+        r.sat = ac + fc;
+        r.fc = fc;
+        r.pwp = fc - nfc;
+        r.unset = false;
+
+        m[Tools::toUpper(scd.getSoilType())][int(scd.getSoilRawDensity() / 100.0)] = r;
+      }
+    };
 
-      auto fs = kj::newDiskFilesystem();
+    auto fs = kj::newDiskFilesystem();
 #ifdef _WIN32
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(pathToSoilDir);
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(pathToSoilDir);
 #else
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(pathToSoilDir);
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(pathToSoilDir);
 #endif
-      try {
-        KJ_IF_MAYBE(file, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicData.sercapnp"))) {
-          auto allBytes = (*file)->readAllBytes();
-          kj::ArrayInputStream aios(allBytes);
-          capnp::InputStreamMessageReader message(aios);
-          cacheAllData(message.getRoot<mas::schema::soil::SoilCharacteristicData>());
-        } else
-          KJ_IF_MAYBE(file2,
-                    fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicData.json"))) {
-            capnp::JsonCodec json;
-            capnp::MallocMessageBuilder msg;
-            auto builder = msg.initRoot<mas::schema::soil::SoilCharacteristicData>();
-            json.decode((*file2)->readAllBytes().asChars(), builder);
-            cacheAllData(builder.asReader());
-          } else {
-            errors.
-              appendError(kj::str("Wessolek2009: Could neither load SoilCharacteristicData.sercapnp nor SoilCharacteristicData.json from folder ",
-                                  pathToMonicaParamsSoil.toString(), ". No PWP, FC, SAT calculation possible!").cStr());
-          }
-
-        initialized = true;
-      } catch (const kj::Exception& e) {
-        errors.
-          appendError(kj::str("Wessolek2009: Couldn't read SoilCharacteristicData.sercapnp nor SoilCharacteristicData.json from folder ",
-                              pathToMonicaParamsSoil.toString(), " ! Exception: ", e.getDescription()).cStr());
-      }
+    try {
+      KJ_IF_MAYBE(file, fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicData.sercapnp"))) {
+        auto allBytes = (*file)->readAllBytes();
+        kj::ArrayInputStream aios(allBytes);
+        capnp::InputStreamMessageReader message(aios);
+        cacheAllData(message.getRoot<mas::schema::soil::SoilCharacteristicData>());
+      } else
+        KJ_IF_MAYBE(file2,
+                  fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicData.json"))) {
+          capnp::JsonCodec json;
+          capnp::MallocMessageBuilder msg;
+          auto builder = msg.initRoot<mas::schema::soil::SoilCharacteristicData>();
+          json.decode((*file2)->readAllBytes().asChars(), builder);
+          cacheAllData(builder.asReader());
+        } else {
+          errors.
+            appendError(kj::str("Wessolek2009: Could neither load SoilCharacteristicData.sercapnp nor SoilCharacteristicData.json from folder ",
+                                pathToMonicaParamsSoil.toString(), ". No PWP, FC, SAT calculation possible!").cStr());
+        }
+    } catch (const kj::Exception& e) {
+      errors.
+        appendError(kj::str("Wessolek2009: Couldn't read SoilCharacteristicData.sercapnp nor SoilCharacteristicData.json from folder ",
+                            pathToMonicaParamsSoil.toString(), " ! Exception: ", e.getDescription()).cStr());
     }
-  }
+
+    return lsc;
+  });
+}
+
+EResult<RPSCDRes> readPrincipalSoilCharacteristicData(const std::string& pathToSoilDir, const string& soilType,
+                                                      double rawDensity) {
+  typedef LoadedSoilCharacteristics::M1 M1;
+  const auto& lsc = loadPrincipalSoilCharacteristicData(pathToSoilDir);
+  const auto& m = lsc.m;
 
   auto ci = m.find(soilType);
   if (ci != m.end()) {
@@ -561,72 +582,71 @@ EResult<RPSCDRes> readPrincipalSoilCharacteristicData(const std::string& pathToS
                                                      " and raw density ", rawDensity).cStr());
   }
 
-  return {{}, errors};
+  return {{}, lsc.errors};
 }
 
-EResult<RPSCDRes> readSoilCharacteristicModifier(const std::string& pathToSoilDir, const string& soilType,
-                                                 double organicMatter) {
-  static mutex lockable;
-  typedef map<int, RPSCDRes> M1;
-  typedef map<string, M1> M2;
-  static M2 m;
-  static bool initialized = false;
-  static Errors errors;
-  if (!initialized) {
-    lock_guard<mutex> lock(lockable);
-
-    if (!initialized) {
-      auto cacheAllData = [](mas::schema::soil::SoilCharacteristicModifier::Reader data) {
-        for (const auto& scd : data.getList()) {
-          const double ac = scd.getAirCapacity();
-          const double fc = scd.getFieldCapacity();
-          const double nfc = scd.getNFieldCapacity();
-
-          RPSCDRes r;
-          r.sat = ac + fc;
-          r.fc = fc;
-          r.pwp = fc - nfc;
-          r.unset = false;
-
-          m[Tools::toUpper(scd.getSoilType())][int(scd.getOrganicMatter() * 10)] = r;
-        }
-      };
+const LoadedSoilCharacteristics& loadSoilCharacteristicModifier(const std::string& pathToSoilDir) {
+  static ImmutableRegistry<LoadedSoilCharacteristics> registry;
+  return registry.get([&]() {
+    LoadedSoilCharacteristics lsc;
+    auto& m = lsc.m;
+    auto& errors = lsc.errors;
+    auto cacheAllData = [&](mas::schema::soil::SoilCharacteristicModifier::Reader data) {
+      for (const auto& scd : data.getList()) {
+        const double ac = scd.getAirCapacity();
+        const double fc = scd.getFieldCapacity();
+        const double nfc = scd.getNFieldCapacity();
+
+        RPSCDRes r;
+        r.sat = ac + fc;
+        r.fc = fc;
+        r.pwp = fc - nfc;
+        r.unset = false;
+
+        m[Tools::toUpper(scd.getSoilType())][int(scd.getOrganicMatter() * 10)] = r;
+      }
+    };
 
-      auto fs = kj::newDiskFilesystem();
+    auto fs = kj::newDiskFilesystem();
 #ifdef _WIN32
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(pathToSoilDir);
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().evalWin32(pathToSoilDir);
 #else
-      auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(pathToSoilDir);
+    auto pathToMonicaParamsSoil = fs->getCurrentPath().eval(pathToSoilDir);
 #endif
-      try {
-        KJ_IF_MAYBE(file,
-                    fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicModifier.sercapnp"))) {
-          auto allBytes = (*file)->readAllBytes();
-          kj::ArrayInputStream aios(allBytes);
-          capnp::InputStreamMessageReader message(aios);
-          cacheAllData(message.getRoot<mas::schema::soil::SoilCharacteristicModifier>());
-        } else
-          KJ_IF_MAYBE(file2, fs->getRoot().tryOpenFile(
-                      pathToMonicaParamsSoil.append("SoilCharacteristicModifier.json"))) {
-            capnp::JsonCodec json;
-            capnp::MallocMessageBuilder msg;
-            auto builder = msg.initRoot<mas::schema::soil::SoilCharacteristicModifier>();
-            json.decode((*file2)->readAllBytes().asChars(), builder);
-            cacheAllData(builder.asReader());
-          } else {
-            errors.
-              appendError(kj::str("Wessolek2009: Could neither load SoilCharacteristicModifier.sercapnp nor SoilCharacteristicModifier.json from folder ",
-                                  pathToMonicaParamsSoil.toString(), ". No PWP, FC, SAT calculation possible!").cStr());
-          }
-
-        initialized = true;
-      } catch (const kj::Exception& e) {
-        errors.
-          appendError(kj::str("Couldn't read SoilCharacteristicModifier.sercapnp nor SoilCharacteristicModifier.json from folder ",
-                              pathToMonicaParamsSoil.toString(), " ! Exception: ", e.getDescription()).cStr());
-      }
+    try {
+      KJ_IF_MAYBE(file,
+                  fs->getRoot().tryOpenFile(pathToMonicaParamsSoil.append("SoilCharacteristicModifier.sercapnp"))) {
+        auto allBytes = (*file)->readAllBytes();
+        kj::ArrayInputStream aios(allBytes);
+        capnp::InputStreamMessageReader message(aios);
+        cacheAllData(message.getRoot<mas::schema::soil::SoilCharacteristicModifier>());
+      } else
+        KJ_IF_MAYBE(file2, fs->getRoot().tryOpenFile(
+                    pathToMonicaParamsSoil.append("SoilCharacteristicModifier.json"))) {
+          capnp::JsonCodec json;
+          capnp::MallocMessageBuilder msg;
+          auto builder = msg.initRoot<mas::schema::soil::SoilCharacteristicModifier>();
+          json.decode((*file2)->readAllBytes().asChars(), builder);
+          cacheAllData(builder.asReader());
+        } else {
+          errors.
+            appendError(kj::str("Wessolek2009: Could neither load SoilCharacteristicModifier.sercapnp nor SoilCharacteristicModifier.json from folder ",
+                                pathToMonicaParamsSoil.toString(), ". No PWP, FC, SAT calculation possible!").cStr());
+        }
+    } catch (const kj::Exception& e) {
+      errors.
+        appendError(kj::str("Couldn't read SoilCharacteristicModifier.sercapnp nor SoilCharacteristicModifier.json from folder ",
+                            pathToMonicaParamsSoil.toString(), " ! Exception: ", e.getDescription()).cStr());
     }
-  }
+
+    return lsc;
+  });
+}
+
+EResult<RPSCDRes> readSoilCharacteristicModifier(const std::string& pathToSoilDir, const string& soilType,
+                                                 double organicMatter) {
+  const auto& lsc = loadSoilCharacteristicModifier(pathToSoilDir);
+  const auto& m = lsc.m;
 
   auto ci = m.find(Tools::toUpper(soilType));
   if (ci != m.end()) {
@@ -637,24 +657,94 @@ EResult<RPSCDRes> readSoilCharacteristicModifier(const std::string& pathToSoilDi
                                                      " and organic matter ", organicMatter).cStr());
   }
 
-  return {{}, errors};
+  return {{}, lsc.errors};
 }
 
-struct FcSatPwp {
-  double fc{0.0};
-  double sat{0.0};
-  double pwp{0.0};
-};
+}
 
-EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
-                                              std::string texture,
-                                              double stoneContent,
-                                              double soilRawDensity,
-                                              double soilOrganicMatter) {
-  debug() << "soilCharacteristicsKA5" << endl;
-  texture = Tools::toUpper(texture);
+//------------------------------------------------------------------------------
+
+const std::array<double, 6> KA5SoilCharacteristics::rawDensityClasses = {{-1, 1.1, 1.3, 1.5, 1.7, 1.9}};
+// class 0 means no modifier, as modifier values are given only for organic matter > 1.0% (class h2)
+const std::array<double, 5> KA5SoilCharacteristics::organicMatterClasses = {{0.0, 1.5, 3.0, 6.0, 11.5}};
+
+KA5SoilCharacteristics::KA5SoilCharacteristics(const std::string& pathToSoilDir) {
+  const auto& principal = loadPrincipalSoilCharacteristicData(pathToSoilDir);
+  const auto& modifier = loadSoilCharacteristicModifier(pathToSoilDir);
+
+  _principalLoadErrors = principal.errors;
+  _modifierLoadErrors = modifier.errors;
+
+  // every KA5 texture starts as absent
+  ClassValues absentValues;
+  absentValues.fc = absentValues.sat = absentValues.pwp = 0.0;
+  absentValues.state = ClassValues::absent;
+  absentValues.isTorf = 0;
+  _ownValues.assign(noOfKA5TextureIds() * noOfClassValuesPerTexture, absentValues);
+
+  // use the original readers, to keep their fallbacks (closest raw density class),
+  // their only error for a known texture is a missing class
+  auto compile = [](ClassValues& v, const EResult<RPSCDRes>& r) {
+    v.fc = r.result.fc;
+    v.sat = r.result.sat;
+    v.pwp = r.result.pwp;
+    v.state = r.success() ? ClassValues::found : ClassValues::missing;
+  };
+  for (size_t id = 0; id < noOfKA5TextureIds(); id++) {
+    if (KA5TextureId(id) == unknownKA5TextureId) continue;
+    const auto& texture = ka5TextureName(KA5TextureId(id));
+    auto* tvs = _ownValues.data() + id * noOfClassValuesPerTexture;
+    if (texture == "HH" || texture == "HN") {
+      for (size_t i = 0; i < noOfClassValuesPerTexture; i++) tvs[i].isTorf = 1;
+    }
+    if (principal.m.find(texture) != principal.m.end()) {
+      for (size_t i = 0; i < rawDensityClasses.size(); i++) {
+        compile(tvs[i], readPrincipalSoilCharacteristicData(pathToSoilDir, texture, rawDensityClasses[i]));
+      }
+    }
+    if (modifier.m.find(texture) != modifier.m.end()) {
+      for (size_t i = 1; i < organicMatterClasses.size(); i++) {
+        compile(tvs[rawDensityClasses.size() + i - 1],
+                readSoilCharacteristicModifier(pathToSoilDir, texture, organicMatterClasses[i]));
+      }
+    }
+  }
+}
 
-  if (texture.empty()) return EResult<FcSatPwp>({}, "No soil texture given.");
+Errors KA5SoilCharacteristics::loadErrors() const {
+  Errors es;
+  es.append(_principalLoadErrors);
+  es.append(_modifierLoadErrors);
+  return es;
+}
+
+EResult<FcSatPwp> KA5SoilCharacteristics::classValues(KA5TextureId textureId, size_t i) const {
+  const bool isPrincipal = i < rawDensityClasses.size();
+  const auto& loadErrors = isPrincipal ? _principalLoadErrors : _modifierLoadErrors;
+  if (textureId >= noOfKA5TextureIds()) return EResult<FcSatPwp>({}, loadErrors);
+
+  const auto& v = values()[textureId * noOfClassValuesPerTexture + i];
+  FcSatPwp r;
+  r.fc = v.fc;
+  r.sat = v.sat;
+  r.pwp = v.pwp;
+  switch (v.state) {
+  case ClassValues::found: return r;
+  case ClassValues::absent: return EResult<FcSatPwp>({}, loadErrors);
+  default:
+    return EResult<FcSatPwp>({}, kj::str("Couldn't find soil characteristic data for soil type ",
+                                         ka5TextureName(textureId),
+                                         isPrincipal ? " and raw density " : " and organic matter ",
+                                         isPrincipal ? rawDensityClasses[i]
+                                                     : organicMatterClasses[i - rawDensityClasses.size() + 1]).cStr());
+  }
+}
+
+EResult<FcSatPwp> KA5SoilCharacteristics::fcSatPwp(KA5TextureId textureId,
+                                                   double stoneContent,
+                                                   double soilRawDensity,
+                                                   double soilOrganicMatter) const {
+  bool isTorf = textureId < noOfKA5TextureIds() && values()[textureId * noOfClassValuesPerTexture].isTorf != 0;
 
   FcSatPwp res;
   double srd = soilRawDensity / 1000.0; // [kg m-3] -> [g cm-3]
@@ -668,53 +758,31 @@ EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
   // *** (Tab. 4).                               ***
   // ***************************************************************************
 
-  double srd_lowerBound = 0.0;
-  double srd_upperBound = 0.0;
-  if (srd < 1.1) {
-    srd_lowerBound = 1.1;
-    srd_upperBound = 1.1;
-  } else if ((srd >= 1.1) && (srd < 1.3)) {
-    srd_lowerBound = 1.1;
-    srd_upperBound = 1.3;
-  } else if ((srd >= 1.3) && (srd < 1.5)) {
-    srd_lowerBound = 1.3;
-    srd_upperBound = 1.5;
-  } else if ((srd >= 1.5) && (srd < 1.7)) {
-    srd_lowerBound = 1.5;
-    srd_upperBound = 1.7;
-  } else if ((srd >= 1.7) && (srd < 1.9)) {
-    srd_lowerBound = 1.7;
-    srd_upperBound = 1.9;
-  } else if (srd >= 1.9) {
-    srd_lowerBound = 1.9;
-    srd_upperBound = 1.9;
-  }
-
-  // special treatment for "torf" soils
-  if (texture == "HH" || texture == "HN") {
-    srd_lowerBound = -1;
-    srd_upperBound = -1;
-  }
+  // indices into rawDensityClasses
+  int srdLbi = 1, srdUbi = 1;
+  if (isTorf) srdLbi = srdUbi = 0; // special treatment for "torf" soils
+  else if (srd < 1.1) srdLbi = srdUbi = 1;
+  else if (srd < 1.3) { srdLbi = 1; srdUbi = 2; }
+  else if (srd < 1.5) { srdLbi = 2; srdUbi = 3; }
+  else if (srd < 1.7) { srdLbi = 3; srdUbi = 4; }
+  else if (srd < 1.9) { srdLbi = 4; srdUbi = 5; }
+  else srdLbi = srdUbi = 5;
+  double srd_lowerBound = rawDensityClasses[srdLbi];
+  double srd_upperBound = rawDensityClasses[srdUbi];
 
   // Boundaries for linear interpolation
-  auto lbRes = readPrincipalSoilCharacteristicData(pathToSoilDir, texture, srd_lowerBound);
-  if (lbRes.failure()) return EResult<FcSatPwp>({}, lbRes.errors);
+  auto lbRes = classValues(textureId, srdLbi);
+  if (lbRes.failure()) return EResult<FcSatPwp>({}, Errors(lbRes));
   double sat_lowerBound = lbRes.result.sat;
   double fc_lowerBound = lbRes.result.fc;
   double pwp_lowerBound = lbRes.result.pwp;
 
-  auto ubRes = readPrincipalSoilCharacteristicData(pathToSoilDir, texture, srd_upperBound);
-  if (ubRes.failure()) return EResult<FcSatPwp>({}, ubRes.errors);
+  auto ubRes = classValues(textureId, srdUbi);
+  if (ubRes.failure()) return EResult<FcSatPwp>({}, Errors(ubRes));
   double sat_upperBound = ubRes.result.sat;
   double fc_upperBound = ubRes.result.fc;
   double pwp_upperBound = ubRes.result.pwp;
 
-  //  cout << "Soil Raw Density:\t" << vs_SoilRawDensity << endl;
-  //  cout << "Saturation:\t\t" << vs_SaturationLowerBoundary << "\t" << vs_SaturationUpperBoundary << endl;
-  //  cout << "Field Capacity:\t" << vs_FieldCapacityLowerBoundary << "\t" << vs_FieldCapacityUpperBoundary << endl;
-  //  cout << "PermanentWP:\t" << vs_PermanentWiltingPointLowerBoundary << "\t" << vs_PermanentWiltingPointUpperBoundary << endl;
-  //  cout << "Soil Organic Matter:\t" << vs_SoilOrganicMatter << endl;
-
   // ***************************************************************************
   // *** The following boundaries are extracted from:            ***
   // *** Wessolek, G., M. Kaupenjohann, M. Renger (2009) Bodenphysikalische  ***
@@ -723,43 +791,24 @@ EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
   // *** (Tab. 5).                               ***
   // ***************************************************************************
 
-  double som_lowerBound = 0.0;
-  double som_upperBound = 0.0;
-
-  if (som >= 0.0 && som < 1.0) {
-    som_lowerBound = 0.0;
-    som_upperBound = 0.0;
-  } else if (som >= 1.0 && som < 1.5) {
-    som_lowerBound = 0.0;
-    som_upperBound = 1.5;
-  } else if (som >= 1.5 && som < 3.0) {
-    som_lowerBound = 1.5;
-    som_upperBound = 3.0;
-  } else if (som >= 3.0 && som < 6.0) {
-    som_lowerBound = 3.0;
-    som_upperBound = 6.0;
-  } else if (som >= 6.0 && som < 11.5) {
-    som_lowerBound = 6.0;
-    som_upperBound = 11.5;
-  } else if (som >= 11.5) {
-    som_lowerBound = 11.5;
-    som_upperBound = 11.5;
-  }
-
-  // special treatment for "torf" soils
-  if (texture == "HH" || texture == "HN") {
-    som_lowerBound = 0.0;
-    som_upperBound = 0.0;
-  }
+  // indices into organicMatterClasses
+  int somLbi = 0, somUbi = 0;
+  if (isTorf || som < 1.0) somLbi = somUbi = 0; // special treatment for "torf" soils
+  else if (som < 1.5) { somLbi = 0; somUbi = 1; }
+  else if (som < 3.0) { somLbi = 1; somUbi = 2; }
+  else if (som < 6.0) { somLbi = 2; somUbi = 3; }
+  else if (som < 11.5) { somLbi = 3; somUbi = 4; }
+  else if (som >= 11.5) somLbi = somUbi = 4;
+  double som_lowerBound = organicMatterClasses[somLbi];
+  double som_upperBound = organicMatterClasses[somUbi];
 
   // Boundaries for linear interpolation
   double fc_mod_lowerBound = 0.0;
   double sat_mod_lowerBound = 0.0;
   double pwp_mod_lowerBound = 0.0;
-  // modifier values are given only for organic matter > 1.0% (class h2)
-  if (som_lowerBound != 0.0) {
-    auto lbRes2 = readSoilCharacteristicModifier(pathToSoilDir, texture, som_lowerBound);
-    if (lbRes2.failure()) return EResult<FcSatPwp>({}, lbRes2.errors);
+  if (somLbi > 0) {
+    auto lbRes2 = classValues(textureId, rawDensityClasses.size() + somLbi - 1);
+    if (lbRes2.failure()) return EResult<FcSatPwp>({}, Errors(lbRes2));
     sat_mod_lowerBound = lbRes2.result.sat;
     fc_mod_lowerBound = lbRes2.result.fc;
     pwp_mod_lowerBound = lbRes2.result.pwp;
@@ -768,18 +817,14 @@ EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
   double fc_mod_upperBound = 0.0;
   double sat_mod_upperBound = 0.0;
   double pwp_mod_upperBound = 0.0;
-  if (som_upperBound != 0.0) {
-    auto ubRes2 = readSoilCharacteristicModifier(pathToSoilDir, texture, som_upperBound);
-    if (ubRes2.failure()) return EResult<FcSatPwp>({}, ubRes2.errors);
+  if (somUbi > 0) {
+    auto ubRes2 = classValues(textureId, rawDensityClasses.size() + somUbi - 1);
+    if (ubRes2.failure()) return EResult<FcSatPwp>({}, Errors(ubRes2));
     sat_mod_upperBound = ubRes2.result.sat;
     fc_mod_upperBound = ubRes2.result.fc;
     pwp_mod_upperBound = ubRes2.result.pwp;
   }
 
-  //   cout << "Saturation-Modifier:\t" << sat_mod_lowerBound << "\t" << sat_mod_upperBound << endl;
-  //   cout << "Field capacity-Modifier:\t" << fc_mod_lowerBound << "\t" << fc_mod_upperBound << endl;
-  //   cout << "PWP-Modifier:\t" << pwp_mod_lowerBound << "\t" << pwp_mod_upperBound << endl;
-
   // Linear interpolation
   double fcUnmod = fc_lowerBound;
   if (fc_upperBound < 0.5 && fc_lowerBound >= 1.0) fcUnmod = fc_lowerBound;
@@ -836,95 +881,154 @@ EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
   res.sat *= (1.0 - stoneContent);
   res.pwp *= (1.0 - stoneContent);
 
-  debug() << "SoilTexture:\t\t\t" << texture << endl;
-  debug() << "Saturation:\t\t\t" << res.sat << endl;
-  debug() << "FieldCapacity:\t\t" << res.fc << endl;
-  debug() << "PermanentWiltingPoint:\t" << res.pwp << endl << endl;
-
   return res;
 }
 
-FcSatPwp fcSatPwpFromVanGenuchten(double sandContent,
-                                  double clayContent,
-                                  double stoneContent,
-                                  double soilBulkDensity,
-                                  double soilOrganicCarbon) {
-  FcSatPwp res;
-
-  //cout << "Permanent Wilting Point is calculated from van Genuchten parameters" << endl;
-  res.pwp = (0.015 + 0.5 * clayContent + 1.4 * soilOrganicCarbon) * (1.0 - stoneContent);
-
-  res.sat = (0.81 - 0.283 * (soilBulkDensity / 1000.0) + 0.1 * clayContent) * (1.0 - stoneContent);
-
-  //  cout << "Field capacity is calculated from van Genuchten parameters" << endl;
-  double thetaR = res.pwp;
-  double thetaS = res.sat;
+const KA5SoilCharacteristics& Soil::ka5SoilCharacteristics(const std::string& pathToSoilDir) {
+  static ImmutableRegistry<KA5SoilCharacteristics> registry;
+  return registry.get([&]() {
+    if (auto bundle = soilParameterBundleForTables()) return bundle->ka5SoilCharacteristics();
+    return KA5SoilCharacteristics(pathToSoilDir);
+  });
+}
 
-  double vanGenuchtenAlpha = exp(-2.486
-                                 + 2.5 * sandContent
-                                 - 35.1 * soilOrganicCarbon
-                                 - 2.617 * (soilBulkDensity / 1000.0)
-                                 - 2.3 * clayContent);
+//------------------------------------------------------------------------------
 
-  double vanGenuchtenM = 1.0;
+namespace {
 
-  double vanGenuchtenN = exp(0.053
-                             - 0.9 * sandContent
-                             - 1.3 * clayContent
-                             + 1.5 * (pow(sandContent, 2.0)));
+EResult<FcSatPwp> fcSatPwpFromKA5textureClass(const std::string& pathToSoilDir,
+                                              const std::string& texture,
+                                              double stoneContent,
+                                              double soilRawDensity,
+                                              double soilOrganicMatter) {
+  if (texture.empty()) return EResult<FcSatPwp>({}, "No soil texture given.");
 
-  //***** Van Genuchten retention curve to calculate volumetric water content at
-  //***** moisture equivalent (Field capacity definition KA5)
+  const auto& ka5 = ka5SoilCharacteristics(pathToSoilDir);
+  auto res = ka5.fcSatPwp(ka5TextureId(texture), stoneContent, soilRawDensity, soilOrganicMatter);
 
-  double fieldCapacity_pF = 2.1;
-  if (sandContent > 0.48 && sandContent <= 0.9 && clayContent <=
-      0.12)
-    fieldCapacity_pF = 2.1 - (0.476 * (sandContent - 0.48));
-  else if (sandContent > 0.9 && clayContent <= 0.05) fieldCapacity_pF = 1.9;
-  else if (clayContent > 0.45) fieldCapacity_pF = 2.5;
-  else if (clayContent > 0.30 && sandContent < 0.2) fieldCapacity_pF = 2.4;
-  else if (clayContent > 0.35) fieldCapacity_pF = 2.3;
-  else if (clayContent > 0.25 && sandContent < 0.1) fieldCapacity_pF = 2.3;
-  else if (clayContent > 0.17 && sandContent > 0.68) fieldCapacity_pF = 2.2;
-  else if (clayContent > 0.17 && sandContent < 0.33) fieldCapacity_pF = 2.2;
-  else if (clayContent > 0.08 && sandContent < 0.27) fieldCapacity_pF = 2.2;
-  else if (clayContent > 0.25 && sandContent < 0.25) fieldCapacity_pF = 2.2;
+  if (activateDebug) {
+    debug() << "soilCharacteristicsKA5" << endl;
+    debug() << "SoilTexture:\t\t\t" << texture << endl;
+    debug() << "Saturation:\t\t\t" << res.result.sat << endl;
+    debug() << "FieldCapacity:\t\t" << res.result.fc << endl;
+    debug() << "PermanentWiltingPoint:\t" << res.result.pwp << endl << endl;
+  }
 
-  double matricHead = pow(10, fieldCapacity_pF);
+  return res;
+}
 
-  res.fc = (thetaR + ((thetaS - thetaR) /
-                      (pow(1.0 + pow(vanGenuchtenAlpha * matricHead, vanGenuchtenN), vanGenuchtenM))))
-           * (1.0 - stoneContent);
+//! van Genuchten for the layers [0, n), exp/pow per layer, so it only vectorizes with a vector math library
+void fcSatPwpFromVanGenuchten(const double* sandContent,
+                              const double* clayContent,
+                              const double* stoneContent,
+                              const double* soilBulkDensity,
+                              const double* soilOrganicCarbon,
+                              size_t n,
+                              double* fc,
+                              double* sat,
+                              double* pwp) {
+  for (size_t i = 0; i < n; i++) {
+    const double sand = sandContent[i];
+    const double clay = clayContent[i];
+    const double stone = stoneContent[i];
+    const double sbd = soilBulkDensity[i];
+    const double soc = soilOrganicCarbon[i];
+
+    //cout << "Permanent Wilting Point is calculated from van Genuchten parameters" << endl;
+    const double thetaR = (0.015 + 0.5 * clay + 1.4 * soc) * (1.0 - stone);
+    const double thetaS = (0.81 - 0.283 * (sbd / 1000.0) + 0.1 * clay) * (1.0 - stone);
+
+    //  cout << "Field capacity is calculated from van Genuchten parameters" << endl;
+    double vanGenuchtenAlpha = exp(-2.486
+                                   + 2.5 * sand
+                                   - 35.1 * soc
+                                   - 2.617 * (sbd / 1000.0)
+                                   - 2.3 * clay);
+
+    double vanGenuchtenM = 1.0;
+
+    double vanGenuchtenN = exp(0.053
+                               - 0.9 * sand
+                               - 1.3 * clay
+                               + 1.5 * (pow(sand, 2.0)));
+
+    //***** Van Genuchten retention curve to calculate volumetric water content at
+    //***** moisture equivalent (Field capacity definition KA5)
+
+    double fieldCapacity_pF = 2.1;
+    if (sand > 0.48 && sand <= 0.9 && clay <= 0.12) fieldCapacity_pF = 2.1 - (0.476 * (sand - 0.48));
+    else if (sand > 0.9 && clay <= 0.05) fieldCapacity_pF = 1.9;
+    else if (clay > 0.45) fieldCapacity_pF = 2.5;
+    else if (clay > 0.30 && sand < 0.2) fieldCapacity_pF = 2.4;
+    else if (clay > 0.35) fieldCapacity_pF = 2.3;
+    else if (clay > 0.25 && sand < 0.1) fieldCapacity_pF = 2.3;
+    else if (clay > 0.17 && sand > 0.68) fieldCapacity_pF = 2.2;
+    else if (clay > 0.17 && sand < 0.33) fieldCapacity_pF = 2.2;
+    else if (clay > 0.08 && sand < 0.27) fieldCapacity_pF = 2.2;
+    else if (clay > 0.25 && sand < 0.25) fieldCapacity_pF = 2.2;
+
+    double matricHead = pow(10, fieldCapacity_pF);
+
+    pwp[i] = thetaR;
+    sat[i] = thetaS;
+    fc[i] = (thetaR + ((thetaS - thetaR) /
+                       (pow(1.0 + pow(vanGenuchtenAlpha * matricHead, vanGenuchtenN), vanGenuchtenM))))
+            * (1.0 - stone);
+  }
+}
 
+FcSatPwp fcSatPwpFromVanGenuchten(double sandContent,
+                                  double clayContent,
+                                  double stoneContent,
+                                  double soilBulkDensity,
+                                  double soilOrganicCarbon) {
+  FcSatPwp res;
+  fcSatPwpFromVanGenuchten(&sandContent, &clayContent, &stoneContent, &soilBulkDensity, &soilOrganicCarbon, 1,
+                           &res.fc, &res.sat, &res.pwp);
   return res;
 }
 
+//! Toth for the layers [0, n), plain arithmetic without branches, so the compiler can vectorize the loop
+void fcSatPwpFromToth(const double* sandContent,
+                      const double* clayContent,
+                      const double* stoneContent,
+                      const double* soilBulkDensity,
+                      const double* soilOrganicCarbon,
+                      size_t n,
+                      double* fc,
+                      double* sat,
+                      double* pwp) {
+  for (size_t i = 0; i < n; i++) {
+    sat[i] = (0.81 - 0.283 * (soilBulkDensity[i] / 1000.0) + 0.1 * clayContent[i]) * (1.0 - stoneContent[i]);
+    // sat function from MONICA, maybe not necessary
+
+    double sluf = 100.0 - clayContent[i] * 100.0 - sandContent[i] * 100.0;
+    // transform from [0 to 1] to [0 to 100] , in the future, I will change and put the conversions inside the functions
+    double ton = clayContent[i] * 100.0;
+    double oc = soilOrganicCarbon[i] * 100.0; // The SOC was 0.001 from the input, that’s why I added this line
+
+    fc[i] = 0.24490 - 0.1887 * (1 / (oc + 1)) + 0.0045270 * ton + 0.001535 * sluf +
+            0.001442 * sluf * (1 / (oc + 1)) - 0.0000511 * sluf * ton +
+            0.0008676 * ton * (1 / (oc + 1));
+
+    pwp[i] = 0.09878 + 0.002127 * ton - 0.0008366 * sluf - 0.0767 * (1 / (oc + 1)) +
+             0.00003853 * sluf * ton + 0.00233 * ton * (1 / (oc + 1)) +
+             0.0009498 * sluf * (1 / (oc + 1));
+
+    //sat[i] = std::round(sat[i] * 1000.0) / 1000.0;  // Maybe not necessary
+    //fc[i]  = std::round(fc[i]  * 1000.0) / 1000.0;
+    //pwp[i] = std::round(pwp[i] * 1000.0) / 1000.0;
+  }
+}
+
 FcSatPwp fcSatPwpFromToth(double sandContent,
                           double clayContent,
                           double stoneContent,
                           double soilBulkDensity,
                           double soilOrganicCarbon) {
   FcSatPwp res;
-  res.sat = (0.81 - 0.283 * (soilBulkDensity / 1000.0) + 0.1 * clayContent) * (1.0 - stoneContent);
-  // sat function from MONICA, maybe not necessary
-
-  double sluf = 100.0 - clayContent * 100.0 - sandContent * 100.0;
-  // transform from [0 to 1] to [0 to 100] , in the future, I will change and put the conversions inside the functions
-  double ton = clayContent * 100.0;
-  double oc = soilOrganicCarbon * 100.0; // The SOC was 0.001 from the input, that’s why I added this line
-
-  res.fc = 0.24490 - 0.1887 * (1 / (oc + 1)) + 0.0045270 * ton + 0.001535 * sluf +
-           0.001442 * sluf * (1 / (oc + 1)) - 0.0000511 * sluf * ton +
-           0.0008676 * ton * (1 / (oc + 1));
-
-  res.pwp = 0.09878 + 0.002127 * ton - 0.0008366 * sluf - 0.0767 * (1 / (oc + 1)) +
-            0.00003853 * sluf * ton + 0.00233 * ton * (1 / (oc + 1)) +
-            0.0009498 * sluf * (1 / (oc + 1));
-
-  //res.sat = std::round(res.sat * 1000.0) / 1000.0;  // Maybe not necessary
-  //res.fc  = std::round(res.fc  * 1000.0) / 1000.0;
-  //res.pwp = std::round(res.pwp * 1000.0) / 1000.0;
-
+  fcSatPwpFromToth(&sandContent, &clayContent, &stoneContent, &soilBulkDensity, &soilOrganicCarbon, 1,
+                   &res.fc, &res.sat, &res.pwp);
   return res;
 }
 
@@ -982,4 +1086,116 @@ Errors Soil::updateUnsetPwpFcSatFromToth(SoilParameters* sp) {
   return {};
 }
 
+EResult<SoilProfileStore> Soil::createSoilProfileStore(SoilLayerColumns layers,
+                                                       PwpFcSatMethod method,
+                                                       const std::string& pathToSoilDir) {
+  EResult<SoilProfileStore> res;
+  auto& store = res.result;
+  static_cast<SoilLayerColumns&>(store) = std::move(layers);
+
+  // the layers of the profiles have to follow each other without gaps, starting with the first layer
+  const auto& offsets = store.profileOffsets;
+  for (size_t i = 0; i < offsets.size(); i++) {
+    if ((i == 0 && offsets[i] != 0) || (i > 0 && offsets[i] < offsets[i - 1])) {
+      res.appendError(kj::str("The profile offsets have to be ascending and start at 0, offset ", i, " is ",
+                              offsets[i], ".").cStr());
+      return res;
+    }
+  }
+
+  const size_t n = store.noOfLayers();
+  if (store.stone.empty()) store.stone.assign(n, 0.0);
+  auto hasNValues = [n](const vector<double>& vs) { return vs.size() == n; };
+  if (!(hasNValues(store.thickness) && hasNValues(store.sand) && hasNValues(store.clay)
+        && hasNValues(store.organicCarbon) && hasNValues(store.bulkDensity) && hasNValues(store.stone))) {
+    res.appendError(kj::str("All layer columns need ", n, " values.").cStr());
+    return res;
+  }
+  if (method == pwpFcSatFromKA5textureClass && store.textureId.size() != n) {
+    res.appendError(kj::str("The KA5 method needs ", n, " texture ids.").cStr());
+    return res;
+  }
 
+  store.fieldCapacity.resize(n);
+  store.saturation.resize(n);
+  store.permanentWiltingPoint.resize(n);
+  store.lambda.resize(n);
+
+  const double* sand = store.sand.data();
+  const double* clay = store.clay.data();
+  const double* soc = store.organicCarbon.data();
+  const double* sbd = store.bulkDensity.data();
+  double* stone = store.stone.data();
+  double* fc = store.fieldCapacity.data();
+  double* sat = store.saturation.data();
+  double* pwp = store.permanentWiltingPoint.data();
+  double* lambda = store.lambda.data();
+
+  // restrict sceleton to 80%, else FC, PWP and SAT could be calculated too low, so that the water transport algorithm gets unstable
+  for (size_t i = 0; i < n; i++) stone[i] = stone[i] > 0 ? min(stone[i], 0.8) : stone[i];
+
+  switch (method) {
+  case pwpFcSatFromVanGenuchten:
+    fcSatPwpFromVanGenuchten(sand, clay, stone, sbd, soc, n, fc, sat, pwp);
+    break;
+  case pwpFcSatFromToth:
+    fcSatPwpFromToth(sand, clay, stone, sbd, soc, n, fc, sat, pwp);
+    break;
+  case pwpFcSatFromKA5textureClass: {
+    const auto& ka5 = ka5SoilCharacteristics(pathToSoilDir);
+    const KA5TextureId* tid = store.textureId.data();
+    for (size_t i = 0; i < n; i++) {
+      double srd = ((sbd[i] / 1000.0) - (0.009 * 100.0 * clay[i])) * 1000.0;
+      double som = soc[i] / OrganicConstants::po_SOM_to_C;
+      auto r = ka5.fcSatPwp(tid[i], stone[i], srd, som);
+      if (r.failure()) {
+        res.appendError(kj::str("Layer ", i, ":").cStr());
+        res.append(r);
+      }
+      fc[i] = r.result.fc;
+      sat[i] = r.result.sat;
+      pwp[i] = r.result.pwp;
+    }
+    break;
+  }
+  }
+
+  // restrict FC, PWP and SAT else the water transport algorithm gets instable
+  size_t tooLowFcs = 0, tooLowPwps = 0, tooLowSats = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (fc[i] < 0.05) { fc[i] = 0.05; tooLowFcs++; }
+    if (pwp[i] < 0.01) { pwp[i] = 0.01; tooLowPwps++; }
+    if (sat[i] < 0.1) { sat[i] = 0.1; tooLowSats++; }
+  }
+  if (tooLowFcs > 0) res.appendWarning(kj::str("Field capacity is too low in ", tooLowFcs, " layers. Is being set to 5%.").cStr());
+  if (tooLowPwps > 0) res.appendWarning(kj::str("Permanent wilting point is too low in ", tooLowPwps, " layers. Is being set to 1%.").cStr());
+  if (tooLowSats > 0) res.appendWarning(kj::str("Saturation is too low in ", tooLowSats, " layers. Is being set to 10%.").cStr());
+
+  for (size_t i = 0; i < n; i++) {
+    lambda[i] = sand[i] > 0 && clay[i] > 0 ? ::sandAndClay2lambda(sand[i], clay[i]) : -1.0;
+  }
+
+  return res;
+}
+
+SoilPMs Soil::soilPMsFromStore(const SoilProfileStore& store, size_t profile) {
+  SoilPMs soilPMs;
+  for (size_t i = store.profileOffsets.at(profile), end = store.profileOffsets.at(profile + 1); i < end; i++) {
+    SoilParameters sps;
+    sps.thickness = store.thickness[i];
+    sps.vs_SoilSandContent = store.sand[i];
+    sps.vs_SoilClayContent = store.clay[i];
+    sps.set_vs_SoilOrganicCarbon(store.organicCarbon[i]);
+    sps.set_vs_SoilBulkDensity(store.bulkDensity[i]);
+    sps.vs_SoilStoneContent = store.stone[i];
+    sps.vs_FieldCapacity = store.fieldCapacity[i];
+    sps.vs_Saturation = store.saturation[i];
+    sps.vs_PermanentWiltingPoint = store.permanentWiltingPoint[i];
+    sps.vs_Lambda = store.lambda[i];
+    if (i < store.textureId.size() && store.textureId[i] != unknownKA5TextureId) {
+      sps.vs_SoilTexture = ka5TextureName(store.textureId[i]);
+    }
+    soilPMs.push_back(sps);
+  }
+  return soilPMs;
+}
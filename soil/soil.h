@@ -22,10 +22,14 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <string>
 #include <vector>
 #include <map>
+#include <array>
 #include <iostream>
 
 #include "kj/function.h"
 
+#include "tools/immutable-registry.h"
+#include "conversion.h"
+
 #include "model/monica/monica_params.capnp.h"
 
 #include "json11/json11.hpp"
@@ -36,6 +40,13 @@ namespace Soil {
 class SoilParameters;
 Tools::Errors noSetPwpFcSat(SoilParameters* sp);
 
+class CapillaryRiseRates;
+class KA5SoilCharacteristics;
+class SoilParameterBundle;
+Tools::Errors writeSoilParameterBundle(const std::string& pathToBundle,
+                                       const KA5SoilCharacteristics& ka5,
+                                       const CapillaryRiseRates& capillaryRiseRates);
+
 //! @author Claas Nendel, Michael Berg 
 struct SoilParameters : public Tools::Json11Serializable
 {
@@ -48,6 +59,10 @@ struct SoilParameters : public Tools::Json11Serializable
 
   Tools::Errors merge(json11::Json j) override;
 
+  //! derive unset values (sand/clay from texture, PWP/FC/SAT, lambda), apply the restrictions and check the bounds,
+  //! merge calls it after reading the json values, so use it when setting the members directly
+  Tools::Errors setDerivedValuesAndValidate();
+
   json11::Json to_json() const override;
 
   //! Soil layer's silt content [kg kg-1] (Schluff)
@@ -98,23 +113,121 @@ private:
 };
 
 // Data structure that holds information about capillary rise rates.
+// Every soil type is a row with the rates densely indexed by distance to ground water,
+// all rows have the same length and are stored in one array (possibly mapped from a soil parameter bundle).
 class CapillaryRiseRates {
 public:
+  //! resolved soil type, -1 means unknown soil type
+  typedef int Handle;
+
   //Adds a capillary rise rate to data structure.
   void addRate(const std::string& soilType, size_t distance, double value);
 
+  //Returns the handle for the soil type, falling back to its first 3 and 2 characters, or -1 if unknown.
+  //Resolve once and use getRate(handle, distance) in the daily loop.
+  Handle handle(const std::string& soilType) const;
+
+  //Returns capillary rise rate for given soil type handle and distance to ground water.
+  double getRate(Handle handle, size_t distance) const {
+    return handle >= 0 && distance < _rowLength ? rates()[handle * _rowLength + distance] : 0.0;
+  }
+
   //Returns capillary rise rate for given soil type and distance to ground water.
-  double getRate(const std::string& soilType, size_t distance) const;
+  double getRate(const std::string& soilType, size_t distance) const { return getRate(handle(soilType), distance); }
 
-  //Returns number of elements of internal map data structure.
-  size_t size() const { return capillaryRiseRates.size(); }
+  //Returns number of soil types.
+  size_t size() const { return _soilTypes.size(); }
 
 private:
-  std::map<std::string, std::map<size_t, double>> capillaryRiseRates;
+  friend class SoilParameterBundle;
+  friend Tools::Errors writeSoilParameterBundle(const std::string&, const KA5SoilCharacteristics&, const CapillaryRiseRates&);
+
+  const double* rates() const { return _mapped ? _mapped : _ownRates.data(); }
+
+  Tools::InternedKeys _soilTypes;
+  size_t _rowLength{0};
+  //! [handle * _rowLength + distance], unknown distances are 0
+  std::vector<double> _ownRates;
+  //! the rates in a soil parameter bundle, instead of _ownRates
+  const double* _mapped{nullptr};
+  std::shared_ptr<const void> _mapping;
 };
 
+//! the capillary rise rates of the parameter files in pathToSoilDir, created on first use
+const CapillaryRiseRates& readCapillaryRiseRates(const std::string& pathToSoilDir);
+
+//! the capillary rise rates of the parameter files in ${MONICA_PARAMETERS}/soil/, created on first use
 const CapillaryRiseRates& readCapillaryRiseRates();
 
+//! field capacity, saturation and permanent wilting point [m3 m-3]
+struct FcSatPwp {
+  double fc{0.0};
+  double sat{0.0};
+  double pwp{0.0};
+};
+
+//! KA5 soil characteristic data (Wessolek 2009) compiled into one dense table indexed by KA5TextureId,
+//! so calculating fc/sat/pwp for a layer needs no string keyed map lookups anymore.
+//! Textures without data in the parameter files (and unknownKA5TextureId) are absent and behave like
+//! an unknown texture, textures of the parameter files which aren't KA5 textures are ignored.
+//! The results are identical to the (previous) lookups in the SoilCharacteristicData
+//! and SoilCharacteristicModifier maps.
+class KA5SoilCharacteristics {
+public:
+  explicit KA5SoilCharacteristics(const std::string& pathToSoilDir);
+
+  //! the values of a texture for one class, also the layout in soil parameter bundles
+  struct ClassValues {
+    enum State : uint32_t {
+      missing = 0, //!< the parameter files contain no values for this class
+      found = 1,
+      absent = 2 //!< no data for the texture at all, like an unknown texture
+    };
+    double fc, sat, pwp;
+    uint32_t state;
+    uint32_t isTorf;
+  };
+  //! per texture the principal values of the 6 raw density classes, then the modifiers
+  //! of the 4 organic matter classes > 0
+  static const size_t noOfClassValuesPerTexture = 6 + 4;
+
+  //! stoneContent [m3 m-3], soilRawDensity [kg m-3], soilOrganicMatter [kg kg-1]
+  Tools::EResult<FcSatPwp> fcSatPwp(KA5TextureId textureId,
+                                    double stoneContent,
+                                    double soilRawDensity,
+                                    double soilOrganicMatter) const;
+
+  //! errors while loading the parameter files
+  Tools::Errors loadErrors() const;
+
+  //! raw density classes [g cm-3] of the principal values, -1 is used for torf
+  static const std::array<double, 6> rawDensityClasses;
+  //! organic matter classes [%] of the modifiers, 0 means no modifier
+  static const std::array<double, 5> organicMatterClasses;
+
+private:
+  KA5SoilCharacteristics() {}
+  friend class SoilParameterBundle;
+  friend Tools::Errors writeSoilParameterBundle(const std::string&, const KA5SoilCharacteristics&, const CapillaryRiseRates&);
+
+  //! [KA5TextureId * noOfClassValuesPerTexture + class]
+  const ClassValues* values() const { return _mapped ? _mapped : _ownValues.data(); }
+
+  //! the values of class i of the texture with the same errors as the lookups in the parameter files
+  Tools::EResult<FcSatPwp> classValues(KA5TextureId textureId, size_t i) const;
+
+  std::vector<ClassValues> _ownValues;
+  //! the values in a soil parameter bundle, instead of _ownValues
+  const ClassValues* _mapped{nullptr};
+  std::shared_ptr<const void> _mapping;
+  //! what the maps return for unknown textures (the loading errors)
+  Tools::Errors _principalLoadErrors;
+  Tools::Errors _modifierLoadErrors;
+};
+
+//! the KA5 tables compiled from the parameter files in pathToSoilDir, created on first use
+const KA5SoilCharacteristics& ka5SoilCharacteristics(const std::string& pathToSoilDir);
+
 typedef std::vector<SoilParameters> SoilPMs;
 typedef std::shared_ptr<SoilPMs> SoilPMsPtr;
 
@@ -129,4 +242,47 @@ Tools::Errors updateUnsetPwpFcSatFromVanGenuchten(SoilParameters* sp);
 
 Tools::Errors updateUnsetPwpFcSatFromToth(SoilParameters* sp);
 
+//! methods to calculate field capacity, saturation and permanent wilting point
+enum PwpFcSatMethod { pwpFcSatFromKA5textureClass, pwpFcSatFromVanGenuchten, pwpFcSatFromToth };
+
+//! layers of many soil profiles as columns (structure of arrays),
+//! the layers of profile i are [profileOffsets[i], profileOffsets[i + 1]),
+//! so the offsets are ascending, start at 0 and end at the number of layers of every column
+struct SoilLayerColumns {
+  size_t noOfLayers() const { return profileOffsets.empty() ? 0 : profileOffsets.back(); }
+  size_t noOfProfiles() const { return profileOffsets.empty() ? 0 : profileOffsets.size() - 1; }
+
+  std::vector<size_t> profileOffsets;
+  std::vector<double> thickness; //!< [m]
+  std::vector<double> sand; //!< [kg kg-1]
+  std::vector<double> clay; //!< [kg kg-1]
+  std::vector<double> organicCarbon; //!< [kg C kg-1]
+  std::vector<double> bulkDensity; //!< [kg m-3]
+  std::vector<double> stone; //!< [m3 m-3], may be empty (= no stones)
+  //! e.g. from sandAndClay2KA5textureIds, only needed for the KA5 method
+  std::vector<KA5TextureId> textureId;
+};
+
+//! flat store of initialized soil profiles, the inputs plus the calculated columns
+struct SoilProfileStore : public SoilLayerColumns {
+  std::vector<double> fieldCapacity; //!< [m3 m-3]
+  std::vector<double> saturation; //!< [m3 m-3]
+  std::vector<double> permanentWiltingPoint; //!< [m3 m-3]
+  std::vector<double> lambda; //!< []
+};
+
+//! initialize all layers of all profiles in one go, without creating SoilParameters per layer.
+//! Mirrors SoilParameters::merge: stones are restricted to 80% and too low
+//! FC, PWP and SAT values are raised (one warning per kind for all layers).
+//! Toth runs as a branch free loop the compiler can vectorize, van Genuchten (exp/pow per layer)
+//! and KA5 (table lookups per layer) are plain batch loops.
+//! Invalid profile offsets or column sizes are errors.
+//! pathToSoilDir is only needed for the KA5 method
+Tools::EResult<SoilProfileStore> createSoilProfileStore(SoilLayerColumns layers,
+                                                        PwpFcSatMethod method,
+                                                        const std::string& pathToSoilDir = "");
+
+//! the layers of a single profile of the store as SoilParameters
+SoilPMs soilPMsFromStore(const SoilProfileStore& store, size_t profile);
+
 } // namespace Soil
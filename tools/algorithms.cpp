@@ -25,6 +25,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <cassert>
 #include <utility>
 #include <climits>
+#include <memory>
 //#define _USE_MATH_DEFINES
 //#include <math.h>
 #ifndef M_PI
@@ -145,9 +146,9 @@ string Tools::decapitalize(const string& s) {
 }
 
 
-double Tools::sunshine2globalRadiation(int julianDay, double sunHours, double lat,
-                                       bool asMJpm2pd) {
-  double pi = 4.0 * atan(1.0);
+namespace {
+SunshineToGlobalRadiationTable::Terms sunshine2globalRadiationTerms(int julianDay, double lat) {
+  static const double pi = 4.0 * atan(1.0);
   double dec = -23.4 * cos(2 * pi * (julianDay + 10) / 365);
   double sinld = sin(dec * pi / 180) * sin(lat * pi / 180);
   double cosld = cos(dec * pi / 180) * cos(lat * pi / 180);
@@ -156,7 +157,14 @@ double Tools::sunshine2globalRadiation(int julianDay, double sunHours, double la
   double rdn = 3600 * (sinld * dl + 24 / pi * cosld * sqrt(1.0 - (sinld / cosld) * (sinld / cosld)));
   double drc = 1300 * rdn * exp(-0.14 / (rdn / (dl * 3600)));
   double dro = 0.2 * drc;
-  double dtga = sunHours / dle * drc + (1 - sunHours / dle) * dro;
+  return {dle, drc, dro};
+}
+}
+
+double Tools::sunshine2globalRadiation(int julianDay, double sunHours, double lat,
+                                       bool asMJpm2pd) {
+  auto ts = sunshine2globalRadiationTerms(julianDay, lat);
+  double dtga = sunHours / ts.dle * ts.drc + (1 - sunHours / ts.dle) * ts.dro;
   double t = dtga / 10000.0;
   //convert J/cm²/d to MJ/m²/d
   //1cm²=1/(100*100)m², 1J = 1/1000000MJ
@@ -164,26 +172,56 @@ double Tools::sunshine2globalRadiation(int julianDay, double sunHours, double la
   return asMJpm2pd ? t / 100.0 : t;
 }
 
-double Tools::cloudAmount2globalRadiation(int doy,
-                                          double nn, //[1/8]
-                                          double lat, //[°]
-                                          double hh, //[m]
-                                          bool asMJpm2pd) {
+SunshineToGlobalRadiationTable::SunshineToGlobalRadiationTable(double latitude)
+  : _latitude(latitude) {
+  _terms.reserve(367);
+  for (int jd = 0; jd <= 366; jd++) _terms.push_back(sunshine2globalRadiationTerms(jd, latitude));
+}
+
+SunshineToGlobalRadiationTable::Terms SunshineToGlobalRadiationTable::terms(int julianDay) const {
+  return julianDay >= 0 && julianDay < int(_terms.size())
+         ? _terms[julianDay]
+         : sunshine2globalRadiationTerms(julianDay, _latitude);
+}
+
+void SunshineToGlobalRadiationTable::globalRadiation(const int* julianDays, const double* sunHours, size_t n,
+                                                     double* globrad, bool asMJpm2pd) const {
+  for (size_t i = 0; i < n; i++) globrad[i] = globalRadiation(julianDays[i], sunHours[i], asMJpm2pd);
+}
+
+shared_ptr<const SunshineToGlobalRadiationTable> Tools::sunshine2globalRadiationTable(double latitude) {
+  //a few latitudes, so interleaved users of different latitudes don't rebuild the tables all the time,
+  //the most recently used table is at the front
+  static const size_t maxNoOfTables = 8;
+  thread_local vector<shared_ptr<const SunshineToGlobalRadiationTable>> tables;
+  //NaN != NaN, but a NaN latitude must find its table as well
+  auto sameLatitude = [latitude](double lat) { return lat == latitude || (std::isnan(lat) && std::isnan(latitude)); };
+
+  auto ci = find_if(tables.begin(), tables.end(), [&](const auto& t) { return sameLatitude(t->latitude()); });
+  if (ci != tables.end()) {
+    rotate(tables.begin(), ci, ci + 1);
+    return tables.front();
+  }
+
+  if (tables.size() == maxNoOfTables) tables.pop_back();
+  tables.insert(tables.begin(), make_shared<const SunshineToGlobalRadiationTable>(latitude));
+  return tables.front();
+}
+
+void Tools::sunshine2globalRadiation(const int* julianDays, const double* sunHours, size_t n,
+                                     double latitude, double* globrad, bool asMJpm2pd) {
+  sunshine2globalRadiationTable(latitude)->globalRadiation(julianDays, sunHours, n, globrad, asMJpm2pd);
+}
+
+int CloudAmountToGlobalRadiationTable::halfHours(int doy, double lat, double hh, HalfHour* halfHours) {
   static const double pi = 4.0 * atan(1.0);
   static const double s0 = 1367; //Wm-2
   static const double a = 0.50572;
   static const double b = 607995;
   static const double c = 1.6364;
-  //static const double enc = 0;
-  static const double als = 0.2;
-  static const double albc = 0.5;
-  static const double albh = 0.2;
   static const double alph = 0;
   static const double azh = 0;
-  static const double swf = cos(alph / 2.0) * cos(alph / 2.0);
 
-  //Datum	27.06.2009
-  double enc = nn / 8.0;
   double phi = lat * pi / 180.0;
   double theta0 = 2.0 * pi * doy / 365.0;
   double xx = pi * (0.9856 * doy - 2.72) / 180.0;
@@ -194,56 +232,71 @@ double Tools::cloudAmount2globalRadiation(int doy,
                  0.000907 * sin(2 * theta0) - 0.002697 * cos(3 * theta0) +
                  0.00148 * sin(theta0 * 3);
   double pp0 = exp(-hh / 8434.5);
+  double tl = 3.9 - 1.4 * cos(2 * pi * (doy - 15.0) / 365.0);
 
-  double rgsum = 0; //[0,5 Wh m-2] pro d
-  //	cout << "rgsum: 0 ";
+  int count = 0;
   for (int hs = 1; hs <= 48; hs++) {
     double t = 24.0 * (double(hs) - 1.0) / 48.0;
-    //double zeit = t;
     double th = pi * (t - 12.0) / 12.0;
     double ctheta = sin(delta) * sin(phi) + cos(delta) * cos(phi) * cos(th);
+    //without sun a half hour adds nothing to the daily sum
+    if (ctheta < 0) continue;
     double theta = acos(ctheta);
-    //double hsonne = pi / 2.0 - theta;
     double hdeg = 90.0 - (theta * 180.0 / pi);
     double gfaktor = cos(alph) * ctheta +
                      sin(alph) * (cos(azh) *
                                   (tan(phi) * ctheta - sin(delta) / cos(phi)) +
                                   sin(azh) * cos(delta) * sin(th));
     double m = 1.0 / (ctheta + a * pow(hdeg + b, -c));
-    double tl = 3.9 - 1.4 * cos(2 * pi * (doy - 15.0) / 365.0);
     double dr0 = hdeg > 0.5 ? 1.0 / (0.9 * m + 9.4) : 0.0408 + hdeg * 0.0028;
-    double id0 = ctheta < 0 ? 0 : i0 * exp(-tl * dr0 * m * pp0);
-    double id = ctheta < 0 ? 0 : (1.0 - enc) * id0;
+    double id0 = i0 * exp(-tl * dr0 * m * pp0);
     double rg0 = 0.9 * i0 * ctheta * exp(-0.027 * pp0 * tl / ctheta);
-    //double rg = ctheta < 0 ? 0 : rg0 * (1.0 - 0.72 * pow(enc, 3.2));
-    //double sh = ctheta < 0 ? 0 : id * ctheta;
     double d0 = rg0 - id0 * ctheta;
     double d1 = rg0 * 0.2;
-    //double d = ctheta < 0 ? 0 : (1.0 - enc) * d0 + enc * d1;
-    //double swf = cos(alph / 2.0) * cos(alph / 2.0);
-    double tau = ctheta < 0 || fuzzyIsNull(id) ? 0 : id0 / id;
-    double ds0 = gfaktor < 0
-                   ? d0 * (1.0 - tau) * swf
-                   : d0 * (tau * gfaktor / ctheta + (1.0 - tau) * swf);
-    double ds1 = d1 * swf;
-    double ds = ctheta < 0 ? 0 : (1.0 - enc) * ds0 + ds1 * enc;
-    double sd = gfaktor * id;
-    //double rch = enc * albc * albh * (sh + d);
-    //double qh = sh + d + rch;
+    halfHours[count++] = {ctheta, gfaktor, id0, d0, d1};
+  }
+  return count;
+}
+
+double CloudAmountToGlobalRadiationTable::globalRadiation(const HalfHour* first, const HalfHour* last,
+                                                          double nn) {
+  static const double als = 0.2;
+  static const double albc = 0.5;
+  static const double albh = 0.2;
+  static const double alph = 0;
+  static const double swf = cos(alph / 2.0) * cos(alph / 2.0);
+
+  double enc = nn / 8.0;
+  double rgsum = 0; //[0,5 Wh m-2] pro d
+  for (const HalfHour* hh = first; hh != last; hh++) {
+    double id = (1.0 - enc) * hh->id0;
+    double tau = fuzzyIsNull(id) ? 0 : hh->id0 / id;
+    double ds0 = hh->gfaktor < 0
+                   ? hh->d0 * (1.0 - tau) * swf
+                   : hh->d0 * (tau * hh->gfaktor / hh->ctheta + (1.0 - tau) * swf);
+    double ds1 = hh->d1 * swf;
+    double ds = (1.0 - enc) * ds0 + ds1 * enc;
+    double sd = hh->gfaktor * id;
     double rcs = enc * albc * als * (sd + ds);
     double qs = sd + ds + rcs;
     double rh = albh * qs;
     double rss = rh * (1.0 - swf);
     double rges = qs + rss;
-    //double rs = als * (qs * rss);
     rgsum += rges < 0 ? 0 : rges;
-    //		cout << rgsum << " ";
   }
-  //	cout << endl;
 
-  double rg_nn = rgsum * 0.18;
+  return rgsum * 0.18;
+}
 
-  //	cout << "doy: " << doy << " nn: " << nn << " lat: " << lat << " hh: " << hh << " rgsum: " << rgsum << " rg_nn: " << rg_nn << endl;
+double Tools::cloudAmount2globalRadiation(int doy,
+                                          double nn, //[1/8]
+                                          double lat, //[°]
+                                          double hh, //[m]
+                                          bool asMJpm2pd) {
+  //Datum	27.06.2009
+  CloudAmountToGlobalRadiationTable::HalfHour hhs[48];
+  int count = CloudAmountToGlobalRadiationTable::halfHours(doy, lat, hh, hhs);
+  double rg_nn = CloudAmountToGlobalRadiationTable::globalRadiation(hhs, hhs + count, nn);
 
   //convert J/cm²/d to MJ/m²/d
   //1cm²=1/(100*100)m², 1J = 1/1000000MJ
@@ -251,6 +304,42 @@ double Tools::cloudAmount2globalRadiation(int doy,
   return asMJpm2pd ? rg_nn / 100.0 : rg_nn;
 }
 
+CloudAmountToGlobalRadiationTable::CloudAmountToGlobalRadiationTable(double latitude, double heightNN)
+  : _latitude(latitude), _heightNN(heightNN) {
+  HalfHour hhs[48];
+  _dayOffsets.reserve(368);
+  _dayOffsets.push_back(0);
+  for (int doy = 0; doy <= 366; doy++) {
+    int count = halfHours(doy, latitude, heightNN, hhs);
+    _halfHours.insert(_halfHours.end(), hhs, hhs + count);
+    _dayOffsets.push_back(uint32_t(_halfHours.size()));
+  }
+}
+
+double CloudAmountToGlobalRadiationTable::globalRadiation(int doy, double cloudAmount, bool asMJpm2pd) const {
+  double rg_nn = 0;
+  if (doy >= 0 && doy + 1 < int(_dayOffsets.size())) {
+    const HalfHour* hhs = _halfHours.data();
+    rg_nn = globalRadiation(hhs + _dayOffsets[doy], hhs + _dayOffsets[doy + 1], cloudAmount);
+  } else {
+    HalfHour hhs[48];
+    int count = halfHours(doy, _latitude, _heightNN, hhs);
+    rg_nn = globalRadiation(hhs, hhs + count, cloudAmount);
+  }
+  return asMJpm2pd ? rg_nn / 100.0 : rg_nn;
+}
+
+void CloudAmountToGlobalRadiationTable::globalRadiation(const int* daysOfYear, const double* cloudAmounts,
+                                                        size_t n, double* globrad, bool asMJpm2pd) const {
+  for (size_t i = 0; i < n; i++) globrad[i] = globalRadiation(daysOfYear[i], cloudAmounts[i], asMJpm2pd);
+}
+
+void Tools::cloudAmount2globalRadiation(const int* daysOfYear, const double* cloudAmounts, size_t n,
+                                        double latitude, double heightNN, double* globrad, bool asMJpm2pd) {
+  CloudAmountToGlobalRadiationTable(latitude, heightNN).globalRadiation(daysOfYear, cloudAmounts, n,
+                                                                        globrad, asMJpm2pd);
+}
+
 double Tools::hourlyT(double tmin, double tmax, int h, int sunrise_h) {
   double tavg = (tmin + tmax) / 2;
   double amp_ = (tmax - tmin) / 2;
@@ -470,20 +559,25 @@ BoxPlotInfo Tools::boxPlotAnalysis(const std::vector<double>& data,
                                    bool orderedData, int roundToDigits) {
   if (data.empty()) return BoxPlotInfo();
 
-  vector<double> _odata;
-  if (!orderedData) {
-    _odata.insert(_odata.begin(), data.begin(), data.end());
-    sort(_odata.begin(), _odata.end());
+  //the outliers below don't depend on the order of the data, so unordered data
+  //just need the quantiles, which are found by selection instead of sorting
+  BoxPlotInfo bpi;
+  if (orderedData) {
+    bpi = BoxPlotInfo(median(data, roundToDigits),
+                      quartile(0.25, data, roundToDigits),
+                      quartile(0.75, data, roundToDigits),
+                      data.front(), data.back());
+  } else {
+    vector<double> sdata(data);
+    auto mms = minMaxSum(data.begin(), data.end());
+    double m = medianInPlace(sdata, roundToDigits);
+    double q25 = quartileInPlace(0.25, sdata, roundToDigits);
+    double q75 = quartileInPlace(0.75, sdata, roundToDigits);
+    bpi = BoxPlotInfo(m, q25, q75, mms.min, mms.max);
   }
-  const vector<double>& odata = orderedData ? data : _odata;
-
-  BoxPlotInfo bpi(median(odata, roundToDigits),
-                  quartile(0.25, odata, roundToDigits),
-                  quartile(0.75, odata, roundToDigits),
-                  odata.front(), odata.back());
 
   //get extreme lower outliers
-  remove_copy_if(odata.begin(), odata.end(),
+  remove_copy_if(data.begin(), data.end(),
                  inserter(bpi.extremeLowerOutliers, bpi.extremeLowerOutliers.end()),
                  [&](double elo) { return elo >= bpi.lowerOuterFence(); }); //_1 >= bpi.lowerOuterFence());
   //keep just the 10 smallest elements, delete the rest
@@ -495,7 +589,7 @@ BoxPlotInfo Tools::boxPlotAnalysis(const std::vector<double>& data,
   }
 
   //get mild lower outliers
-  remove_copy_if(odata.begin(), odata.end(),
+  remove_copy_if(data.begin(), data.end(),
                  inserter(bpi.mildLowerOutliers, bpi.mildLowerOutliers.end()),
                  [&](double lof) { return lof < bpi.lowerOuterFence() || lof >= bpi.lowerInnerFence(); });
   //_1 < bpi.lowerOuterFence() || _1 >= bpi.lowerInnerFence());
@@ -508,7 +602,7 @@ BoxPlotInfo Tools::boxPlotAnalysis(const std::vector<double>& data,
   }
 
   //get mild upper outliers
-  remove_copy_if(odata.begin(), odata.end(),
+  remove_copy_if(data.begin(), data.end(),
                  inserter(bpi.mildUpperOutliers, bpi.mildUpperOutliers.end()),
                  [&](double uif) { return uif <= bpi.upperInnerFence() || uif > bpi.upperOuterFence(); });
   //_1 <= bpi.upperInnerFence() || _1 > bpi.upperOuterFence());
@@ -521,7 +615,7 @@ BoxPlotInfo Tools::boxPlotAnalysis(const std::vector<double>& data,
   }
 
   //get extreme upper outliers
-  remove_copy_if(odata.begin(), odata.end(),
+  remove_copy_if(data.begin(), data.end(),
                  inserter(bpi.extremeUpperOutliers, bpi.extremeUpperOutliers.end()),
                  [&](double euo) { return euo <= bpi.upperOuterFence(); });
   //_1 <= bpi.upperOuterFence());
@@ -533,22 +627,37 @@ BoxPlotInfo Tools::boxPlotAnalysis(const std::vector<double>& data,
     bpi.extremeUpperOutliers.erase(bpi.extremeUpperOutliers.begin(), i);
   }
 
+  if (!orderedData) {
+    //the same values as below, but without relying on the order
+    double lif = bpi.lowerInnerFence(), uif = bpi.upperInnerFence();
+    bool foundMin = false, foundQ75 = false;
+    double minInnerFence = bpi.min, maxInnerFence = bpi.Q75;
+    for (double v : data) {
+      if (v > lif && (!foundMin || v < minInnerFence)) minInnerFence = v, foundMin = true;
+      if (v == bpi.Q75) foundQ75 = true;
+      if (v >= bpi.Q75 && v < uif && v > maxInnerFence) maxInnerFence = v;
+    }
+    bpi.minInnerFence = foundMin ? minInnerFence : bpi.min;
+    bpi.maxInnerFence = foundQ75 ? maxInnerFence : bpi.max;
+    return bpi;
+  }
+
   //get smallest value above lower inner fence
   bpi.minInnerFence = bpi.min;
-  auto ci = find_if(odata.begin(), odata.end(),
+  auto ci = find_if(data.begin(), data.end(),
                     [&](double lif) { return lif > bpi.lowerInnerFence(); }); //_1 > bpi.lowerInnerFence());
-  if (ci != odata.end()) bpi.minInnerFence = *ci;
+  if (ci != data.end()) bpi.minInnerFence = *ci;
 
   //get largest value below upper inner fence
   bpi.maxInnerFence = bpi.max;
-  ci = find(odata.begin(), odata.end(), bpi.Q75); //start at Q75
-  auto cilast = odata.end();
-  while (ci != odata.end()) {
+  ci = find(data.begin(), data.end(), bpi.Q75); //start at Q75
+  auto cilast = data.end();
+  while (ci != data.end()) {
     cilast = ci++;
-    ci = find_if(ci, odata.end(),
+    ci = find_if(ci, data.end(),
                  [&](double uif) { return uif < bpi.upperInnerFence(); }); //_1 < bpi.upperInnerFence());
   }
-  if (cilast != odata.end()) bpi.maxInnerFence = *cilast;
+  if (cilast != data.end()) bpi.maxInnerFence = *cilast;
 
   return bpi;
 }
@@ -582,6 +691,61 @@ double Tools::quartile(double xth, const vector<double>& odata, int roundToDigit
   return Tools::round(odata.at(int(i)) + frac * (odata.at(int(ip1)) - odata.at(int(i))), roundToDigits);
 }
 
+double Tools::quartileInPlace(double xth, vector<double>& data, int roundToDigits) {
+  assert(data.size() <= INT_MAX);
+  int size = (int)data.size();
+  switch (size) {
+  case 0: return 0;
+  case 1: return data.at(0);
+  case 2: return xth < 0.5 ? std::min(data[0], data[1]) : std::max(data[0], data[1]);
+  default: ;
+  }
+
+  double i;
+  double frac = modf(xth * size, &i);
+  i -= 1; //0-indexed vector position
+  if (i < 0 || i >= size) i = 0;
+  double ip1 = i + 1;
+  if (ip1 >= size) ip1 = size - 1;
+
+  //after nth_element the (i+1)th smallest value is the minimum of the elements behind i
+  auto ith = data.begin() + int(i);
+  nth_element(data.begin(), ith, data.end());
+  double vi = *ith;
+  double vip1 = int(ip1) == int(i) ? vi : *min_element(ith + 1, data.end());
+
+  return Tools::round(vi + frac * (vip1 - vi), roundToDigits);
+}
+
+double Tools::medianInPlace(vector<double>& data, int roundToDigits) {
+  auto size = (int)data.size();
+  if (size == 0) return 0;
+
+  auto mid = data.begin() + size / 2;
+  nth_element(data.begin(), mid, data.end());
+  return isEven(size)
+         ? Tools::round((*max_element(data.begin(), mid) + *mid) / 2.0, roundToDigits)
+         : *mid;
+}
+
+void RunningStatistics::merge(const RunningStatistics& other) {
+  if (other.n == 0) return;
+  if (n == 0) {
+    *this = other;
+    return;
+  }
+
+  double na = double(n), nb = double(other.n);
+  double delta = other.mean - mean;
+  size_t nab = n + other.n;
+  mean += delta * nb / double(nab);
+  m2 += other.m2 + delta * delta * na * nb / double(nab);
+  n = nab;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+}
+
 std::pair<double, int> Tools::decomposeIntoSci(double value) {
   if (abs(value) < 0.000001) return make_pair(0.0, 0);
 
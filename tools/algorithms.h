@@ -33,6 +33,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <cstdint>
 #include <optional>
 #include <type_traits>
+#include <memory>
 
 //#include "common/common-typedefs.h"
 
@@ -75,6 +76,16 @@ Collection expGlidingAverage(const Collection& ys,
 template <class Collection>
 Collection simpleGlidingAverage(const Collection& ys, int n = 9);
 
+//! cumulative sum of [first, last) written to out, returns the end of the output
+template <class InputIterator, class OutputIterator>
+OutputIterator cumulativeSum(InputIterator first, InputIterator last, OutputIterator out);
+
+//! centered sliding average over an odd window of n values (as simpleGlidingAverage) in O(size),
+//! writes size - n + 1 values to out (none if size < n), returns the end of the output
+template <class RandomAccessIterator, class OutputIterator>
+OutputIterator simpleGlidingAverage(RandomAccessIterator first, RandomAccessIterator last, int n,
+                                    OutputIterator out);
+
 /*!
 * remove leading and trailing whitespace from copy of string
 * @param s the input string
@@ -104,6 +115,77 @@ double cloudAmount2globalRadiation(int dayOfYear,
                                    double heightNN, //[m]
                                    bool asMJpm2pd = true);
 
+//! The day of year dependent terms of sunshine2globalRadiation for one latitude,
+//! so converting a whole series needs no trigonometric functions anymore.
+//! The results are identical to sunshine2globalRadiation.
+class SunshineToGlobalRadiationTable {
+public:
+  explicit SunshineToGlobalRadiationTable(double latitude);
+
+  double latitude() const { return _latitude; }
+
+  double globalRadiation(int julianDay, double sunHours, bool asMJpm2pd = true) const {
+    const Terms& ts = julianDay >= 0 && julianDay < int(_terms.size()) ? _terms[julianDay] : terms(julianDay);
+    double dtga = sunHours / ts.dle * ts.drc + (1 - sunHours / ts.dle) * ts.dro;
+    double t = dtga / 10000.0;
+    return asMJpm2pd ? t / 100.0 : t;
+  }
+
+  //! fill globrad[i] for n days
+  void globalRadiation(const int* julianDays, const double* sunHours, size_t n,
+                       double* globrad, bool asMJpm2pd = true) const;
+
+  struct Terms { double dle, drc, dro; };
+  Terms terms(int julianDay) const;
+
+private:
+  double _latitude;
+  std::vector<Terms> _terms; //!< index = julian day [0, 366]
+};
+
+//! the table for the latitude from a small per thread cache of the recently used latitudes,
+//! the returned table stays valid as long as it is referenced, independent of later calls
+std::shared_ptr<const SunshineToGlobalRadiationTable> sunshine2globalRadiationTable(double latitude);
+
+//! batch version of sunshine2globalRadiation for one latitude
+void sunshine2globalRadiation(const int* julianDays, const double* sunHours, size_t n,
+                              double latitude, double* globrad, bool asMJpm2pd = true);
+
+//! The half hourly astronomical terms of cloudAmount2globalRadiation for all days of the year
+//! at one latitude and height, only the cloud amount dependent part is computed per day.
+//! The results are identical to cloudAmount2globalRadiation.
+class CloudAmountToGlobalRadiationTable {
+public:
+  CloudAmountToGlobalRadiationTable(double latitude, double heightNN);
+
+  double latitude() const { return _latitude; }
+  double heightNN() const { return _heightNN; }
+
+  double globalRadiation(int dayOfYear, double cloudAmount, bool asMJpm2pd = true) const;
+
+  //! fill globrad[i] for n days
+  void globalRadiation(const int* daysOfYear, const double* cloudAmounts, size_t n,
+                       double* globrad, bool asMJpm2pd = true) const;
+
+  //! the terms of a half hour with the sun above the horizon
+  struct HalfHour { double ctheta, gfaktor, id0, d0, d1; };
+
+  //! write the (at most 48) half hours of the day with the sun above the horizon, returns their number
+  static int halfHours(int dayOfYear, double latitude, double heightNN, HalfHour* halfHours);
+
+  //! the global radiation [J/cm²/d] of a day given its half hours
+  static double globalRadiation(const HalfHour* first, const HalfHour* last, double cloudAmount);
+
+private:
+  double _latitude, _heightNN;
+  std::vector<HalfHour> _halfHours;
+  std::vector<uint32_t> _dayOffsets; //!< day of year d uses _halfHours[_dayOffsets[d], _dayOffsets[d+1])
+};
+
+//! batch version of cloudAmount2globalRadiation for one latitude and height
+void cloudAmount2globalRadiation(const int* daysOfYear, const double* cloudAmounts, size_t n,
+                                 double latitude, double heightNN, double* globrad, bool asMJpm2pd = true);
+
 double hourlyVaporPressureDeficit(double hourlyTemperature, double dailyTmin, double dailyTavg, double dailyTmax);
 
 double solarDeclination(int dayOfTheYear);
@@ -222,6 +304,63 @@ double standardDeviation(const Collection& xs, bool calcAvg = true,
 template <class Collection>
 std::pair<double, double> standardDeviationAndAvg(const Collection& xis);
 
+/*!
+* single pass statistics of a stream of values
+* - mean and variance via Welford's algorithm (numerically stable)
+* - partial results (e.g. of threads or chunks) can be combined via merge
+*/
+struct RunningStatistics {
+  size_t n{0};
+  double mean{0};
+  double m2{0}; //!< sum of squared differences from the mean
+  double sum{0};
+  double min{std::numeric_limits<double>::max()};
+  double max{std::numeric_limits<double>::lowest()};
+
+  void add(double x) {
+    n++;
+    double delta = x - mean;
+    mean += delta / double(n);
+    m2 += delta * (x - mean);
+    sum += x;
+    min = x < min ? x : min;
+    max = x > max ? x : max;
+  }
+
+  template <class Iterator>
+  void add(Iterator first, Iterator last) { for (; first != last; ++first) add(double(*first)); }
+
+  //! combine with the statistics of another set of values (Chan et al.)
+  void merge(const RunningStatistics& other);
+
+  //! sample variance (n - 1), as used by standardDeviation
+  double variance() const { return n < 2 ? 0.0 : m2 / double(n - 1); }
+
+  double standardDeviation() const { return std::sqrt(variance()); }
+};
+
+template <class Iterator>
+RunningStatistics runningStatistics(Iterator first, Iterator last) {
+  RunningStatistics rs;
+  rs.add(first, last);
+  return rs;
+}
+
+template <typename T>
+struct MinMaxSum {
+  T min, max;
+  double sum;
+  size_t n;
+};
+
+/*!
+* minimum, maximum and sum in one pass, without the divisions of RunningStatistics,
+* so the loop can be vectorized by the compiler
+* @return (0, 0, 0, 0) for an empty range
+*/
+template <class Iterator>
+MinMaxSum<typename std::iterator_traits<Iterator>::value_type> minMaxSum(Iterator first, Iterator last);
+
 /*!
 * a structure holding all necessary information to create a BoxPlot
 */
@@ -328,6 +467,15 @@ double median(const Collection& orderedData, int roundToDigits = 1) {
 */
 double quartile(double xth, const std::vector<double>& orderedData, int roundToDigits = 1);
 
+/*!
+* same as quartile, but for unordered data, which is partially reordered by selection (nth_element)
+* instead of being sorted, thus O(n) instead of O(n log n)
+*/
+double quartileInPlace(double xth, std::vector<double>& data, int roundToDigits = 1);
+
+//! same as median, but for unordered data, which is partially reordered by selection (nth_element)
+double medianInPlace(std::vector<double>& data, int roundToDigits = 1);
+
 std::pair<double, int> decomposeIntoSci(double value);
 
 int integerRound1stDigit(int value);
@@ -474,7 +622,7 @@ template <class Vector1, class Vector2, class OP>
 Vector1& inElemVecOp(Vector1& left, const Vector2& right, OP op, bool autoFit);
 
 template <typename T>
-std::vector<T> operator+=(std::vector<T>& left, const std::vector<T>& right) {
+std::vector<T>& operator+=(std::vector<T>& left, const std::vector<T>& right) {
   return inElemVecOp(left, right, std::plus<T>(), false);
 };
 
@@ -504,6 +652,25 @@ std::vector<T>& operator/=(std::vector<T>& left, const std::vector<T>& right) {
 template <class Vector, typename T, class OP>
 Vector scalVecOp(const Vector& left, T right, OP op);
 
+/*!
+* elementwise operation writing to an output iterator instead of creating a new vector,
+* out may be left.begin() for an in-place operation
+* @return the end of the output
+*/
+template <class InputIterator1, class InputIterator2, class OutputIterator, class OP>
+OutputIterator elemVecOp(InputIterator1 leftFirst, InputIterator1 leftLast, InputIterator2 rightFirst,
+                         OutputIterator out, OP op) {
+  for (; leftFirst != leftLast; ++leftFirst, ++rightFirst, ++out) *out = op(*leftFirst, *rightFirst);
+  return out;
+}
+
+//! scalar operation writing to an output iterator, out may be first for an in-place operation
+template <class InputIterator, typename T, class OutputIterator, class OP>
+OutputIterator scalVecOp(InputIterator first, InputIterator last, T right, OutputIterator out, OP op) {
+  for (; first != last; ++first, ++out) *out = op(*first, right);
+  return out;
+}
+
 template <typename T>
 std::vector<T> operator+(const std::vector<T>& left, T right) {
   return scalVecOp(left, right, std::plus<T>());
@@ -629,15 +796,18 @@ Collection Tools::linearRegression(const Collection& xs, const Collection& ys) {
 
 template <class Collection>
 Collection Tools::cumulativeSum(const Collection& ys, int n) {
-  typedef typename Collection::value_type T;
-
-  T acc = 0;
   Collection yis(n);
-  for (int i = 0; i < n; i++) yis[i] = (acc += ys[i]);
-
+  cumulativeSum(ys.begin(), ys.begin() + n, yis.begin());
   return yis;
 }
 
+template <class InputIterator, class OutputIterator>
+OutputIterator Tools::cumulativeSum(InputIterator first, InputIterator last, OutputIterator out) {
+  typename std::iterator_traits<InputIterator>::value_type acc = 0;
+  for (; first != last; ++first, ++out) *out = (acc += *first);
+  return out;
+}
+
 template <class Collection>
 Collection Tools::expGlidingAverage(const Collection& ys,
                                     typename Collection::value_type alpha) {
@@ -659,19 +829,35 @@ Collection Tools::simpleGlidingAverage(const Collection& ys, int n) {
   int lr = int(T(isEven(n) ? n : n - 1) / 2.0); //left right
   n = (2 * lr) + 1;
 
-  if (ys.size() < n) return Collection();
+  if (ys.size() < size_t(n)) return Collection();
 
   Collection yas(ys.size() - (2 * lr));
+  simpleGlidingAverage(ys.begin(), ys.end(), n, yas.begin());
+  return yas;
+}
+
+template <class RandomAccessIterator, class OutputIterator>
+OutputIterator Tools::simpleGlidingAverage(RandomAccessIterator first, RandomAccessIterator last, int n,
+                                           OutputIterator out) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+
+  int lr = int(T(isEven(n) ? n : n - 1) / 2.0); //left right
+  n = (2 * lr) + 1;
+
+  auto size = last - first;
+  if (size < n) return out;
+
   T sum = 0;
-  for (int i = 0; i < n; i++) sum += ys.at(i);
+  for (int i = 0; i < n; i++) sum += first[i];
 
-  yas[0] = sum / T(n);
-  for (int i = 0; i < ys.size() - n; i++) {
-    sum = sum - ys.at(i) + ys.at(i + n);
-    yas[i + 1] = sum / T(n);
+  *out = sum / T(n);
+  ++out;
+  for (decltype(size) i = 0; i < size - n; i++, ++out) {
+    sum = sum - first[i] + first[i + n];
+    *out = sum / T(n);
   }
 
-  return yas;
+  return out;
 }
 
 template <class Collection>
@@ -679,10 +865,27 @@ std::pair<typename Collection::value_type, typename Collection::value_type> Tool
   typedef typename Collection::value_type T;
   if (vs.empty()) return std::make_pair(T(0), T(0));
 
-  T minv = std::numeric_limits<T>::max(); //*(ys.begin());
-  T maxv = std::numeric_limits<T>::min(); // *(ys.begin());
-  for (auto v : vs) minv = std::min(minv, v), maxv = std::max(maxv, v);
-  return std::make_pair(minv, maxv);
+  auto mms = minMaxSum(vs.begin(), vs.end());
+  return std::make_pair(mms.min, mms.max);
+}
+
+template <class Iterator>
+Tools::MinMaxSum<typename std::iterator_traits<Iterator>::value_type>
+Tools::minMaxSum(Iterator first, Iterator last) {
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  if (first == last) return {T(0), T(0), 0.0, 0};
+
+  T minv = std::numeric_limits<T>::max();
+  T maxv = std::numeric_limits<T>::lowest();
+  double sum = 0;
+  size_t n = 0;
+  for (; first != last; ++first, ++n) {
+    T v = *first;
+    minv = v < minv ? v : minv;
+    maxv = v > maxv ? v : maxv;
+    sum += double(v);
+  }
+  return {minv, maxv, sum, n};
 }
 
 template <typename T>
@@ -730,7 +933,7 @@ Vector1 Tools::elemVecOp(const Vector1& left, const Vector2& right, OP op,
   if (!autoFit && int(left.size()) != int(right.size())) return Vector1();
 
   Vector1 res(msize);
-  for (int i = 0; i < msize; i++) res[i] = op(left.at(i), right.at(i));
+  for (int i = 0; i < msize; i++) res[i] = op(left[i], right[i]);
 
   return res;
 }
@@ -742,7 +945,7 @@ Vector1& Tools::inElemVecOp(Vector1& left, const Vector2& right, OP op,
 
   if (!autoFit && int(left.size()) != int(right.size())) return left;
 
-  for (int i = 0; i < msize; i++) left[i] = op(left.at(i), right.at(i));
+  for (int i = 0; i < msize; i++) left[i] = op(left[i], right[i]);
 
   return left;
 }
@@ -750,13 +953,13 @@ Vector1& Tools::inElemVecOp(Vector1& left, const Vector2& right, OP op,
 template <class Vector, typename T, class OP>
 Vector Tools::scalVecOp(const Vector& left, T right, OP op) {
   Vector res(left.size());
-  for (int i = 0, size = left.size(); i < size; i++) res[i] = op(left.at(i), right);
+  for (int i = 0, size = left.size(); i < size; i++) res[i] = op(left[i], right);
   return res;
 }
 
 template <class Vector, typename T, class OP>
 Vector& Tools::inScalVecOp(Vector& left, T right, OP op) {
-  for (int i = 0, size = left.size(); i < size; i++) left[i] = op(left.at(i), right);
+  for (int i = 0, size = left.size(); i < size; i++) left[i] = op(left[i], right);
   return left;
 }
 
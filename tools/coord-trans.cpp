@@ -16,14 +16,18 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 
 #include "coord-trans.h"
 
+#include <algorithm>
 #include <iostream>
-#include <sstream>
 #include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
 
 #include "proj_api.h"
 
 #include "db/abstract-db-connections.h"
 #include "tools/helper.h"
+#include "tools/immutable-registry.h"
 
 using namespace std;
 using namespace Tools;
@@ -73,19 +77,123 @@ string Tools::coordinateSystemToShortString(CoordinateSystem cs)
   return string();
 }
 
-CoordinateSystem Tools::shortStringToCoordinateSystem(string cs, CoordinateSystem def)
+namespace
 {
-  static mutex lockable;
+  struct BuiltinCoordinateSystem
+  {
+    int id;
+    const char* name;
+    const char* shortName;
+    double sourceConversionFactor;
+    double targetConversionFactor;
+    bool switch2DCoordinates;
+    const char* projectionParams;
+  };
+
+  //! the rows of tools/coord-trans.sqlite, (re)generated at build time if Python is available
+  const BuiltinCoordinateSystem builtinCoordinateSystems[] =
+  {
+#include "coord-trans-builtin.inc"
+  };
+
+  //! the abstract schema of the overlay db, only read when the registry is created
+  struct OverlaySchema
+  {
+    mutex lock;
+    string schema;
+    //! the registry has read the schema, later overlays can't be applied anymore
+    bool consumed{false};
+  };
+
+  OverlaySchema& coordinateSystemsOverlaySchema()
+  {
+    static OverlaySchema overlay;
+    return overlay;
+  }
+
+  //! all known coordinate systems, reachable via their id or short name
+  struct CoordinateSystems
+  {
+    //! the short names in the given and in lower case spelling
+    InternedKeys shortNames;
+    //! maps the ids of shortNames to indices into css
+    vector<int> idToCssIndex;
+    vector<CoordinateSystem> css;
+    //! maps coordinate system ids to indices into css
+    vector<int> idToIndex;
+
+    void add(int id, string name, string shortName, CoordConversionParams ccps)
+    {
+      auto csd = CoordinateSystemDataPtr(new CoordinateSystemData);
+      csd->name = name;
+      csd->shortName = shortName;
+      csd->proj4Params = ccps;
+
+      //a system with the same short name (e.g. from the db overlay) replaces the existing one
+      string lowerShortName = Tools::toLower(shortName);
+      int i = shortNames.id(lowerShortName);
+      if(i < 0)
+      {
+        i = int(css.size());
+        css.push_back(CoordinateSystem(id, csd));
+      }
+      else
+      {
+        //the replaced system mustn't stay reachable via its old id
+        int oldId = css[i].id;
+        if(oldId != id && oldId >= 0 && size_t(oldId) < idToIndex.size() && idToIndex[oldId] == i)
+          idToIndex[oldId] = -1;
+        css[i] = CoordinateSystem(id, csd);
+      }
+
+      for(const auto& sn : {lowerShortName, shortName})
+      {
+        int snId = shortNames.intern(sn);
+        if(size_t(snId) >= idToCssIndex.size())
+          idToCssIndex.resize(snId + 1);
+        idToCssIndex[snId] = i;
+      }
+
+      if(id >= 0)
+      {
+        if(size_t(id) >= idToIndex.size())
+          idToIndex.resize(id + 1, -1);
+        idToIndex[id] = i;
+      }
+    }
+  };
 
-  typedef map<string, CoordinateSystem> M;
-  static bool initialized = false;
-  static M ss2cs;
+  const CoordinateSystems& coordinateSystems()
+  {
+    static ImmutableRegistry<CoordinateSystems> registry;
+    return registry.get([]()
+    {
+      CoordinateSystems res;
 
-  if (!initialized) {
-    lock_guard<mutex> lock(lockable);
+      for(const auto& bcs : builtinCoordinateSystems)
+      {
+        CoordConversionParams ccps;
+        ccps.sourceConversionFactor = bcs.sourceConversionFactor;
+        ccps.targetConversionFactor = bcs.targetConversionFactor;
+        ccps.switch2DCoordinates = bcs.switch2DCoordinates;
+        ccps.projectionParams = bcs.projectionParams;
+        res.add(bcs.id, bcs.name, bcs.shortName, ccps);
+      }
+
+      string schema;
+      {
+        auto& overlay = coordinateSystemsOverlaySchema();
+        lock_guard<mutex> guard(overlay.lock);
+        overlay.consumed = true;
+        schema = overlay.schema;
+      }
+      if(schema.empty())
+        return res;
+
+      Db::DBPtr con(Db::newConnection(schema));
+      if(!con)
+        return res;
 
-    if (!initialized) {
-      Db::DBPtr con(newConnection("coord-trans"));
       Db::DBRow row;
 
       string query =
@@ -96,29 +204,48 @@ CoordinateSystem Tools::shortStringToCoordinateSystem(string cs, CoordinateSyste
       con->select(query.c_str());
 
       while (!(row = con->getRow()).empty()) {
-        int id = satoi(row[0]);
-
-        auto csd = CoordinateSystemDataPtr(new CoordinateSystemData);
-        csd->name = row[1];
-        csd->shortName = row[2];
-
         CoordConversionParams ccps;
         ccps.sourceConversionFactor = satof(row[3]);
         ccps.targetConversionFactor = satof(row[4]);
         ccps.switch2DCoordinates = satob(row[5]);
         ccps.projectionParams = row[6];
 
-        csd->proj4Params = ccps;
-
-        ss2cs[Tools::toLower(csd->shortName)] = CoordinateSystem(id, csd);
+        res.add(satoi(row[0]), row[1], row[2], ccps);
       }
 
-      initialized = true;
-    }
+      return res;
+    });
   }
+}
 
-  M::const_iterator ci = ss2cs.find(Tools::toLower(cs));
-  return ci != ss2cs.end() ? ci->second : def;
+void Tools::overlayCoordinateSystemsFromDB(const string& abstractSchema)
+{
+  auto& overlay = coordinateSystemsOverlaySchema();
+  lock_guard<mutex> guard(overlay.lock);
+  if(overlay.consumed)
+  {
+    cerr << "error: coordinate systems have already been looked up, ignoring the overlay from schema: "
+         << abstractSchema << endl;
+    return;
+  }
+  overlay.schema = abstractSchema;
+}
+
+CoordinateSystem Tools::shortStringToCoordinateSystem(const string& cs, CoordinateSystem def)
+{
+  const auto& css = coordinateSystems();
+  //the given and the lower case spelling are interned, so only other spellings need lower casing
+  int i = css.shortNames.id(cs);
+  if (i < 0)
+    i = css.shortNames.id(Tools::toLower(cs));
+  return i < 0 ? def : css.css[css.idToCssIndex[i]];
+}
+
+CoordinateSystem Tools::idToCoordinateSystem(int id, CoordinateSystem def)
+{
+  const auto& css = coordinateSystems();
+  int i = id >= 0 && size_t(id) < css.idToIndex.size() ? css.idToIndex[id] : -1;
+  return i < 0 ? def : css.css[i];
 }
 
 /*
@@ -215,21 +342,8 @@ string RectCoord::toString() const {
 const double LatLngCoord::eps = 0.000001;
 
 CoordinateSystem LatLngCoord::latLngCoordinateSystem() {
-  static mutex lockable;
-
-  static bool initialized = false;
-  static CoordinateSystem llc;
-
-  if (!initialized) {
-    lock_guard<mutex> lock(lockable);
-
-    if (!initialized) {
-      llc = shortStringToCoordinateSystem("LatLng");
-      initialized = true;
-    }
-  }
-
-  return llc;
+  static ImmutableRegistry<CoordinateSystem> registry;
+  return registry.get([]() { return shortStringToCoordinateSystem("latlng"); });
 }
 
 string LatLngCoord::toString() const {
@@ -388,6 +502,122 @@ LatLngCoord Tools::RC2latLng(RECTCoord rcc)
 }
 */
 
+CoordinateTransformer::CoordinateTransformer(CoordinateSystem source, CoordinateSystem target)
+  : _source(source)
+  , _target(target)
+  , _sccp(coordConversionParams(source))
+  , _tccp(coordConversionParams(target))
+{
+  //every transformer has its own context, so transformers of different threads are independent
+  _ctx = pj_ctx_alloc();
+  if(_ctx && !_sccp.projectionParams.empty() && !_tccp.projectionParams.empty())
+  {
+    _sourcePJ = pj_init_plus_ctx(_ctx, _sccp.projectionParams.c_str());
+    _targetPJ = pj_init_plus_ctx(_ctx, _tccp.projectionParams.c_str());
+  }
+}
+
+CoordinateTransformer::~CoordinateTransformer()
+{
+  if(_sourcePJ) pj_free(_sourcePJ);
+  if(_targetPJ) pj_free(_targetPJ);
+  if(_ctx) pj_ctx_free(_ctx);
+}
+
+int CoordinateTransformer::transform(double* firsts, double* seconds, size_t n)
+{
+  if(!isValid())
+    return -1;
+  if(n == 0)
+    return 0;
+
+  double scv = _sccp.sourceConversionFactor;
+  for(size_t i = 0; i < n; i++)
+  {
+    firsts[i] *= scv;
+    seconds[i] *= scv;
+  }
+
+  //instead of copying the dimensions into x and y arrays, just hand the arrays over in the right order
+  bool ss2Dc = _sccp.switch2DCoordinates;
+  double* xs = ss2Dc ? seconds : firsts;
+  double* ys = ss2Dc ? firsts : seconds;
+  int error = pj_transform(_sourcePJ, _targetPJ, long(n), 1, xs, ys, nullptr);
+  if(error)
+    return error;
+
+  //x ended up in the wrong array if only one of the coordinate systems switches the dimensions
+  if(ss2Dc != _tccp.switch2DCoordinates)
+    swap_ranges(firsts, firsts + n, seconds);
+
+  double tcv = _tccp.targetConversionFactor;
+  for(size_t i = 0; i < n; i++)
+  {
+    firsts[i] *= tcv;
+    seconds[i] *= tcv;
+  }
+
+  return 0;
+}
+
+CoordinateTransformer& Tools::coordinateTransformer(CoordinateSystem source, CoordinateSystem target)
+{
+  typedef tuple<int, const void*, int, const void*> Key;
+  thread_local map<Key, unique_ptr<CoordinateTransformer>> transformers;
+  //most callers transform repeatedly between the same coordinate systems
+  thread_local Key lastKey;
+  thread_local CoordinateTransformer* last = nullptr;
+
+  Key key(source.id, source.data.get(), target.id, target.data.get());
+  if(last && key == lastKey)
+    return *last;
+
+  auto& t = transformers[key];
+  if(!t)
+    t.reset(new CoordinateTransformer(source, target));
+  lastKey = key;
+  last = t.get();
+  return *t;
+}
+
+int Tools::transformCoordinates(CoordinateSystem source, CoordinateSystem target,
+                                double* firsts, double* seconds, size_t n,
+                                unsigned int noOfThreads, size_t minChunkSize)
+{
+  if(noOfThreads == 0)
+    noOfThreads = max(1u, thread::hardware_concurrency());
+  size_t noOfChunks = min(size_t(noOfThreads), max(size_t(1), n / max(size_t(1), minChunkSize)));
+
+  if(noOfChunks < 2)
+    return coordinateTransformer(source, target).transform(firsts, seconds, n);
+
+  //every thread uses its own transformer, the calling thread transforms the first chunk
+  //rounding the chunk size up can leave fewer non-empty chunks than planned (e.g. n = 5, 4 chunks -> 3 chunks of 2)
+  size_t chunkSize = (n + noOfChunks - 1) / noOfChunks;
+  noOfChunks = (n + chunkSize - 1) / chunkSize;
+  vector<int> errors(noOfChunks, 0);
+  vector<thread> threads;
+  for(size_t c = 1; c < noOfChunks; c++)
+  {
+    size_t from = c * chunkSize;
+    size_t count = min(chunkSize, n - from);
+    threads.emplace_back([=, &errors]()
+    {
+      errors[c] = coordinateTransformer(source, target).transform(firsts + from, seconds + from, count);
+    });
+  }
+  errors[0] = coordinateTransformer(source, target).transform(firsts, seconds, min(chunkSize, n));
+  for(auto& t : threads)
+    t.join();
+
+  for(int error : errors)
+    if(error)
+      return error;
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
 bool Tools::contains(vector<LatLngCoord> tlTrBrBlRect, LatLngCoord llc) {
     LatLngCoord tl = tlTrBrBlRect.at(0);
     //LatLngCoord tr = tlTrBrBlRect.at(1);
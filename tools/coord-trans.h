@@ -23,6 +23,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <climits>
 #include <iostream>
 #include <map>
+#include <string>
 
 #include "proj_api.h"
 
@@ -87,7 +88,15 @@ std::string coordinateSystemToString(CoordinateSystem cs);
 
 std::string coordinateSystemToShortString(CoordinateSystem cs);
 
-CoordinateSystem shortStringToCoordinateSystem(std::string cs, CoordinateSystem def = CoordinateSystem());
+//! the coordinate systems of tools/coord-trans.sqlite are compiled in, the short name is case insensitive
+CoordinateSystem shortStringToCoordinateSystem(const std::string& cs, CoordinateSystem def = CoordinateSystem());
+
+CoordinateSystem idToCoordinateSystem(int id, CoordinateSystem def = CoordinateSystem());
+
+//! Additionally load the coordinate systems from the db of the abstract schema, they replace the
+//! compiled in systems with the same short name. Has to be called before the first lookup,
+//! later calls are ignored with an error message.
+void overlayCoordinateSystemsFromDB(const std::string& abstractSchema = "coord-trans");
 
 template<typename T>
 struct Coord2D {
@@ -203,6 +212,45 @@ struct LatLngCoord : public Coord2D<double> {
 
 //----------------------------------------------------------------------------
 
+//! Transformation between two coordinate systems, the PROJ objects are created once.
+//! PROJ objects must not be used by two threads at the same time, thus a transformer belongs
+//! to one thread only, use coordinateTransformer() to get the one of the calling thread.
+class CoordinateTransformer {
+public:
+  CoordinateTransformer(CoordinateSystem source, CoordinateSystem target);
+  ~CoordinateTransformer();
+
+  CoordinateTransformer(const CoordinateTransformer&) = delete;
+  CoordinateTransformer& operator=(const CoordinateTransformer&) = delete;
+
+  bool isValid() const { return _sourcePJ && _targetPJ; }
+
+  CoordinateSystem sourceCoordinateSystem() const { return _source; }
+  CoordinateSystem targetCoordinateSystem() const { return _target; }
+
+  //! transform n coordinates in place, firsts and seconds hold the first and second dimensions
+  //! (r/h or lat/lng) in the source coordinate system and afterwards in the target coordinate system
+  //! returns 0 on success else the PROJ error code (-1 if the transformer is invalid)
+  int transform(double* firsts, double* seconds, size_t n);
+
+private:
+  CoordinateSystem _source, _target;
+  CoordConversionParams _sccp, _tccp;
+  projCtx _ctx{nullptr};
+  projPJ _sourcePJ{nullptr};
+  projPJ _targetPJ{nullptr};
+};
+
+//! the transformer from source to target of the calling thread, created on first use
+CoordinateTransformer& coordinateTransformer(CoordinateSystem source, CoordinateSystem target);
+
+//! Transform caller owned arrays in place (see CoordinateTransformer::transform).
+//! Arrays with more than minChunkSize coordinates are split into chunks of at least minChunkSize
+//! coordinates, which are transformed by up to noOfThreads threads (0 = hardware concurrency).
+int transformCoordinates(CoordinateSystem source, CoordinateSystem target,
+                         double* firsts, double* seconds, size_t n,
+                         unsigned int noOfThreads = 1, size_t minChunkSize = 100000);
+
 template<typename SourceCoordType, typename TargetCoordType>
 std::vector<TargetCoordType>
 sourceProj2targetProj(const std::vector<SourceCoordType>& sourceCoords,
@@ -251,11 +299,11 @@ inline RectCoord latLng2RC(LatLngCoord llc, CoordinateSystem targetCoordinateSys
 //	{ return sourceProj2targetProj<GK5_Params, LatLng_EPSG4326_Params>(rcc); }
 
 inline std::vector<LatLngCoord> RC2latLng(const std::vector<RectCoord>& rcs) {
-  return sourceProj2targetProj<RectCoord, LatLngCoord>(rcs, shortStringToCoordinateSystem("latlng"));
+  return sourceProj2targetProj<RectCoord, LatLngCoord>(rcs, LatLngCoord::latLngCoordinateSystem());
 }
 
 inline LatLngCoord RC2latLng(RectCoord rcc) {
-  return singleSourceProj2targetProj<RectCoord, LatLngCoord>(rcc, shortStringToCoordinateSystem("latlng"));
+  return singleSourceProj2targetProj<RectCoord, LatLngCoord>(rcc, LatLngCoord::latLngCoordinateSystem());
 }
 
 //Lat/Lng to UTM21S
@@ -285,85 +333,42 @@ Tools::sourceProj2targetProj(const std::vector<SCT>& scs, CoordinateSystem targe
   if(scs.empty())
     return std::vector<TCT>();
 
-  struct AutoDeleter  {
-    std::map<std::string, projPJ> cache;
-    AutoDeleter() {}
-    ~AutoDeleter() { for(auto p : cache) pj_free(p.second); }
-  };
-  static AutoDeleter ad;
-  auto& cache = ad.cache;
-
-  CoordConversionParams sccp = coordConversionParams(scs.front().coordinateSystem);
-  CoordConversionParams tccp = coordConversionParams(targetCS);
-
-  unsigned int nocs = (unsigned int)scs.size(); //no of coordinates
-  double* xs = new double[nocs];
-  double* ys = new double[nocs];
-  double* zs = new double[nocs];
-
-  double scv = sccp.sourceConversionFactor;
-  bool ss2Dc = sccp.switch2DCoordinates;
-  for(unsigned int i = 0; i < nocs; i++) {
-    xs[i] = ss2Dc ? scs.at(i).secondDimension() * scv
-                  : scs.at(i).firstDimension() * scv;
-    ys[i] = ss2Dc ? scs.at(i).firstDimension() * scv
-                  : scs.at(i).secondDimension() * scv;
-    zs[i] = 0;
-  }
-
-  auto sci = cache.find(sccp.projectionParams);
-  if(sci == cache.end()) {
-    cache[sccp.projectionParams] = pj_init_plus(sccp.projectionParams.c_str());
-    sci = cache.find(sccp.projectionParams);
-  }
-  auto tci = cache.find(tccp.projectionParams);
-  if(tci == cache.end()) {
-    cache[tccp.projectionParams] = pj_init_plus(tccp.projectionParams.c_str());
-    tci = cache.find(tccp.projectionParams);
-  }
-
-  projPJ sourcePJ = sci->second;
-  projPJ targetPJ = tci->second;
-
-  //projPJ sourcePJ = pj_init_plus(sccp.projectionParams.c_str());
-  //projPJ targetPJ = pj_init_plus(tccp.projectionParams.c_str());
+  auto& transformer = coordinateTransformer(scs.front().coordinateSystem, targetCS);
+  if(!transformer.isValid())
+    return std::vector<TCT>();
 
-  if(sourcePJ && targetPJ){
-    int error = pj_transform(sourcePJ, targetPJ, nocs, 0, xs, ys, zs);
-    if(error) {
-      std::cerr << "error: " << error << std::endl;
-      return std::vector<TCT>();
-    }
+  size_t nocs = scs.size(); //no of coordinates
+  std::vector<double> firsts(nocs), seconds(nocs);
+  for(size_t i = 0; i < nocs; i++) {
+    firsts[i] = scs[i].firstDimension();
+    seconds[i] = scs[i].secondDimension();
   }
 
-  std::vector<TCT> tcs(nocs);
-  double tcv = tccp.targetConversionFactor;
-  bool ts2Dc = tccp.switch2DCoordinates;
-  for(unsigned int i = 0; i < nocs; i++) {
-    tcs[i] = ts2Dc ? TCT(targetCS, ys[i]*tcv, xs[i]*tcv)
-                   : TCT(targetCS, xs[i]*tcv, ys[i]*tcv);
+  int error = transformer.transform(firsts.data(), seconds.data(), nocs);
+  if(error) {
+    std::cerr << "error: " << error << std::endl;
+    return std::vector<TCT>();
   }
 
-  //if(sourcePJ)
-  //  pj_free(sourcePJ);
-  //if(targetPJ)
-  //  pj_free(targetPJ);
+  std::vector<TCT> tcs;
+  tcs.reserve(nocs);
+  for(size_t i = 0; i < nocs; i++)
+    tcs.push_back(TCT(targetCS, firsts[i], seconds[i]));
 
-  delete[] xs;
-  delete[] ys;
-  delete[] zs;
-
-  //static int count = 0;
-  //count++;
-  //if(count % 1000 == 0)
-  //	std::cout << count << " ";
-
-  return !sourcePJ || !targetPJ ? std::vector<TCT>() : tcs;
+  return tcs;
 }
 
 template<typename SCT, typename TCT>
 TCT Tools::singleSourceProj2targetProj(SCT sc, CoordinateSystem targetCS) {
-  auto v = sourceProj2targetProj<SCT, TCT>(std::vector<SCT>(1, sc), targetCS);
-  return v.empty() ? TCT(targetCS) : v.front();
+  auto& transformer = coordinateTransformer(sc.coordinateSystem, targetCS);
+  if(!transformer.isValid())
+    return TCT(targetCS);
+
+  double first = sc.firstDimension(), second = sc.secondDimension();
+  int error = transformer.transform(&first, &second, 1);
+  if(error) {
+    std::cerr << "error: " << error << std::endl;
+    return TCT(targetCS);
+  }
+  return TCT(targetCS, first, second);
 }
-
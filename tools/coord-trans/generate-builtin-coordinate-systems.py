@@ -0,0 +1,62 @@
+#!/usr/bin/python
+# -*- coding: UTF-8
+
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# Authors:
+# Michael Berg <michael.berg@zalf.de>
+#
+# Maintainers:
+# Currently maintained by the authors.
+#
+# This file is part of the util library used by models created at the Institute of
+# Landscape Systems Analysis at the ZALF.
+# Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+
+# writes the rows of proj4_conversion_params as C++ initializers,
+# which are compiled into coord-trans.cpp as the builtin coordinate systems
+# usage: generate-builtin-coordinate-systems.py path/to/coord-trans.sqlite path/to/coord-trans-builtin.inc
+
+import sqlite3
+import sys
+
+
+def c_string(s):
+    return '"' + (s or "").replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("usage: " + sys.argv[0] + " path-to-coord-trans.sqlite path-to-output.inc")
+        return 1
+
+    con = sqlite3.connect(sys.argv[1])
+    rows = con.execute(
+        "select id, name, short_name, source_conversion_factor, target_conversion_factor, "
+        "switch_2d_coordinates, params "
+        "from proj4_conversion_params "
+        "order by id")
+
+    lines = ["// generated from coord-trans.sqlite by tools/coord-trans/generate-builtin-coordinate-systems.py, don't edit"]
+    for id_, name, short_name, scf, tcf, switch, params in rows:
+        lines.append("{" + ", ".join([
+            str(id_), c_string(name), c_string(short_name), repr(float(scf)), repr(float(tcf)),
+            "true" if switch else "false", c_string(params)]) + "},")
+
+    content = "\n".join(lines) + "\n"
+    # only touch the output if something changed, to not trigger needless rebuilds
+    try:
+        with open(sys.argv[2]) as f:
+            if f.read() == content:
+                return 0
+    except IOError:
+        pass
+    with open(sys.argv[2], "w") as f:
+        f.write(content)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Tools
+{
+
+//! Lazily created, afterwards immutable value (e.g. a lookup table loaded from disk).
+//! The value is created exactly once (std::call_once) and published via an
+//! atomic pointer, so after creation every access is a single acquire load
+//! without locking. Meant to be used as function local static:
+//!   static ImmutableRegistry<Table> registry;
+//!   return registry.get([&]() { return loadTable(path); });
+template<typename T>
+class ImmutableRegistry
+{
+public:
+  ImmutableRegistry() {}
+  ImmutableRegistry(const ImmutableRegistry&) = delete;
+  ImmutableRegistry& operator=(const ImmutableRegistry&) = delete;
+
+  //! create is called only on first access and has to return a T
+  template<typename Create>
+  const T& get(Create create)
+  {
+    if(const T* value = _published.load(std::memory_order_acquire))
+      return *value;
+
+    std::call_once(_once, [&]()
+    {
+      _value.reset(new T(create()));
+      _published.store(_value.get(), std::memory_order_release);
+    });
+    return *_value;
+  }
+
+  bool isCreated() const { return _published.load(std::memory_order_acquire) != nullptr; }
+
+private:
+  std::once_flag _once;
+  std::unique_ptr<const T> _value;
+  std::atomic<const T*> _published{nullptr};
+};
+
+//------------------------------------------------------------------------------
+
+//! maps string keys once to dense ids [0, size()), so tables can be stored in vectors
+class InternedKeys
+{
+public:
+  //! returns the id of key, adds the key if not known yet
+  int intern(const std::string& key)
+  {
+    auto ci = _ids.find(key);
+    if(ci != _ids.end())
+      return ci->second;
+    int id = int(_keys.size());
+    _ids[key] = id;
+    _keys.push_back(key);
+    return id;
+  }
+
+  //! -1 if key is unknown
+  int id(const std::string& key) const
+  {
+    auto ci = _ids.find(key);
+    return ci == _ids.end() ? -1 : ci->second;
+  }
+
+  const std::string& key(int id) const { return _keys.at(id); }
+
+  size_t size() const { return _keys.size(); }
+
+  const std::vector<std::string>& keys() const { return _keys; }
+
+private:
+  std::unordered_map<std::string, int> _ids;
+  std::vector<std::string> _keys;
+};
+
+} // namespace Tools